@@ -80,8 +80,21 @@ function(mnn_print_configuration_summary)
     mnn_status("  BUILD_EXAMPLE    :    ${BUILD_EXAMPLE}")
     mnn_status("  BUILD_TEST       :    ${BUILD_TEST}")
     mnn_status("")
+    mnn_status("SIMD Extensions:")
+    if(USE_RUNTIME_DISPATCH)
+    string(REPLACE ";" " " __tiers "${MNN_DISPATCH_TIERS}")
+    mnn_status("  Runtime dispatch  :   Yes (${__tiers})")
+    else()
+    mnn_status("  Runtime dispatch  :   No")
+    mnn_status("  SSE               : " USE_SSE AND COMPILER_HAS_SSE_FLAG THEN "Yes" ELSE "No")
+    mnn_status("  AVX               : " USE_AVX AND COMPILER_HAS_AVX_FLAG THEN "Yes" ELSE "No")
+    mnn_status("  AVX2              : " USE_AVX2 AND COMPILER_HAS_AVX2_FLAG THEN "Yes" ELSE "No")
+    mnn_status("  AVX-512           : " USE_AVX512 AND COMPILER_HAS_AVX512_FLAG THEN "Yes" ELSE "No")
+    endif()
+    mnn_status("")
     mnn_status("Multithread Backend:")
     mnn_status("  Pthread           : " USE_PTHREAD THEN "Yes" ELSE "No")
+    mnn_status("  Work stealing     : " USE_WORK_STEALING THEN "Yes" ELSE "No")
     mnn_status("  TBB               : " USE_TBB AND TBB_FOUND THEN "Yes (ver. ${TBB_INTERFACE_VERSION})" ELSE "No")
     mnn_status("  OMP               : " USE_OMP AND OMP_FOUND THEN "Yes" ELSE "No")
     mnn_status("")
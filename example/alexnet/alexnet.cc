@@ -18,18 +18,18 @@ public:
     {
         add(ConvolutionalLayer(224, 224, 11, 11, 3, 64, mnn::Padding::VALID, true, 4, 4));
         add(ReluLayer(54, 54, 64));
-        add(AveragePoolingLayer(54, 54, 64, 2));
+        add(MaxPoolingLayer(54, 54, 64, 2));
 
         add(ConvolutionalLayer(27, 27, 5, 5, 64, 192, mnn::Padding::VALID, true, 1, 1));
         add(ReluLayer(23, 23, 192));
-        add(AveragePoolingLayer(23, 23, 192, 1));
+        add(MaxPoolingLayer(23, 23, 192, 1));
         add(ConvolutionalLayer(23, 23, 3, 3, 192, 384, mnn::Padding::VALID, true, 1, 1));
         add(ReluLayer(21, 21, 384));
         add(ConvolutionalLayer(21, 21, 3, 3, 384, 256, mnn::Padding::VALID, true, 1, 1));
         add(ReluLayer(19, 19, 256));
         add(ConvolutionalLayer(19, 19, 3, 3, 256, 256, mnn::Padding::VALID, true, 1, 1));
         add(ReluLayer(17, 17, 256));
-        add(AveragePoolingLayer(17, 17, 256, 1));
+        add(MaxPoolingLayer(17, 17, 256, 1));
     }
 };
 
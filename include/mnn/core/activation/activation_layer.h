@@ -22,32 +22,40 @@ public:
     explicit ActivationLayer(const Shape3d &in_shape);
     explicit ActivationLayer(const Layer &prev_layer);
 
+    std::vector<size_t> shape_params() const override;
+
 private:
     std::vector<Shape3d> in_shape() const override;
     std::vector<Shape3d> out_shape() const override;
 
     void set_in_shape(const Shape3d &in_shape) override;
 
+    bool needs_out_data() const override;
+    Epilogue epilogue() override;
+
     void forward_propagation(
-            const std::vector<Matrix*> &in_data,
-            std::vector<Matrix*> &out_data) override;
+            const std::vector<Tensor<>*> &in_data,
+            std::vector<Tensor<>*> &out_data) override;
 
     void back_propagation(
-            const std::vector<Matrix*> &in_data,
-            const std::vector<Matrix*> &out_data,
-            std::vector<Matrix*> &out_grad,
-            std::vector<Matrix*> &in_grad) override;
+            const std::vector<Tensor<>*> &in_data,
+            const std::vector<Tensor<>*> &out_data,
+            std::vector<Tensor<>*> &out_grad,
+            std::vector<Tensor<>*> &in_grad) override;
 
 private:
     std::string layer_type() const override = 0;
 
-    virtual void forward_activation(const Vector &x, Vector &y) = 0;
+    virtual void forward_activation(Span<const Float> x, Span<Float> y) = 0;
 
+    // Layers overriding can_run_in_place() to true may get x sharing
+    // memory with y, so only y is reliable there. They also fold into
+    // the layer before them, see epilogue().
     virtual void backward_activation(
-            const Vector &x,
-            const Vector &y,
-            Vector &dx,
-            const Vector &dy) = 0;
+            Span<const Float> x,
+            Span<const Float> y,
+            Span<Float> dx,
+            Span<const Float> dy) = 0;
 
     virtual std::pair<Float, Float> scale() const = 0;
 
@@ -16,10 +16,14 @@ class TanhLayer: public ActivationLayer {
 public:
     using ActivationLayer::ActivationLayer;
 
+    std::shared_ptr<Layer> clone() const override;
+
 private:
     std::string layer_type() const override;
-    void forward_activation(const Vector &x, Vector &y) override;
-    void backward_activation(const Vector &x, const Vector &y, Vector &dx, const Vector &dy) override;
+    bool can_run_in_place() const override;
+    void forward_activation(Span<const Float> x, Span<Float> y) override;
+    void backward_activation(Span<const Float> x, Span<const Float> y,
+            Span<Float> dx, Span<const Float> dy) override;
     std::pair<Float, Float> scale() const override;
 };
 
@@ -0,0 +1,98 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mnn/infra/util.h"
+
+namespace mnn {
+
+// Inference front-end for many caller threads: predict() queues a single
+// sample and returns at once, and a worker thread groups the queued
+// samples into one forward pass over a batch of up to max_batch. A batch
+// goes as soon as it is full, or once its oldest sample has waited
+// max_delay, so each sample trades at most max_delay of latency for the
+// throughput of the batched kernels.
+//
+// The worker owns the network while the predictor lives; nothing else
+// may use it in that time.
+class BatchPredictor {
+ public:
+  // forward pass over a batch, one input matrix per sample
+  typedef std::function<std::vector<Matrix>(const std::vector<Matrix> &)>
+    Forward;
+
+  BatchPredictor(const Forward &forward,
+                 size_t in_size,
+                 size_t max_batch,
+                 std::chrono::microseconds max_delay);
+
+  template <typename Net>
+  explicit BatchPredictor(
+    Net &net,
+    size_t max_batch                    = 64,
+    std::chrono::microseconds max_delay = std::chrono::microseconds(1000))
+    : BatchPredictor([&net](const std::vector<Matrix> &in) {
+                       return net.predict(in);
+                     },
+                     net.in_data_size(),
+                     max_batch,
+                     max_delay) {
+    net.set_netphase(NetPhase::TESTING);
+  }
+
+  // runs the samples still queued, then stops the worker
+  ~BatchPredictor();
+
+  BatchPredictor(const BatchPredictor &) = delete;
+  BatchPredictor &operator=(const BatchPredictor &) = delete;
+
+  // The output of the network for in, once its batch has run. The future
+  // holds the exception instead if the forward pass threw. Thread-safe.
+  std::future<Vector> predict(const Vector &in);
+
+  // the batches run so far and the samples in them
+  size_t batch_count() const;
+  size_t sample_count() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Request {
+    Vector in;
+    std::promise<Vector> out;
+    Clock::time_point queued;
+  };
+
+  void run();
+  void run_batch(std::vector<Request> &batch);
+
+  Forward forward_;
+  size_t in_size_;
+  size_t max_batch_;
+  std::chrono::microseconds max_delay_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable queued_;
+  std::deque<Request> queue_;
+  bool stopping_;
+  size_t batches_;
+  size_t samples_;
+  std::thread worker_;
+};
+
+}  // namespace mnn
@@ -0,0 +1,125 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mnn/infra/util.h"
+
+namespace mnn {
+
+class Layer;
+struct Optimizer;
+
+// where fit() continues from a checkpoint
+struct CheckpointPosition {
+  size_t epoch  = 0;
+  size_t sample = 0;  // first sample of the next minibatch
+};
+
+// Saves the weights of a network and the state of its optimizer to a file
+// while training goes on. snapshot() only copies the scalars; a copier
+// thread copies the arrays block by block into a buffer, and a weight
+// update reaching a block the copier hasn't copied yet copies it first,
+// through preserve(). A writer thread then writes the buffer out, while
+// the next snapshot fills a second one. A snapshot taken while the
+// previous one still waits for the writer replaces it, so training never
+// waits for the disk, and the stall is bounded by the bookkeeping, not by
+// the size of the model. Files are synced and then replaced atomically,
+// so a crash or a power loss leaves the previous checkpoint.
+class Checkpointer {
+ public:
+  explicit Checkpointer(const std::string &path);
+  // writes out the last snapshot
+  ~Checkpointer();
+
+  Checkpointer(const Checkpointer &) = delete;
+  Checkpointer &operator=(const Checkpointer &) = delete;
+
+  // Starts a checkpoint of the weights of layers and the state of opt,
+  // between two steps. Only waits for the copies of the previous one,
+  // which the steps since have mostly done.
+  void snapshot(const std::vector<Layer *> &layers,
+                Optimizer &opt,
+                const CheckpointPosition &pos);
+
+  // W[begin, end) and the optimizer state at slot + [begin, end) are
+  // about to change
+  void preserve(const Vector *W, size_t slot, size_t begin, size_t end);
+  // for optimizers that don't update ranges: all of W, or all of the
+  // optimizer state, is about to change
+  void preserve_weight(const Vector *W);
+  void preserve_state();
+
+  // waits until the last snapshot is saved, and throws if one couldn't be
+  void wait();
+
+  // Reads the checkpoint at path into layers and opt, which must have
+  // registered the weights of layers, and returns where it was taken.
+  static CheckpointPosition restore(const std::string &path,
+                                    const std::vector<Layer *> &layers,
+                                    Optimizer &opt);
+
+ private:
+  enum BlockState : unsigned char { pending, copying, copied };
+
+  // the copies of a snapshot: the weights, then the optimizer state
+  struct Buffer {
+    std::vector<std::unique_ptr<Float[]>> arrays;
+    std::vector<size_t> sizes;
+    std::vector<Float> scalars;
+    size_t weight_count = 0;
+    CheckpointPosition pos;
+  };
+
+  struct Region {
+    const Float *src;
+    Float *dst;
+    size_t size;
+    size_t first_block;
+  };
+
+  void finish_copies();
+  void copy_blocks(size_t region, size_t begin, size_t end);
+  void copy_block(size_t region, size_t block);
+  void write_loop();
+  void write(const Buffer &buffer);
+
+  std::string path_;
+
+  // the snapshot being copied, into capture_
+  std::unique_ptr<Buffer> capture_;
+  std::vector<Region> regions_;
+  size_t weight_count_;
+  std::unordered_map<const Vector *, size_t> weight_index_;
+  std::unique_ptr<std::atomic<unsigned char>[]> blocks_;
+  size_t block_count_;
+  std::atomic<bool> all_copied_;
+  std::thread copier_;
+
+  // handed from the copier to the writer under mutex_
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::unique_ptr<Buffer> queued_;  // copied, not yet being written
+  std::unique_ptr<Buffer> spare_;   // written, for the next snapshot
+  bool writing_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::thread writer_;
+};
+
+}  // namespace mnn
@@ -10,6 +10,7 @@
 
 #include <memory>
 #include "mnn/infra/util.h"
+#include "mnn/core/graph/tensor.h"
 
 namespace mnn {
 
@@ -21,13 +22,25 @@ class Edge {
  public:
   Edge(Node *prev, const Shape3d &shape, VectorType vtype);
 
+  // dst = the sum of the gradients of all samples
   void merge_grads(Vector *dst);
+  // dst = the sum of the gradients of all samples over [begin, end)
+  void merge_grads(size_t begin, size_t end, Float *dst) const;
   void clear_grads();
 
-  Matrix *get_data();
-  const Matrix *get_data() const;
-  Matrix *get_gradient();
-  const Matrix *get_gradient() const;
+  // makes data caller-owned memory holding sample_count samples, until
+  // unbind_data() gives the edge its own buffer back
+  void bind_data(Float *data, size_t sample_count);
+  void unbind_data();
+  void bind_gradient(Float *grad, size_t sample_count);
+  void unbind_gradient();
+  // makes data a view of the data of other, e.g. shared weights
+  void share_data(const Edge &other);
+
+  Tensor<> *get_data();
+  const Tensor<> *get_data() const;
+  Tensor<> *get_gradient();
+  const Tensor<> *get_gradient() const;
   const std::vector<Node *> &next() const;
   Node *prev();
   const Node *prev() const;
@@ -38,8 +51,8 @@ class Edge {
  private:
   Shape3d shape_;
   VectorType vtype_;
-  Matrix data_;
-  Matrix grad_;
+  Tensor<> data_;  // samples x depth x height x width
+  Tensor<> grad_;
   Node *prev_;                // previous node, "producer" of this tensor
   std::vector<Node *> next_;  // next nodes, "consumers" of this tensor
 };
@@ -0,0 +1,22 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <functional>
+
+#include "mnn/core/graph/tensor.h"
+
+namespace mnn {
+
+// In-place element-wise function a kernel runs on each chunk of output it
+// has just written, while the chunk is still in cache. Element-wise layers
+// fused into the layer before them run this way, see Sequential.
+typedef std::function<void(Span<Float>)> Epilogue;
+
+}  // namespace mnn
@@ -0,0 +1,49 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "mnn/infra/util.h"
+
+namespace mnn {
+
+// Static planner placing buffers with known live ranges in one arena, so
+// that buffers that are never live at the same step share memory. Steps
+// are the positions of the layer runs in the forward/backward schedule.
+class MemoryPlanner {
+ public:
+  // a buffer of size elements, live from step first to step last inclusive
+  size_t add(size_t size, size_t first, size_t last);
+
+  // makes buffer b use the memory of buffer a, for layers running in place
+  void share(size_t a, size_t b);
+
+  // assigns the offsets and returns the arena size in elements
+  size_t plan();
+
+  size_t offset(size_t id) const;
+  size_t size() const { return buffers_.size(); }
+  void clear();
+
+ private:
+  struct Buffer {
+    size_t size;
+    size_t first;
+    size_t last;
+    size_t owner;
+    size_t offset;
+  };
+
+  size_t owner(size_t id) const;
+
+  std::vector<Buffer> buffers_;
+};
+
+}  // namespace mnn
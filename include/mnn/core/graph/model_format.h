@@ -0,0 +1,74 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mnn/infra/mapped_file.h"
+
+namespace mnn {
+
+class Layer;
+
+enum class ContentType {
+  weights,           ///< save/load the weights
+  model,             ///< save/load the network architecture
+  weights_and_model  ///< save/load both the weights and the architecture
+};
+
+// Binary model file, in native byte order:
+//
+//   header   64 bytes: "MNNMODEL", version, byte order mark, sizeof(Float),
+//            content flags, layer count and file size
+//   layers   per layer its type, the constructor arguments with the
+//            model, and the offset and size of every weight with the
+//            weights, all as 64-bit words
+//   weights  the weight and bias vectors, each at a 64-byte aligned offset
+//
+// Only the layer table is parsed; the weights can be used where they are
+// in a mapping of the file.
+void save_model(const std::string &path, const std::vector<Layer *> &layers,
+                ContentType what);
+
+// a mapped model file with its layer table read
+class ModelFile {
+ public:
+  explicit ModelFile(const std::string &path);
+
+  bool has_model() const;
+  bool has_weights() const;
+
+  // new layers built from the model, not connected to each other
+  std::vector<std::shared_ptr<Layer>> make_layers() const;
+
+  // Gives layers, which must match the file, its weights: copied, or with
+  // in_place pointing into the mapping, which must outlive the layers then.
+  void load_weights(const std::vector<Layer *> &layers, bool in_place) const;
+
+ private:
+  struct Weight {
+    uint64_t offset;
+    uint64_t size;
+  };
+  struct LayerRecord {
+    std::string type;
+    std::vector<size_t> params;
+    std::vector<Weight> weights;
+  };
+
+  std::string path_;
+  MappedFile file_;
+  uint32_t content_;
+  std::vector<LayerRecord> layers_;
+};
+
+}  // namespace mnn
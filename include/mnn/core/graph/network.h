@@ -10,6 +10,7 @@
 
 #include "mnn/core/graph/node_list.h"
 #include <algorithm>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
@@ -25,15 +26,11 @@
 #include "mnn/core/loss/apply_grad.h"
 #include "mnn/infra/util.h"
 #include "mnn/core/graph/sequential.h"
+#include "mnn/core/graph/model_format.h"
+#include "mnn/core/graph/checkpoint.h"
 
 namespace mnn {
 
-enum class ContentType {
-  weights,           ///< save/load the weights
-  model,             ///< save/load the network architecture
-  weights_and_model  ///< save/load both the weights and the architecture
-};
-
 struct Result {
   Result() : num_success(0), num_total(0) {}
 
@@ -80,9 +77,7 @@ class Network : NetType {
   void bprop(const std::vector<Matrix> &out,
              const std::vector<Matrix> &t,
              const std::vector<Matrix> &t_cost) {
-    std::vector<Matrix> delta = gradient<E>(out, t, t_cost);
-    NodeList& nodes = *this;
-    nodes.backward(delta);
+    bprop<E>(*this, out, t, t_cost);
   }
 
   Vector fprop(const Vector &in) {
@@ -102,11 +97,7 @@ class Network : NetType {
     return nodes.forward(in);
   }
 
-  void update_weights(Optimizer *opt) {
-    for (auto l : *this) {
-      l->update_weight(opt);
-    }
-  }
+  void update_weights(Optimizer *opt) { NetType::update_weights(opt); }
 
   Vector predict(const Vector &in) { return fprop(in); }
 
@@ -116,6 +107,67 @@ class Network : NetType {
     return fprop(in);
   }
 
+  // Zero-copy inference on caller-owned buffers of batch x
+  // in_data_size() and batch x out_data_size() floats, 64-byte aligned for
+  // the aligned SIMD paths. Once the layers have seen the batch size,
+  // predict_bound() neither allocates nor copies the samples.
+  void bind(const Float *in, Float *out, size_t batch) {
+    NetType::bind(in, out, batch);
+  }
+  void unbind() { NetType::unbind(); }
+  void predict_bound() { NetType::forward_bound(); }
+
+  // see Sequential::set_memory_planning()
+  void set_memory_planning(bool enable) {
+    NetType::set_memory_planning(enable);
+  }
+  size_t planned_size() const { return NetType::planned_size(); }
+
+  // see Sequential::set_fusion()
+  void set_fusion(bool enable) { NetType::set_fusion(enable); }
+
+  // binary model files, see model_format.h
+  void save(const std::string &filename,
+            ContentType what = ContentType::weights_and_model) const {
+    check_float_weights("save");
+    save_model(filename, std::vector<Layer *>(begin(), end()), what);
+  }
+
+  // Reads what filename holds: the model builds the layers, into an empty
+  // network, and the weights are copied into them.
+  void load(const std::string &filename,
+            ContentType what = ContentType::weights_and_model) {
+    read_model(std::make_shared<ModelFile>(filename), what, false);
+    if (what != ContentType::model) mapped_.reset();
+  }
+
+  // Like load(), but the weights stay in a read-only mapping of filename,
+  // shared with other processes mapping it, so loading costs the page
+  // faults of the weights in use. The network can predict with them but
+  // not train until load() copies weights in.
+  void map(const std::string &filename,
+           ContentType what = ContentType::weights_and_model) {
+    auto file = std::make_shared<ModelFile>(filename);
+    read_model(file, what, true);
+    mapped_ = file;
+  }
+
+  // During fit(), saves the weights and the optimizer state to path after
+  // every epoch and, with batches > 0, every batches minibatches. The
+  // files are written in the background, see Checkpointer. An empty path
+  // turns checkpoints off.
+  void set_checkpoint(const std::string &path, size_t batches = 0) {
+    checkpointer_.reset();
+    if (!path.empty()) checkpointer_ = std::make_shared<Checkpointer>(path);
+    checkpoint_batches_ = batches;
+    NetType::set_checkpointer(checkpointer_.get());
+  }
+
+  // the next fit() continues from the checkpoint at path, taken by a fit()
+  // with the same network, optimizer and inputs, and throws if its
+  // position isn't a minibatch of the inputs
+  void resume_from(const std::string &path) { resume_path_ = path; }
+
   Float predict_max_value(const Vector &in) { return fprop_max(in); }
   Label predict_label(const Vector &in) { return fprop_max_index(in); }
 
@@ -186,23 +238,82 @@ class Network : NetType {
   }
 
   void set_netphase(NetPhase phase) {
+    NetType::set_phase(phase);
     for (auto n : *this) {
       n->set_context(phase);
     }
   }
 
+  // Post-training int8 inference: the conv and fully-connected layers
+  // record the range of their inputs while samples are predicted, in
+  // batches of test_batch_size(), then quantize them per tensor, and
+  // their weights per output channel. The float weights stay, so training
+  // runs in float and the int8 weights are requantized after it; the
+  // int8 copy adds a quarter to the weight memory until
+  // release_float_weights().
+  void quantize(const std::vector<Vector> &samples) {
+    check_float_weights("quantize");
+    set_netphase(NetPhase::TESTING);
+    for (auto n : *this) n->set_quantization(Quantization::CALIBRATING);
+    std::vector<Matrix> batch;
+    for (size_t i = 0; i < samples.size(); i += test_batch_size()) {
+      const size_t n = std::min(test_batch_size(), samples.size() - i);
+      batch.resize(n);
+      for (size_t j = 0; j < n; j++) batch[j].assign(1, samples[i + j]);
+      fprop(batch);
+    }
+    for (auto n : *this) n->set_quantization(Quantization::INT8);
+  }
+
+  // Inference-only int8, after quantize(): the int8 layers free their
+  // float weights and weight gradients, leaving about a quarter of the
+  // weight memory. The network can't train, save, load weights or
+  // dequantize anymore.
+  void release_float_weights() {
+    for (auto n : *this) float_released_ |= n->release_float_weights();
+  }
+
+  // back to float inference
+  void dequantize() {
+    check_float_weights("dequantize");
+    for (auto n : *this) n->set_quantization(Quantization::NONE);
+  }
+
+  // Half precision weights for inference, typically picked right after
+  // load() or map(): the fully-connected layers keep a copy of their
+  // weights rounded to the precision pick returns for them and widen it
+  // to Float as it streams in, halving the weight traffic. Training stays
+  // in Float and refreshes the copies; int8 layers stay int8.
+  void set_precision(const std::function<Precision(const Layer &)> &pick) {
+    set_netphase(NetPhase::TESTING);
+    for (auto n : *this) n->set_precision(pick(*n));
+  }
+
+  void set_precision(Precision precision) {
+    set_precision([precision](const Layer &) { return precision; });
+  }
+
   void stop_ongoing_training() { stop_training_ = true; }
 
+  // runs in batches of test_batch_size() samples
   Result test(const std::vector<Vector> &in, const std::vector<Label> &t) {
     Result test_result;
     set_netphase(NetPhase::TESTING);
-    for (size_t i = 0; i < in.size(); i++) {
-      const Label predicted = fprop_max_index(in[i]);
-      const Label actual    = t[i];
-
-      if (predicted == actual) test_result.num_success++;
-      test_result.num_total++;
-      test_result.confusion_matrix[predicted][actual]++;
+    std::vector<Matrix> batch;
+    for (size_t i = 0; i < in.size(); i += test_batch_size()) {
+      const size_t n = std::min(test_batch_size(), in.size() - i);
+      batch.resize(n);
+      for (size_t j = 0; j < n; j++) batch[j].assign(1, in[i + j]);
+      const std::vector<Matrix> out = fprop(batch);
+
+      for (size_t j = 0; j < n; j++) {
+        const Label predicted = Label(max_index(out[j][0]));
+        const Label actual    = t[i + j];
+
+        if (predicted == actual) test_result.num_success++;
+        test_result.num_total++;
+        test_result.confusion_matrix[predicted][actual]++;
+      }
     }
     return test_result;
   }
@@ -259,30 +370,119 @@ class Network : NetType {
            const bool reset_weights            = false,
            const int n_threads                 = MNN_TASK_SIZE,
            const std::vector<Matrix> &t_cost = std::vector<Matrix>()) {
+    if (mapped_) {
+      throw MnnError("Can't train a network mapped from a file");
+    }
+    check_float_weights("train");
     check_target_cost_matrix(desired_outputs, t_cost);
     set_netphase(NetPhase::TRAINING);
     NetType::setup(reset_weights);
 
     for (auto n : *this) n->set_parallelize(true);
     optimizer.reset();
+    for (auto n : *this) n->register_weights(&optimizer);
+    make_replicas(n_threads, batch_size);
+    const std::vector<Layer *> layers(begin(), end());
+    CheckpointPosition from;
+    if (!resume_path_.empty()) {
+      from = Checkpointer::restore(resume_path_, layers, optimizer);
+      resume_path_.clear();
+      // checkpoints are taken between minibatches, before the last one
+      if (from.sample % batch_size != 0 ||
+          (from.sample != 0 && from.sample >= inputs.size())) {
+        throw MnnError("The checkpoint was taken on another training set "
+                       "or batch size");
+      }
+    }
     stop_training_ = false;
-    in_batch_.resize(batch_size);
-    t_batch_.resize(batch_size);
-    for (int iter = 0; iter < epoch && !stop_training_; iter++) {
-      for (size_t i = 0; i < inputs.size() && !stop_training_;
+    size_t batches = 0;
+    for (int iter = static_cast<int>(from.epoch);
+         iter < epoch && !stop_training_; iter++) {
+      const bool resumed = iter == static_cast<int>(from.epoch);
+      for (size_t i = resumed ? from.sample : 0; i < inputs.size() && !stop_training_;
            i += batch_size) {
         train_once<Error>(
           optimizer, &inputs[i], &desired_outputs[i],
           static_cast<int>(std::min(batch_size, (size_t)inputs.size() - i)),
           n_threads, get_target_cost_sample_pointer(t_cost, i));
         on_batch_enumerate();
+        if (checkpointer_ && checkpoint_batches_ != 0 &&
+            ++batches % checkpoint_batches_ == 0 &&
+            i + batch_size < inputs.size()) {
+          checkpointer_->snapshot(layers, optimizer,
+                                  {static_cast<size_t>(iter), i + batch_size});
+        }
+      }
+      if (checkpointer_ && !stop_training_) {
+        checkpointer_->snapshot(layers, optimizer,
+                                {static_cast<size_t>(iter) + 1, 0});
       }
       on_epoch_enumerate();
     }
+    if (checkpointer_) checkpointer_->wait();
+    replicas_.clear();
     set_netphase(NetPhase::TESTING);
     return true;
   }
 
+  void read_model(const std::shared_ptr<ModelFile> &file,
+                  ContentType what,
+                  bool in_place) {
+    if (what != ContentType::model) check_float_weights("load weights into");
+    if (what != ContentType::weights) {
+      if (NetType::size() != 0) {
+        throw MnnError("Can't load a model into a network with layers");
+      }
+      for (auto &l : file->make_layers()) NetType::add(l);
+    }
+    if (what != ContentType::model) {
+      file->load_weights(std::vector<Layer *>(begin(), end()), in_place);
+    }
+  }
+
+  // backward of net, from the loss of its outputs out
+  template <typename E>
+  static void bprop(NetType &net,
+                    const std::vector<Matrix> &out,
+                    const std::vector<Matrix> &t,
+                    const std::vector<Matrix> &t_cost) {
+    std::vector<Matrix> delta = gradient<E>(out, t, t_cost);
+    if (IncludesSoftmax<E>::value) {
+      net.backward_from_logits(delta);
+      return;
+    }
+    NodeList &nodes = net;
+    nodes.backward(delta);
+  }
+
+  // Minibatches are split over up to n_threads workers, as many as the
+  // thread pool runs at once, each with its own replica of the layers for
+  // activations and gradients but this network's weights; the first
+  // worker uses this network. Networks with a layer that can't be cloned
+  // are trained unsharded, with no replicas.
+  void make_replicas(int n_threads, size_t batch_size) {
+    size_t workers = std::min(static_cast<size_t>(std::max(n_threads, 1)),
+                              parallel_workers());
+    workers = std::min(workers, batch_size / min_shard_size());
+    replicas_.clear();
+    for (size_t w = 1; w < workers; w++) {
+      auto replica = NetType::replicate();
+      if (!replica) {
+        replicas_.clear();
+        return;
+      }
+      replicas_.push_back(replica);
+      for (auto n : *replicas_.back()) {
+        n->set_parallelize(false);
+        n->set_context(NetPhase::TRAINING);
+      }
+    }
+  }
+
+  // below this many samples per worker the layers' own loops are faster
+  static size_t min_shard_size() { return 4; }
+  static size_t test_batch_size() { return 64; }
+
   template <typename E, typename Optimizer>
   void train_once(Optimizer &optimizer,
                   const Matrix *in,
@@ -305,17 +505,57 @@ class Network : NetType {
                       int batch_size,
                       const int num_tasks,
                       const Matrix *t_cost) {
-    MNN_UNREFERENCED_PARAMETER(num_tasks);
-    std::copy(&in[0], &in[0] + batch_size, &in_batch_[0]);
-    std::copy(&t[0], &t[0] + batch_size, &t_batch_[0]);
+    size_t workers = std::min(replicas_.size() + 1,
+                              static_cast<size_t>(std::max(num_tasks, 1)));
+    workers = std::min(workers,
+                       static_cast<size_t>(batch_size) / min_shard_size());
+    if (workers > 1) {
+      train_sharded<E>(optimizer, in, t, batch_size, workers, t_cost);
+      return;
+    }
+
+    // exactly this batch, which may be the short last one
+    std::vector<Matrix> in_batch(in, in + batch_size);
+    std::vector<Matrix> t_batch(t, t + batch_size);
     std::vector<Matrix> t_cost_batch =
-      t_cost ? std::vector<Matrix>(&t_cost[0], &t_cost[0] + batch_size)
+      t_cost ? std::vector<Matrix>(t_cost, t_cost + batch_size)
              : std::vector<Matrix>();
 
-    bprop<E>(fprop(in_batch_), t_batch_, t_cost_batch);
+    bprop<E>(fprop(in_batch), t_batch, t_cost_batch);
     NetType::update_weights(&optimizer);
   }
 
+  // forward and backward of workers contiguous shards of the batch at
+  // once, then one step on the gradients of all of them
+  template <typename E, typename Optimizer>
+  void train_sharded(Optimizer &optimizer,
+                     const Matrix *in,
+                     const Matrix *t,
+                     size_t batch_size,
+                     size_t workers,
+                     const Matrix *t_cost) {
+    for (auto n : *this) n->set_parallelize(false);
+    for_i(true, workers, [&](size_t w) {
+      const size_t begin = w * batch_size / workers;
+      const size_t end   = (w + 1) * batch_size / workers;
+      NetType &net = w == 0 ? *this : *replicas_[w - 1];
+      std::vector<Matrix> in_shard(in + begin, in + end);
+      std::vector<Matrix> t_shard(t + begin, t + end);
+      std::vector<Matrix> t_cost_shard =
+        t_cost ? std::vector<Matrix>(t_cost + begin, t_cost + end)
+               : std::vector<Matrix>();
+      NodeList &nodes = net;
+      bprop<E>(net, nodes.forward(in_shard), t_shard, t_cost_shard);
+    }, 1);
+    for (auto n : *this) n->set_parallelize(true);
+
+    std::vector<NodeList *> replicas;
+    for (size_t w = 1; w < workers; w++) {
+      replicas.push_back(replicas_[w - 1].get());
+    }
+    NetType::update_weights(&optimizer, replicas);
+  }
+
   void check_target_cost_matrix(const std::vector<Matrix> &t,
                                 const std::vector<Matrix> &t_cost) {
     if (!t_cost.empty()) {
@@ -380,9 +620,20 @@ class Network : NetType {
     normalize_tensor(vec, normalized);
   }
 
+  void check_float_weights(const std::string &what) const {
+    if (float_released_) {
+      throw MnnError("Can't " + what +
+                     " a network whose float weights were released");
+    }
+  }
+
   std::string name_;
   bool stop_training_;
-  std::vector<Matrix> in_batch_;
-  std::vector<Matrix> t_batch_;
+  bool float_released_ = false;  // see release_float_weights()
+  std::vector<std::shared_ptr<NetType>> replicas_;
+  std::shared_ptr<ModelFile> mapped_;  // holds the weights after map()
+  std::shared_ptr<Checkpointer> checkpointer_;
+  size_t checkpoint_batches_ = 0;
+  std::string resume_path_;
 };
 }  // namespace mnn
@@ -13,6 +13,8 @@
 
 namespace mnn {
 
+class Checkpointer;
+
 class NodeList {
 public:
     typedef std::vector<Layer*>::iterator iterator;
@@ -24,8 +26,14 @@ public:
     virtual std::vector<Matrix> forward(const std::vector<Matrix> &first) = 0;
 
     virtual void update_weights(Optimizer *opt);
+    // with the gradients of replicas of this network added to its own
+    void update_weights(Optimizer *opt, const std::vector<NodeList*> &replicas);
     virtual void setup(bool reset_weight);
 
+    // a checkpoint in progress keeps copies of the weights before the
+    // updates change them
+    void set_checkpointer(Checkpointer *checkpointer);
+
     void clear_grads();
     size_t size() const;
 
@@ -81,6 +89,7 @@ protected:
 
     std::vector<std::shared_ptr<Layer>> own_nodes_;
     std::vector<Layer*> nodes_;
+    Checkpointer *checkpointer_ = nullptr;
 };
 
 }  // namespace mnn
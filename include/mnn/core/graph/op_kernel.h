@@ -12,6 +12,8 @@
 #include <string>
 #include <vector>
 
+#include "mnn/core/graph/tensor.h"
+#include "mnn/core/graph/epilogue.h"
 #include "mnn/core/params/conv_params.h"
 #include "mnn/infra/backend.h"
 
@@ -45,6 +47,9 @@ public:
         Params *params_ptr_ = nullptr;
         bool parallelize = false;
         BackendType engine = default_engine();
+        const Epilogue *epilogue = nullptr;
+        Float input_step = 0;
+        Precision weight_precision = Precision::FLOAT;
     };
 
     OpKernelContext() : in_data_(nullptr), out_data_(nullptr), out_grad_(
@@ -54,56 +59,56 @@ public:
     }
 
     void set_in_out(
-            const std::vector<Matrix*> &in_data,
-            std::vector<Matrix*> &out_data)
+            const std::vector<Tensor<>*> &in_data,
+            std::vector<Tensor<>*> &out_data)
     {
-        in_data_ = const_cast<std::vector<Matrix*>*>(&in_data);
+        in_data_ = const_cast<std::vector<Tensor<>*>*>(&in_data);
         out_data_ = &out_data;
     }
 
     void set_in_out(
-            const std::vector<Matrix*> &in_data,
-            const std::vector<Matrix*> &out_data,
-            std::vector<Matrix*> &out_grad, std::vector<Matrix*> &in_grad)
+            const std::vector<Tensor<>*> &in_data,
+            const std::vector<Tensor<>*> &out_data,
+            std::vector<Tensor<>*> &out_grad, std::vector<Tensor<>*> &in_grad)
     {
-        in_data_ = const_cast<std::vector<Matrix*>*>(&in_data);
-        out_data_ = const_cast<std::vector<Matrix*>*>(&out_data);
+        in_data_ = const_cast<std::vector<Tensor<>*>*>(&in_data);
+        out_data_ = const_cast<std::vector<Tensor<>*>*>(&out_data);
         out_grad_ = &out_grad;
         in_grad_ = &in_grad;
     }
 
-    Matrix& input(const int idx)
+    Tensor<>& input(const int idx)
     {
         return *(*in_data_)[idx];
     }
-    const Matrix& input(const int idx) const
+    const Tensor<>& input(const int idx) const
     {
         return *(*in_data_)[idx];
     }
 
-    Matrix& output(const int idx)
+    Tensor<>& output(const int idx)
     {
         return *(*out_data_)[idx];
     }
-    const Matrix& output(const int idx) const
+    const Tensor<>& output(const int idx) const
     {
         return *(*out_data_)[idx];
     }
 
-    Matrix& input_grad(const int idx)
+    Tensor<>& input_grad(const int idx)
     {
         return *(*in_grad_)[idx];
     }
-    const Matrix& input_grad(const int idx) const
+    const Tensor<>& input_grad(const int idx) const
     {
         return *(*in_grad_)[idx];
     }
 
-    Matrix& output_grad(const int idx)
+    Tensor<>& output_grad(const int idx)
     {
         return *(*out_grad_)[idx];
     }
-    const Matrix& output_grad(const int idx) const
+    const Tensor<>& output_grad(const int idx) const
     {
         return *(*out_grad_)[idx];
     }
@@ -134,12 +139,39 @@ public:
     {
         op_params_->engine = engine;
     }
+    // run on the outputs, if any
+    const Epilogue* epilogue() const
+    {
+        return op_params_->epilogue;
+    }
+    void setEpilogue(const Epilogue *epilogue)
+    {
+        op_params_->epilogue = epilogue;
+    }
+    // quantization step of input(0) for int8 kernels, 0 for float
+    Float input_step() const
+    {
+        return op_params_->input_step;
+    }
+    void setInputStep(const Float step)
+    {
+        op_params_->input_step = step;
+    }
+    // storage of the weights for half precision kernels
+    Precision weight_precision() const
+    {
+        return op_params_->weight_precision;
+    }
+    void setWeightPrecision(const Precision precision)
+    {
+        op_params_->weight_precision = precision;
+    }
 
 private:
-    std::vector<Matrix*> *in_data_;
-    std::vector<Matrix*> *out_data_;
-    std::vector<Matrix*> *out_grad_;
-    std::vector<Matrix*> *in_grad_;
+    std::vector<Tensor<>*> *in_data_;
+    std::vector<Tensor<>*> *out_data_;
+    std::vector<Tensor<>*> *out_grad_;
+    std::vector<Tensor<>*> *in_grad_;
 
     std::unique_ptr<OpParams> op_params_;
 };
@@ -155,6 +187,17 @@ public:
 
     virtual void compute(OpKernelContext &context) = 0;
 
+    // drops anything derived from the weights, called after they changed
+    virtual void invalidate() {}
+
+    // builds the int8 weights from W, which is then released, and drops
+    // the float copies derived from it, see Layer::release_float_weights()
+    virtual void prepare_int8(Span<const Float> W, bool parallelize)
+    {
+        MNN_UNREFERENCED_PARAMETER(W);
+        MNN_UNREFERENCED_PARAMETER(parallelize);
+    }
+
 protected:
     Params *params_ = nullptr;
 };
@@ -0,0 +1,45 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include "mnn/core/graph/tensor.h"
+#include "mnn/infra/util.h"
+
+namespace mnn {
+
+// how a layer with int8 kernels runs inference
+enum class Quantization {
+  NONE,         // in float
+  CALIBRATING,  // in float, recording the range of its inputs
+  INT8          // in int8 within the recorded range
+};
+
+// Picks the quantization step of a layer's input: symmetric per tensor,
+// with the largest magnitude seen while calibrating mapped to 127.
+// Training always runs in float.
+class InputQuantizer {
+ public:
+  void set_mode(Quantization mode);
+  void set_phase(NetPhase phase) { phase_ = phase; }
+
+  // the step to quantize in with, or 0 for float
+  Float step(const Tensor<> &in);
+
+  // whether step() quantizes outside training
+  bool calibrated() const {
+    return mode_ == Quantization::INT8 && absmax_ > 0;
+  }
+
+ private:
+  Quantization mode_ = Quantization::NONE;
+  NetPhase phase_    = NetPhase::TRAINING;
+  Float absmax_      = 0;
+};
+
+}  // namespace mnn
@@ -35,11 +35,65 @@ public:
         check_connectivity();
     }
 
+    // runs batch samples from in to out without copying them; both stay
+    // bound until unbind() or the next Matrix based forward()
+    void bind(const Float *in, Float *out, size_t batch);
+    void unbind();
+    void forward_bound();
+
+    // backward with gradients taken with respect to the input of the
+    // closing SoftmaxLayer, which is skipped
+    void backward_from_logits(const std::vector<Matrix> &first);
+
+    // Shares activation and gradient buffers between layers that are
+    // never live at the same time, per the liveness of the phase: TESTING
+    // keeps only the activations around the running layer and no
+    // gradients, TRAINING keeps the activations for backward but only two
+    // gradients. Element-wise layers run in place. Off by default.
+    void set_memory_planning(bool enable);
+    void set_phase(NetPhase phase);
+
+    // elements in the planned arenas
+    size_t planned_size() const;
+
+    // Folds element-wise layers (tanh, relu, ...) into the output loop of
+    // the convolutional, fully-connected or average-pooling layer before
+    // them in the TESTING phase, so their outputs are written once and
+    // activated while still in cache. The producer then writes straight
+    // into the folded layer's output. Off by default.
+    void set_fusion(bool enable);
+
+    // the same layers, cloned, see Layer::clone(), or null if one of
+    // them can't be
+    std::shared_ptr<Sequential> replicate() const;
+
 private:
     friend class NodeList;
 
     void check_connectivity();
-    std::vector<Matrix> normalize_out(const std::vector<const Matrix*> &out);
+    bool bound_ = false;
+    size_t bound_samples_ = 0;
+
+    void plan_memory(size_t sample_count);
+    void release_plan();
+
+    void fuse_layers(size_t sample_count);
+    void unfuse_layers();
+    void run_forward();
+    void run_backward(const std::vector<Matrix> &first, size_t layers);
+
+    bool fusion_ = false;
+    // fused_[l]: layer l runs inside layer l - 1
+    std::vector<bool> fused_;
+
+    bool planning_ = false;
+    bool planned_ = false;
+    NetPhase phase_ = NetPhase::TRAINING;
+    NetPhase planned_phase_ = NetPhase::TRAINING;
+    size_t planned_samples_ = 0;
+    Vector data_arena_;
+    Vector grad_arena_;
+    std::vector<Matrix> normalize_out(const std::vector<const Tensor<>*> &out);
 };
 
 } // namespace mnn
@@ -9,39 +9,254 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include <algorithm>
+#include <functional>
+#include <numeric>
+#include <type_traits>
+#include <initializer_list>
+
+#include "mnn/infra/util.h"
 
 namespace mnn {
 
-template <typename U = Float, typename Storage = std::vector<U>>
-class Tensor {
-  typedef U *UPtr;
+// non-owning view of size contiguous elements
+template <typename U>
+class Span {
+ public:
+  typedef U value_type;
+  typedef U *iterator;
+
+  Span() : data_(nullptr), size_(0) {}
+  Span(U *data, size_t size) : data_(data), size_(size) {}
+
+  // from any contiguous container, e.g. Vector or a Span of non-const U
+  template <typename C,
+            typename = typename std::enable_if<std::is_convertible<
+              decltype(std::declval<C &>().data()), U *>::value>::type>
+  Span(C &&c) : data_(c.data()), size_(c.size()) {}  // NOLINT
+
+  U *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  U *begin() const { return data_; }
+  U *end() const { return data_ + size_; }
 
+  U &operator[](size_t i) const { return data_[i]; }
+
+ private:
+  U *data_;
+  size_t size_;
+};
+
+// N-d row-major tensor over one contiguous buffer. Axis 0 is the sample
+// axis of a batch; slice() and reshape() return views sharing the buffer,
+// while copies are always deep. A tensor may also borrow caller-owned
+// memory, which it then never frees or reallocates.
+template <typename U = Float,
+          typename Storage = std::vector<U, AlignedAllocator<U, 64>>>
+class Tensor {
  public:
-  Tensor() {}
-  explicit Tensor(std::vector<size_t> const &shape) : storage_(shape) {}
-  explicit Tensor(std::initializer_list<size_t> const &shape)
-    : storage_(shape) {}
+  typedef U value_type;
+
+  Tensor()
+    : storage_(std::make_shared<Storage>()), external_(nullptr), offset_(0) {}
+
+  explicit Tensor(const std::vector<size_t> &shape, U value = U(0))
+    : storage_(std::make_shared<Storage>(product(shape), value)),
+      external_(nullptr),
+      shape_(shape),
+      offset_(0) {
+    update_strides();
+  }
+
+  // borrows data, which must outlive the tensor and its views
+  Tensor(U *data, const std::vector<size_t> &shape)
+    : external_(data), shape_(shape), offset_(0) {
+    update_strides();
+  }
 
-  explicit Tensor(std::initializer_list<size_t> const &shape, U value)
-    : storage_(shape, value) {}
+  explicit Tensor(std::initializer_list<size_t> shape, U value = U(0))
+    : Tensor(std::vector<size_t>(shape), value) {}
 
-  Tensor<U> &operator=(const Tensor<U> &T) {
-    storage_ = T.storage_;
+  Tensor(const Tensor &other)
+    : storage_(std::make_shared<Storage>(other.begin(), other.end())),
+      external_(nullptr),
+      shape_(other.shape_),
+      offset_(0) {
+    update_strides();
+  }
+
+  Tensor(Tensor &&other) = default;
+
+  Tensor &operator=(const Tensor &other) {
+    if (this != &other) {
+      Tensor tmp(other);
+      *this = std::move(tmp);
+    }
     return *this;
   }
 
-  const size_t size() const { return storage_.size(); }
+  Tensor &operator=(Tensor &&other) = default;
+
+  size_t rank() const { return shape_.size(); }
+  const std::vector<size_t> &shape() const { return shape_; }
+  size_t shape(size_t axis) const { return shape_[axis]; }
+  const std::vector<size_t> &strides() const { return strides_; }
+
+  // a default Tensor has no shape and no elements
+  size_t numel() const { return shape_.empty() ? 0 : product(shape_); }
+
+  // elements per entry along axis 0
+  size_t sample_size() const {
+    if (shape_.empty() || shape_[0] == 0) return 0;
+    return numel() / shape_[0];
+  }
+
+  bool is_contiguous() const {
+    size_t stride = 1;
+    for (size_t i = shape_.size(); i-- > 0;) {
+      if (shape_[i] != 1 && strides_[i] != stride) return false;
+      stride *= shape_[i];
+    }
+    return true;
+  }
+
+  U *data() { return base() + offset_; }
+  const U *data() const { return base() + offset_; }
+
+  bool is_borrowed() const { return external_ != nullptr; }
+
+  U *begin() { return data(); }
+  U *end() { return data() + numel(); }
+  const U *begin() const { return data(); }
+  const U *end() const { return data() + numel(); }
+
+  // the n-th sample
+  Span<U> operator[](size_t n) {
+    return Span<U>(data() + n * strides_[0], sample_size());
+  }
+  Span<const U> operator[](size_t n) const {
+    return Span<const U>(data() + n * strides_[0], sample_size());
+  }
+
+  // samples [begin, end) as a view
+  Tensor slice(size_t begin, size_t end) const {
+    if (shape_.empty() || begin > end || end > shape_[0]) {
+      throw MnnError("Tensor slice out of range");
+    }
+    Tensor view(*this, storage_);
+    view.shape_[0] = end - begin;
+    view.offset_ = offset_ + begin * strides_[0];
+    return view;
+  }
+
+  // the same elements under another shape, as a view
+  Tensor reshape(const std::vector<size_t> &shape) const {
+    if (product(shape) != numel()) {
+      throw MnnError("Tensor reshape changes the element count");
+    }
+    Tensor view(*this, storage_);
+    view.shape_ = shape;
+    view.update_strides();
+    return view;
+  }
+
+  // reshapes in place keeping the leading elements, which on a batch are
+  // the leading samples. The buffer object is kept, so pointers to
+  // storage() stay valid, but views taken before may not.
+  Tensor &resize(const std::vector<size_t> &shape, U value = U(0)) {
+    if (shape == shape_) {
+      return *this;
+    }
+    if (offset_ != 0 || external_) {
+      throw MnnError("Can't resize a tensor view");
+    }
+    storage_->resize(product(shape), value);
+    shape_ = shape;
+    update_strides();
+    return *this;
+  }
 
   Tensor &fill(U value) {
-    std::fill(storage_.begin(), storage_.end(), value);
+    std::fill(begin(), end(), value);
     return *this;
   }
 
-  Tensor operator[](size_t index) { return Tensor(storage_[index]); }
+  Storage &storage() {
+    if (external_) throw MnnError("Tensor doesn't own its buffer");
+    return *storage_;
+  }
+  const Storage &storage() const {
+    if (external_) throw MnnError("Tensor doesn't own its buffer");
+    return *storage_;
+  }
+
+  template <typename... Args>
+  U &at(Args... args) {
+    return data()[offset_of({static_cast<size_t>(args)...})];
+  }
+
+  template <typename... Args>
+  const U &at(Args... args) const {
+    return data()[offset_of({static_cast<size_t>(args)...})];
+  }
 
  private:
-  Storage storage_;
+  // a view of other's buffer
+  Tensor(const Tensor &other, const std::shared_ptr<Storage> &storage)
+    : storage_(storage),
+      external_(other.external_),
+      shape_(other.shape_),
+      strides_(other.strides_),
+      offset_(other.offset_) {}
+
+  U *base() const { return external_ ? external_ : storage_->data(); }
+
+  static size_t product(const std::vector<size_t> &shape) {
+    return std::accumulate(shape.begin(), shape.end(), size_t(1),
+                           std::multiplies<size_t>());
+  }
+
+  void update_strides() {
+    strides_.resize(shape_.size());
+    size_t stride = 1;
+    for (size_t i = shape_.size(); i-- > 0;) {
+      strides_[i] = stride;
+      stride *= shape_[i];
+    }
+  }
+
+  size_t offset_of(std::initializer_list<size_t> index) const {
+    if (index.size() != shape_.size()) {
+      throw MnnError("Tensor index rank mismatch");
+    }
+    size_t offset = 0, axis = 0;
+    for (size_t i : index) {
+      if (i >= shape_[axis]) {
+        throw MnnError("Tensor index out of range");
+      }
+      offset += i * strides_[axis++];
+    }
+    return offset;
+  }
+
+  std::shared_ptr<Storage> storage_;
+  U *external_;
+  std::vector<size_t> shape_;
+  std::vector<size_t> strides_;
+  size_t offset_;
 };
 
+// one Vector per sample, for the Matrix based interfaces
+template <typename Storage>
+Matrix to_matrix(const Tensor<Float, Storage> &tensor) {
+  Matrix m(tensor.rank() == 0 ? 0 : tensor.shape(0));
+  for (size_t sample = 0; sample < m.size(); sample++) {
+    m[sample].assign(tensor[sample].begin(), tensor[sample].end());
+  }
+  return m;
+}
+
 }  // namespace mnn
@@ -30,19 +30,27 @@ public:
             size_t stride_y, bool ceil_mode = false, Padding pad_type =
                     Padding::VALID);
 
+    std::shared_ptr<Layer> clone() const override;
+    std::vector<size_t> shape_params() const override;
+
+    size_t fan_in_size() const override;
+    size_t fan_out_size() const override;
+
     std::vector<Index3d<size_t>> in_shape() const override;
     std::vector<Index3d<size_t>> out_shape() const override;
     std::string layer_type() const override;
 
     void forward_propagation(
-            const std::vector<Matrix*> &in_data,
-            std::vector<Matrix*> &out_data) override;
+            const std::vector<Tensor<>*> &in_data,
+            std::vector<Tensor<>*> &out_data) override;
 
     void back_propagation(
-            const std::vector<Matrix*> &in_data,
-            const std::vector<Matrix*> &out_data,
-            std::vector<Matrix*> &out_grad,
-            std::vector<Matrix*> &in_grad) override;
+            const std::vector<Tensor<>*> &in_data,
+            const std::vector<Tensor<>*> &out_data,
+            std::vector<Tensor<>*> &out_grad,
+            std::vector<Tensor<>*> &in_grad) override;
+
+    bool set_epilogue(const Epilogue &epilogue) override;
 
     std::pair<size_t, size_t> pool_size() const;
 
@@ -51,14 +59,14 @@ private:
     size_t stride_y_;
     size_t pool_size_x_;
     size_t pool_size_y_;
+    bool ceil_mode_;
+    Padding pad_type_;
     Shape3d in_;
     Shape3d out_;
     Shape3d w_;
+    Epilogue epilogue_;
 
     static size_t pool_out_dim(size_t in_size, size_t pooling_size,size_t stride);
-
-    void init_connection(size_t pooling_size_x, size_t pooling_size_y);
-    void connect_kernel(size_t pooling_size_x, size_t pooling_size_y, size_t x,size_t y, size_t inc);
 };
 
 }  // namespace mnn
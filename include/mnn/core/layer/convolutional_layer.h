@@ -10,6 +10,7 @@
 
 #include "mnn/core/layer/layer.h"
 #include "mnn/core/graph/op_kernel.h"
+#include "mnn/core/graph/quantization.h"
 #include "mnn/infra/backend.h"
 
 namespace mnn {
@@ -42,20 +43,30 @@ public:
             size_t h_stride = 1, size_t w_dilation = 1, size_t h_dilation = 1,
             BackendType backend_type = default_engine());
 
+    ConvolutionalLayer(const ConvolutionalLayer &other);
     ConvolutionalLayer(ConvolutionalLayer &&other);
 
+    std::shared_ptr<Layer> clone() const override;
+    std::vector<size_t> shape_params() const override;
+
     size_t fan_in_size() const override;
     size_t fan_out_size() const override;
 
     void forward_propagation(
-            const std::vector<Matrix*> &in_data,
-            std::vector<Matrix*> &out_data) override;
+            const std::vector<Tensor<>*> &in_data,
+            std::vector<Tensor<>*> &out_data) override;
 
     void back_propagation(
-            const std::vector<Matrix*> &in_data,
-            const std::vector<Matrix*> &out_data,
-            std::vector<Matrix*> &out_grad,
-            std::vector<Matrix*> &in_grad) override;
+            const std::vector<Tensor<>*> &in_data,
+            const std::vector<Tensor<>*> &out_data,
+            std::vector<Tensor<>*> &out_grad,
+            std::vector<Tensor<>*> &in_grad) override;
+
+    void post_update() override;
+    bool set_epilogue(const Epilogue &epilogue) override;
+    void set_context(NetPhase phase) override;
+    bool set_quantization(Quantization mode) override;
+    bool release_float_weights() override;
 
     void set_sample_count(size_t sample_count) override;
     std::string layer_type() const override;
@@ -64,7 +75,7 @@ public:
     std::vector<Index3d<size_t>> out_shape() const override;
 
 private:
-    Matrix* in_data_padded(const std::vector<Matrix*> &in);
+    Tensor<>* in_data_padded(const std::vector<Tensor<>*> &in);
     void conv_set_params(const Shape3d &in, size_t w_width, size_t w_height,
             size_t outc, Padding ptype, bool has_bias, size_t w_stride,
             size_t h_stride, size_t w_dilation, size_t h_dilation,
@@ -96,18 +107,24 @@ private:
     /* backward op context */
     OpKernelContext bwd_ctx_;
 
+    /* fused element-wise layer, run on the outputs */
+    Epilogue epilogue_;
+
+    /* range of the inputs for int8 inference */
+    InputQuantizer quantizer_;
+
     /* Forward and backward ops */
     std::shared_ptr<OpKernel> kernel_fwd_;
     std::shared_ptr<OpKernel> kernel_back_;
 
-    std::vector<Matrix*> fwd_in_data_;
-    std::vector<Matrix*> bwd_in_data_;
-    std::vector<Matrix*> bwd_in_grad_;
+    std::vector<Tensor<>*> fwd_in_data_;
+    std::vector<Tensor<>*> bwd_in_data_;
+    std::vector<Tensor<>*> bwd_in_grad_;
 
     /* Buffer to store padded data */
     struct conv_layer_worker_specific_storage {
-        Matrix prev_out_padded_;
-        Matrix prev_delta_padded_;
+        Tensor<> prev_out_padded_;
+        Tensor<> prev_delta_padded_;
     } cws_;
 }
 ;
@@ -10,6 +10,7 @@
 
 #include "mnn/core/layer/layer.h"
 #include "mnn/core/graph/op_kernel.h"
+#include "mnn/core/graph/quantization.h"
 
 namespace mnn {
 
@@ -19,26 +20,39 @@ public:
             size_t in_dim, size_t out_dim, bool has_bias = true,
             BackendType backend_type = default_engine());
 
+    FullyConnectedLayer(const FullyConnectedLayer &other);
     FullyConnectedLayer(FullyConnectedLayer &&other);
 
+    std::shared_ptr<Layer> clone() const override;
+    std::vector<size_t> shape_params() const override;
+
     size_t fan_in_size() const override;
     size_t fan_out_size() const override;
+    size_t weight_grad_slots(size_t sample_count) const override;
 
     std::vector<Index3d<size_t>> in_shape() const override;
     std::vector<Index3d<size_t>> out_shape() const override;
 
     void forward_propagation(
-            const std::vector<Matrix*> &in_data,
-            std::vector<Matrix*> &out_data) override;
+            const std::vector<Tensor<>*> &in_data,
+            std::vector<Tensor<>*> &out_data) override;
 
     void back_propagation(
-            const std::vector<Matrix*> &in_data,
-            const std::vector<Matrix*> &out_data,
-            std::vector<Matrix*> &out_grad,
-            std::vector<Matrix*> &in_grad) override;
+            const std::vector<Tensor<>*> &in_data,
+            const std::vector<Tensor<>*> &out_data,
+            std::vector<Tensor<>*> &out_grad,
+            std::vector<Tensor<>*> &in_grad) override;
 
     std::string layer_type() const override;
 
+    bool set_epilogue(const Epilogue &epilogue) override;
+
+    void post_update() override;
+    void set_context(NetPhase phase) override;
+    bool set_quantization(Quantization mode) override;
+    bool release_float_weights() override;
+    bool set_precision(Precision precision) override;
+
 protected:
     void set_params(const size_t in_size, const size_t out_size, bool has_bias);
     void init_backend(BackendType backend_type);
@@ -47,6 +61,10 @@ private:
     FullyParams params_;
     OpKernelContext fwd_ctx_;
     OpKernelContext bwd_ctx_;
+    Epilogue epilogue_;
+    InputQuantizer quantizer_;
+    Precision precision_ = Precision::FLOAT;
+    NetPhase phase_ = NetPhase::TRAINING;
 
     std::shared_ptr<OpKernel> kernel_fwd_;
     std::shared_ptr<OpKernel> kernel_back_;
@@ -9,6 +9,9 @@
 #pragma once
 
 #include "mnn/core/graph/node.h"
+#include "mnn/core/graph/tensor.h"
+#include "mnn/core/graph/epilogue.h"
+#include "mnn/core/graph/quantization.h"
 #include "mnn/core/optimizer/optimizer.h"
 #include "mnn/infra/weight_init.h"
 
@@ -47,11 +50,19 @@ public:
 
     std::vector<Shape3d> out_data_shape();
 
-    std::vector<const Vector*> weights() const;
+    // also readable on a network mapped from a file, see Network::map()
+    std::vector<Span<const Float>> weights() const;
 
+    // Call post_update() after writing through these. Throws on a mapped
+    // network, whose weights are read-only.
     std::vector<Vector*> weights();
 
-    std::vector<Matrix*> weights_grads();
+    std::vector<Tensor<>*> weights_grads();
+
+    // Sets the weights, in weights() order, from data: copied, or with
+    // in_place used where they are, which the layer then only reads, so
+    // it predicts but can't train.
+    void load_weights(const std::vector<const Float*> &data, bool in_place);
 
     std::vector<edgeptr_t> inputs();
     std::vector<edgeptr_t> outputs();
@@ -61,7 +72,7 @@ public:
     void set_out_grads(const std::vector<const Vector*> *grad, size_t cnt);
     void set_in_data(const std::vector<const Vector*> *data, size_t cnt);
 
-    void output(std::vector<const Matrix*> &out) const;
+    void output(std::vector<const Tensor<>*> &out) const;
 
     std::vector<VectorType> in_types() const;
     std::vector<VectorType> out_types() const;
@@ -81,6 +92,12 @@ public:
     virtual size_t fan_out_size(size_t) const;
     virtual void set_sample_count(size_t sample_count);
 
+    // Weight and bias gradients are accumulated in this many slots, each
+    // taking a contiguous share of the batch, and summed by merge_grads().
+    // One per worker by default, so they don't grow with the batch, and
+    // one on layers that don't parallelize.
+    virtual size_t weight_grad_slots(size_t sample_count) const;
+
     template<typename WeightInit>
     Layer& weight_init(const WeightInit &f)
     {
@@ -110,18 +127,57 @@ public:
     }
 
     virtual void forward_propagation(
-            const std::vector<Matrix*> &in_data,
-            std::vector<Matrix*> &out_data) = 0;
+            const std::vector<Tensor<>*> &in_data,
+            std::vector<Tensor<>*> &out_data) = 0;
 
     virtual void back_propagation(
-            const std::vector<Matrix*> &in_data,
-            const std::vector<Matrix*> &out_data,
-            std::vector<Matrix*> &out_grad,
-            std::vector<Matrix*> &in_grad) = 0;
+            const std::vector<Tensor<>*> &in_data,
+            const std::vector<Tensor<>*> &out_data,
+            std::vector<Tensor<>*> &out_grad,
+            std::vector<Tensor<>*> &in_grad) = 0;
+
+    // outputs may alias the inputs: each output element depends only on
+    // the input element at the same index, in both directions, and
+    // back_propagation doesn't read in_data
+    virtual bool can_run_in_place() const { return false; }
+    // back_propagation reads out_data
+    virtual bool needs_out_data() const { return false; }
+
+    // Inference-time fusion: epilogue() is an element-wise layer as an
+    // in-place function on its output, empty for other layers, and
+    // set_epilogue() makes a layer run one on everything it outputs, or
+    // returns false if it can't. An empty epilogue turns fusion off.
+    virtual Epilogue epilogue() { return Epilogue(); }
+    virtual bool set_epilogue(const Epilogue &epilogue)
+    {
+        MNN_UNREFERENCED_PARAMETER(epilogue);
+        return false;
+    }
 
     virtual void post_update() {}
     virtual void set_context(NetPhase) {}
 
+    // switches inference to int8 kernels, see Network::quantize(), or
+    // returns false if the layer has none
+    virtual bool set_quantization(Quantization mode)
+    {
+        MNN_UNREFERENCED_PARAMETER(mode);
+        return false;
+    }
+
+    // Frees the float weights of a layer running int8 inference, see
+    // Network::release_float_weights(), or returns false if it can't.
+    virtual bool release_float_weights() { return false; }
+    bool float_released() const;
+
+    // stores the weights for inference in precision, see
+    // Network::set_precision(), or returns false if the layer can't
+    virtual bool set_precision(Precision precision)
+    {
+        MNN_UNREFERENCED_PARAMETER(precision);
+        return false;
+    }
+
     std::vector<Matrix> backward(const std::vector<Matrix> &out_grads);
 
     void forward();
@@ -133,6 +189,17 @@ public:
     void clear_grads();
 
     void update_weight(Optimizer *o);
+    void register_weights(Optimizer *o);
+
+    // A layer of the same kind and shape with edges of its own, but whose
+    // weights are views of the weights of this one, for data-parallel
+    // replicas. It isn't connected to any other layer. Null for layers
+    // that can't be cloned, which are trained unsharded.
+    virtual std::shared_ptr<Layer> clone() const;
+
+    // the constructor arguments, for the model format (model_format.h)
+    virtual std::vector<size_t> shape_params() const;
+
     bool has_same_weights(const Layer &rhs, Float eps) const;
 
 protected:
@@ -148,13 +215,28 @@ protected:
     BackendType backend_type_;
     Vector weights_diff_;
 
+    // frees the weight input i and the gradients of all weights, which
+    // int8 inference doesn't use
+    void release_weight(size_t i);
+
     template<typename T, typename Func>
     inline void for_i(T size, Func f, size_t grainsize = 100)
     {
         mnn::for_i(parallelize_, size, f, grainsize);
     }
 
+    // clone() of layers of type T, which copy-constructs them
+    template<typename T>
+    static std::shared_ptr<Layer> replicate(const T &layer)
+    {
+        std::shared_ptr<Layer> copy = std::make_shared<T>(layer);
+        copy->share_weights(layer);
+        return copy;
+    }
+
 private:
+    void share_weights(const Layer &src);
+
     void alloc_input(size_t i) const;
     void alloc_output(size_t i) const;
 
@@ -163,19 +245,19 @@ private:
     edgeptr_t ith_out_node(size_t i) const;
 
     Vector* get_weight_data(size_t i);
-    const Vector* get_weight_data(size_t i) const;
 
 private:
     bool trainable_;
+    bool float_released_ = false;
     std::shared_ptr<weight_init::Function> weight_init_;
     std::shared_ptr<weight_init::Function> bias_init_;
 
-    std::vector<Matrix*> fwd_in_data_;
-    std::vector<Matrix*> fwd_out_data_;
-    std::vector<Matrix*> bwd_in_data_;
-    std::vector<Matrix*> bwd_in_grad_;
-    std::vector<Matrix*> bwd_out_data_;
-    std::vector<Matrix*> bwd_out_grad_;
+    std::vector<Tensor<>*> fwd_in_data_;
+    std::vector<Tensor<>*> fwd_out_data_;
+    std::vector<Tensor<>*> bwd_in_data_;
+    std::vector<Tensor<>*> bwd_in_grad_;
+    std::vector<Tensor<>*> bwd_out_data_;
+    std::vector<Tensor<>*> bwd_out_grad_;
 };
 
 Layer& operator<<(Layer &lhs, Layer &rhs);
@@ -0,0 +1,73 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include "mnn/core/layer/layer.h"
+#include "mnn/core/graph/op_kernel.h"
+#include "mnn/core/params/maxpool_params.h"
+
+namespace mnn {
+
+class MaxPoolingLayer: public Layer {
+public:
+    MaxPoolingLayer(size_t in_width, size_t in_height, size_t in_channels,
+            size_t pool_size, BackendType backend_type = default_engine());
+
+    MaxPoolingLayer(const Shape3d &in_shape, size_t pool_size, size_t stride,
+            BackendType backend_type = default_engine());
+
+    MaxPoolingLayer(size_t in_width, size_t in_height, size_t in_channels,
+            size_t pool_size, size_t stride,
+            BackendType backend_type = default_engine());
+
+    MaxPoolingLayer(size_t in_width, size_t in_height, size_t in_channels,
+            size_t pool_size_x, size_t pool_size_y, size_t stride_x,
+            size_t stride_y, bool ceil_mode = false, Padding pad_type =
+                    Padding::VALID, BackendType backend_type = default_engine());
+
+    MaxPoolingLayer(const MaxPoolingLayer &other);
+    MaxPoolingLayer(MaxPoolingLayer &&other);
+
+    std::shared_ptr<Layer> clone() const override;
+    std::vector<size_t> shape_params() const override;
+
+    std::vector<Index3d<size_t>> in_shape() const override;
+    std::vector<Index3d<size_t>> out_shape() const override;
+    std::string layer_type() const override;
+
+    void set_sample_count(size_t sample_count) override;
+
+    void forward_propagation(
+            const std::vector<Tensor<>*> &in_data,
+            std::vector<Tensor<>*> &out_data) override;
+
+    void back_propagation(
+            const std::vector<Tensor<>*> &in_data,
+            const std::vector<Tensor<>*> &out_data,
+            std::vector<Tensor<>*> &out_grad,
+            std::vector<Tensor<>*> &in_grad) override;
+
+    std::pair<size_t, size_t> pool_size() const;
+
+private:
+    void set_maxpool_params(const Shape3d &in, const Shape3d &out,
+            size_t pool_size_x, size_t pool_size_y, size_t stride_x,
+            size_t stride_y, bool ceil_mode, Padding pad_type);
+    void init_connection();
+    void init_backend(BackendType backend_type);
+
+    MaxpoolParams params_;
+    OpKernelContext fwd_ctx_;
+    OpKernelContext bwd_ctx_;
+
+    std::shared_ptr<OpKernel> kernel_fwd_;
+    std::shared_ptr<OpKernel> kernel_back_;
+};
+
+}  // namespace mnn
@@ -8,10 +8,17 @@
 
 #pragma once
 
+#include <type_traits>
+
 #include "mnn/infra/util.h"
 
 namespace mnn {
 
+// true for losses whose gradient is taken with respect to the input of the
+// network's closing SoftmaxLayer, see SoftmaxCrossEntropy
+template<typename E>
+struct IncludesSoftmax : std::false_type {};
+
 template<typename E>
 Vector gradient(const Vector &y, const Vector &t)
 {
@@ -0,0 +1,28 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include "mnn/core/loss/apply_grad.h"
+#include "mnn/infra/util.h"
+
+namespace mnn {
+
+// Categorical cross-entropy of a network closed by a SoftmaxLayer. df is
+// the gradient with respect to the softmax input, y - t, so training skips
+// the softmax backward pass and the division of CrossEntropy::df.
+class SoftmaxCrossEntropy {
+ public:
+  static Float f(const Vector &y, const Vector &t);
+  static Vector df(const Vector &y, const Vector &t);
+};
+
+template <>
+struct IncludesSoftmax<SoftmaxCrossEntropy> : std::true_type {};
+
+}  // namespace mnn
@@ -14,7 +14,15 @@ namespace mnn {
 
 struct Adam: public StatefulOptimizer<2> {
     Adam();
-    void update(const Vector &dW, Vector &W, bool parallelize);
+    void update(const Vector &dW, Vector &W, bool parallelize) override;
+    void update(const Vector &dW, Float scale, Vector &W,
+            bool parallelize) override;
+
+    bool supports_ranges() const override { return true; }
+    void update_range(size_t slot, const Float *dW, Float scale, Vector &W,
+            size_t begin, size_t end) override;
+    void end_step() override;
+    std::vector<Float*> state_scalars() override { return {&b1_t, &b2_t}; }
 
     Float alpha;  // learning rate
     Float b1;     // decay term
@@ -15,7 +15,13 @@ namespace mnn {
 struct GradientDescent: public Optimizer {
     GradientDescent();
 
-    void update(const Vector &dW, Vector &W, bool parallelize);
+    void update(const Vector &dW, Vector &W, bool parallelize) override;
+    void update(const Vector &dW, Float scale, Vector &W,
+            bool parallelize) override;
+
+    bool supports_ranges() const override { return true; }
+    void update_range(size_t slot, const Float *dW, Float scale, Vector &W,
+            size_t begin, size_t end) override;
 
 private:
     Float alpha;   // learning rate
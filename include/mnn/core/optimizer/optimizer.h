@@ -8,13 +8,57 @@
 
 #pragma once
 
-#include <unordered_map>
+#include <vector>
 #include "mnn/infra/util.h"
 
 namespace mnn {
 
 struct Optimizer {
     virtual void update(const Vector &dW, Vector &W, bool parallelize) = 0;
+
+    // updates W from the gradient dW * scale; layers pass the raw sum over
+    // the batch and scale = 1 / batch size
+    virtual void update(const Vector &dW, Float scale, Vector &W,
+            bool parallelize)
+    {
+        if (scale == Float(1)) {
+            update(dW, W, parallelize);
+            return;
+        }
+        Vector g(dW.size());
+        for (size_t i = 0; i < dW.size(); i++) {
+            g[i] = dW[i] * scale;
+        }
+        update(g, W, parallelize);
+    }
+
+    // announces W ahead of training, in the order it'll be updated
+    virtual void register_param(const Vector &) {}
+
+    // Multi-tensor steps, for optimizers whose update splits into
+    // independent ranges: a step binds every W once, serially, then runs
+    // update_range() on disjoint ranges, possibly concurrently, and
+    // closes with end_step(). dW holds the gradient of W[begin, end).
+    virtual bool supports_ranges() const { return false; }
+    virtual size_t bind(const Vector &) { return 0; }
+    virtual void update_range(size_t slot, const Float *dW, Float scale,
+            Vector &W, size_t begin, size_t end)
+    {
+        MNN_UNREFERENCED_PARAMETER(slot);
+        MNN_UNREFERENCED_PARAMETER(dW);
+        MNN_UNREFERENCED_PARAMETER(scale);
+        MNN_UNREFERENCED_PARAMETER(W);
+        MNN_UNREFERENCED_PARAMETER(begin);
+        MNN_UNREFERENCED_PARAMETER(end);
+        throw MnnError("The optimizer can't update ranges");
+    }
+    virtual void end_step() {}
+
+    // the state checkpoints save: arrays holding the state of W[i] at
+    // bind(W) + i, and scalars such as the powers of the decay terms
+    virtual std::vector<Vector*> state_arrays() { return {}; }
+    virtual std::vector<Float*> state_scalars() { return {}; }
+
     virtual void reset() {}
     virtual ~Optimizer() {}
 };
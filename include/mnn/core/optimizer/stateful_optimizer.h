@@ -13,24 +13,78 @@
 
 namespace mnn {
 
+// N state vectors per parameter, e.g. the moments of Adam. The states of
+// all parameters live in N flat arrays, each parameter at a fixed offset;
+// parameters updated in the order they were registered are found with a
+// single comparison.
 template<int N>
 struct StatefulOptimizer: public Optimizer {
+    void register_param(const Vector &W) override
+    {
+        slot_of(W);
+    }
+
+    // the slot is the offset of the states of W
+    size_t bind(const Vector &W) override
+    {
+        return slot_of(W);
+    }
+
+    std::vector<Vector*> state_arrays() override
+    {
+        std::vector<Vector*> arrays;
+        for (auto &e : E_)
+            arrays.push_back(&e);
+        return arrays;
+    }
+
     void reset() override
     {
+        params_.clear();
         for (auto &e : E_)
             e.clear();
+        cursor_ = 0;
     }
 
 protected:
+    // offset of the states of W in every E_[i], zero-initialized on first
+    // use
+    size_t slot_of(const Vector &W)
+    {
+        size_t i = cursor_;
+        if (i >= params_.size() || params_[i].key != &W) {
+            i = 0;
+            while (i < params_.size() && params_[i].key != &W)
+                i++;
+            if (i == params_.size()) {
+                size_t offset = params_.empty() ? 0 :
+                        params_.back().offset + params_.back().size;
+                params_.push_back({&W, offset, W.size()});
+                for (auto &e : E_)
+                    e.resize(offset + W.size(), Float());
+            }
+        }
+        if (params_[i].size != W.size())
+            throw MnnError("Optimizer state doesn't match the weight size");
+        cursor_ = (i + 1) % params_.size();
+        return params_[i].offset;
+    }
+
     template<int Index>
-    Vector& get(const Vector &key)
+    Float* get(const Vector &key)
     {
-        if (E_[Index][&key].empty())
-            E_[Index][&key].resize(key.size(), Float());
-        return E_[Index][&key];
+        return &E_[Index][slot_of(key)];
     }
 
-    std::unordered_map<const Vector*, Vector> E_[N];
+    struct Param {
+        const Vector *key;
+        size_t offset;
+        size_t size;
+    };
+
+    std::vector<Param> params_;
+    Vector E_[N];
+    size_t cursor_ = 0;
 };
 
 } // namespace mnn
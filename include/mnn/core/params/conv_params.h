@@ -12,6 +12,7 @@
 #include <deque>
 #include <vector>
 
+#include "mnn/core/graph/tensor.h"
 #include "mnn/core/params/params.h"
 #include "mnn/infra/util.h"
 
@@ -56,8 +57,8 @@ class Conv2dPadding {
   Conv2dPadding();
   explicit Conv2dPadding(const ConvParams &params);
 
-  void copy_and_pad_input(const Matrix &in, Matrix &out);
-  void copy_and_unpad_delta(const Matrix &delta, Matrix &delta_unpadded);
+  void copy_and_pad_input(const Tensor<> &in, Tensor<> &out);
+  void copy_and_unpad_delta(const Tensor<> &delta, Tensor<> &delta_unpadded);
 
  private:
   ConvParams params_;
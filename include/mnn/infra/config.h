@@ -29,4 +29,8 @@ typedef double Float;
 typedef float Float;
 #endif
 
+// how weights are stored: as Float, or rounded to IEEE binary16 or
+// bfloat16 and widened back to Float for the arithmetic
+enum class Precision { FLOAT, FP16, BF16 };
+
 }  // namespace mnn
@@ -0,0 +1,51 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+namespace mnn {
+
+// instruction set tiers the vectorize:: kernels are built for,
+// ordered from the least to the most capable one.
+enum class Isa {
+    SCALAR, SSE2, AVX, AVX2, AVX512, AVX512VNNI
+};
+
+struct CpuFeatures {
+    bool sse2       = false;
+    bool sse3       = false;
+    bool ssse3      = false;
+    bool sse41      = false;
+    bool sse42      = false;
+    bool avx        = false;
+    bool f16c       = false;
+    bool fma        = false;
+    bool avx2       = false;
+    bool avx512f    = false;
+    bool avx512bw   = false;
+    bool avx512dq   = false;
+    bool avx512vl   = false;
+    bool avx512vnni = false;
+    bool avxvnni    = false;
+
+    // the most capable tier this cpu (and the os) can execute.
+    Isa best_isa() const;
+};
+
+// features of the host cpu, probed once with cpuid.
+const CpuFeatures& cpu_features();
+
+// tier the vectorize:: kernels run with. It is the best tier supported by
+// both the host cpu and this build, unless it is lowered by the MNN_ISA
+// environment variable (scalar, sse2, avx, avx2, avx512
+// or avx512vnni).
+Isa active_isa();
+
+const char* to_string(Isa isa);
+
+}  // namespace mnn
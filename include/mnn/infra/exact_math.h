@@ -0,0 +1,20 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+namespace mnn {
+
+// With exact math the tanh, sigmoid and softmax layers evaluate exp/tanh
+// with libm instead of the vectorize:: approximations, so results don't
+// depend on the instruction set tier, e.g. for bit-reproducible training
+// runs. Off unless the library is built with USE_EXACT_MATH.
+bool exact_math();
+void set_exact_math(bool enable);
+
+}  // namespace mnn
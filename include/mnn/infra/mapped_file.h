@@ -0,0 +1,39 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mnn/infra/aligned_allocator.h"
+
+namespace mnn {
+
+// A whole file mapped read-only, so its pages are shared with every other
+// process mapping it and loaded only when touched. Where mmap isn't
+// available the file is read into a 64-byte aligned buffer instead. The
+// data is aligned to a page, or 64 bytes, either way.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char *data_;
+  size_t size_;
+  std::vector<char, AlignedAllocator<char, 64>> buffer_;
+};
+
+}  // namespace mnn
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <limits>
@@ -28,13 +29,20 @@
 #include <tbb/tbb.h>
 #endif
 
-#if !defined(MNN_USE_OMP) && !defined(MNN_SINGLE_THREAD)
-#include <future>  // NOLINT
-#include <thread>  // NOLINT
+#if defined(MNN_USE_WORK_STEALING) && !defined(MNN_SINGLE_THREAD)
+#include "mnn/infra/work_stealing.h"
+#elif !defined(MNN_USE_TBB) && !defined(MNN_USE_OMP) && \
+  !defined(MNN_USE_GCD) && !defined(MNN_SINGLE_THREAD)
+#include "mnn/infra/thread_pool.h"
 #endif
 
 #if defined(MNN_USE_GCD) && !defined(MNN_SINGLE_THREAD)
 #include <dispatch/dispatch.h>
+#include <thread>
+#endif
+
+#ifdef MNN_USE_OMP
+#include <omp.h>
 #endif
 
 namespace mnn {
@@ -130,43 +138,69 @@ void parallel_for(size_t begin,
   xparallel_for(begin, end, f);
 }
 
+#elif defined(MNN_USE_WORK_STEALING)
+
+// Blocks are split down to grainsize elements, or to single ones when the
+// range is no larger than that, as with TBB. Nested calls add stealable
+// work to the same workers.
+template <typename Func>
+void parallel_for(size_t begin, size_t end, const Func &f, size_t grainsize) {
+  assert(end >= begin);
+  size_t grain = end - begin > grainsize ? grainsize : 1;
+  WorkStealingScheduler::instance().parallel_for(
+    begin, end, grain,
+    [&](size_t blockBegin, size_t blockEnd) {
+      f(BlockedRange(blockBegin, blockEnd));
+    });
+}
+
 #else
 
+// Like TBB, grainsize is the smallest block worth a task of its own, and a
+// range no larger than that is split into single elements. Blocks are made
+// coarser when there would be many more of them than pool threads.
 template <typename Func>
-void parallel_for(size_t begin,
-                  size_t end,
-                  const Func &f,
-                  size_t /*grainsize*/) {
+void parallel_for(size_t begin, size_t end, const Func &f, size_t grainsize) {
   assert(end >= begin);
-  size_t nthreads  = std::thread::hardware_concurrency();
-  size_t blockSize = (end - begin) / nthreads;
-  if (blockSize * nthreads < end - begin) blockSize++;
-
-  std::vector<std::future<void> > futures;
-
-  size_t blockBegin            = begin;
-  size_t blockEnd              = blockBegin + blockSize;
-  if (blockEnd > end) blockEnd = end;
-
-  for (size_t i = 0; i < nthreads; i++) {
-    futures.push_back(
-      std::move(std::async(std::launch::async, [blockBegin, blockEnd, &f] {
-        f(BlockedRange(blockBegin, blockEnd));
-      })));
-
-    blockBegin += blockSize;
-    blockEnd = blockBegin + blockSize;
-    if (blockBegin >= end) break;
-    if (blockEnd > end) blockEnd = end;
+  size_t count = end - begin;
+  if (count == 0) return;
+
+  ThreadPool &pool = ThreadPool::instance();
+  size_t blockSize = count > grainsize && grainsize > 0 ? grainsize : 1;
+  size_t maxBlocks = pool.num_threads() * 4;
+  if ((count + blockSize - 1) / blockSize > maxBlocks) {
+    blockSize = (count + maxBlocks - 1) / maxBlocks;
   }
+  size_t blockCount = (count + blockSize - 1) / blockSize;
 
-  for (auto &future : futures) future.wait();
+  pool.run(blockCount, [&](size_t block) {
+    size_t blockBegin = begin + block * blockSize;
+    size_t blockEnd   = std::min(end, blockBegin + blockSize);
+    f(BlockedRange(blockBegin, blockEnd));
+  });
 }
 
 #endif
 
 #endif  // MNN_USE_TBB
 
+// threads parallel_for spreads its blocks over, the caller included
+inline size_t parallel_workers() {
+#if defined(MNN_USE_TBB)
+  return static_cast<size_t>(tbb::task_scheduler_init::default_num_threads());
+#elif defined(MNN_USE_OMP)
+  return static_cast<size_t>(omp_get_max_threads());
+#elif defined(MNN_USE_GCD)
+  return std::max(1u, std::thread::hardware_concurrency());
+#elif defined(MNN_SINGLE_THREAD)
+  return 1;
+#elif defined(MNN_USE_WORK_STEALING)
+  return WorkStealingScheduler::instance().num_threads();
+#else
+  return ThreadPool::instance().num_threads();
+#endif
+}
+
 template <typename T, typename U>
 bool value_representation(U const &value) {
   return static_cast<U>(static_cast<T>(value)) == value;
@@ -8,12 +8,24 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 #include <numeric>
+#include <type_traits>
 
+#include "mnn/infra/config.h"
+#include "mnn/infra/cpu_features.h"
 #include "mnn/infra/macro.h"
 
+#if defined(MNN_USE_SSE) || defined(MNN_USE_AVX) || defined(MNN_USE_AVX2) || \
+  defined(MNN_USE_AVX512)
+#include <immintrin.h>
+#endif
+
 namespace vectorize {
 namespace detail {
 
@@ -39,6 +51,40 @@ struct GenericScalar {
     return v1 * v2 + v3;
   }
 
+  static MNN_MUST_INLINE register_type sub(const register_type &v1,
+                                           const register_type &v2) {
+    return v1 - v2;
+  }
+  static MNN_MUST_INLINE register_type div(const register_type &v1,
+                                           const register_type &v2) {
+    return v1 / v2;
+  }
+  // v2 where either is NaN, like minps/maxps
+  static MNN_MUST_INLINE register_type min(const register_type &v1,
+                                           const register_type &v2) {
+    return v1 < v2 ? v1 : v2;
+  }
+  static MNN_MUST_INLINE register_type max(const register_type &v1,
+                                           const register_type &v2) {
+    return v1 > v2 ? v1 : v2;
+  }
+  static MNN_MUST_INLINE register_type sqrt(const register_type &v) {
+    return std::sqrt(v);
+  }
+
+  // 2^n for integral n within the normal exponent range
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    return std::ldexp(T(1), static_cast<int>(n));
+  }
+
+  // x where v1 > v2, y elsewhere
+  static MNN_MUST_INLINE register_type select_greater(const register_type &v1,
+                                                      const register_type &v2,
+                                                      const register_type &x,
+                                                      const register_type &y) {
+    return v1 > v2 ? x : y;
+  }
+
   template <typename aligned>
   static MNN_MUST_INLINE register_type load(const value_type *px) {
     return *px;
@@ -55,337 +101,1943 @@ struct GenericScalar {
   static MNN_MUST_INLINE bool is_aligned(value_type *p) { return true; }
 };
 
-// generic dot-product
-template <typename T, typename f1_aligned, typename f2_aligned>
-MNN_MUST_INLINE typename T::value_type dot_product(
-  const typename T::value_type *f1,
-  const typename T::value_type *f2,
-  std::size_t size) {
-  typename T::register_type r0 = T::zero();
-  typename T::register_type r1 = T::zero();
-  typename T::register_type r2 = T::zero();
-  typename T::register_type r3 = T::zero();
-  auto sz                      = T::unroll_size;
-  auto sz4                     = T::unroll_size * 4;
-  auto n4                      = size / sz4;
-  auto n1                      = (size % sz4) / sz;
-  auto remain                  = size % sz;
-  for (size_t i = 0; i < n4; ++i) {
-    auto s10 = T::template load<f1_aligned>(&f1[i * sz4 + sz * 0]);
-    auto s11 = T::template load<f1_aligned>(&f1[i * sz4 + sz * 1]);
-    auto s12 = T::template load<f1_aligned>(&f1[i * sz4 + sz * 2]);
-    auto s13 = T::template load<f1_aligned>(&f1[i * sz4 + sz * 3]);
-    auto s20 = T::template load<f2_aligned>(&f2[i * sz4 + sz * 0]);
-    auto s21 = T::template load<f2_aligned>(&f2[i * sz4 + sz * 1]);
-    auto s22 = T::template load<f2_aligned>(&f2[i * sz4 + sz * 2]);
-    auto s23 = T::template load<f2_aligned>(&f2[i * sz4 + sz * 3]);
-    r0       = T::madd(s10, s20, r0);
-    r1       = T::madd(s11, s21, r1);
-    r2       = T::madd(s12, s22, r2);
-    r3       = T::madd(s13, s23, r3);
+#ifdef MNN_USE_SSE
+struct SseFloat {
+  typedef __m128 register_type;
+  typedef float value_type;
+  enum { unroll_size = 4 };
+  static MNN_MUST_INLINE register_type set1(const value_type &x) {
+    return _mm_set1_ps(x);
   }
-  size_t idx = n4 * sz4;
-  for (size_t i = 0; i < n1; ++i) {
-    auto s1 = T::template load<f1_aligned>(&f1[idx + i * sz]);
-    auto s2 = T::template load<f2_aligned>(&f2[idx + i * sz]);
-    r0      = T::madd(s1, s2, r0);
+  static MNN_MUST_INLINE register_type zero() { return _mm_setzero_ps(); }
+  static MNN_MUST_INLINE register_type mul(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_mul_ps(v1, v2);
   }
-  r0                         = T::add(r0, r1);
-  r2                         = T::add(r2, r3);
-  r0                         = T::add(r0, r2);
-  typename T::value_type sum = T::resemble(r0);
-  idx += n1 * sz;
-  for (size_t i = 0; i < remain; ++i) {
-    sum += f1[idx + i] * f2[idx + i];
+  static MNN_MUST_INLINE register_type add(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_add_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type madd(const register_type &v1,
+                                            const register_type &v2,
+                                            const register_type &v3) {
+    return _mm_add_ps(_mm_mul_ps(v1, v2), v3);
   }
-  return sum;
-}
 
-template <typename T, typename dst_aligned>
-MNN_MUST_INLINE void add(typename T::value_type c,
-                         std::size_t size,
-                         typename T::value_type *dst) {
-  typename T::register_type c2 = T::set1(c);
-  auto sz                      = T::unroll_size;
-  auto sz4                     = T::unroll_size * 4;
-  auto n4                      = size / sz4;
-  auto n1                      = (size % sz4) / sz;
-  auto remain                  = size % sz;
-  for (size_t i = 0; i < n4; ++i) {
-    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
-    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
-    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
-    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
-    d0      = T::add(c2, d0);
-    d1      = T::add(c2, d1);
-    d2      = T::add(c2, d2);
-    d3      = T::add(c2, d3);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
+  static MNN_MUST_INLINE register_type sub(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_sub_ps(v1, v2);
   }
-  size_t idx = n4 * sz4;
-  for (size_t i = 0; i < n1; ++i) {
-    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
-    d      = T::add(c2, d);
-    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+  static MNN_MUST_INLINE register_type div(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_div_ps(v1, v2);
   }
-  idx += n1 * sz;
-  for (size_t i = 0; i < remain; ++i) {
-    dst[idx + i] += c;
+  static MNN_MUST_INLINE register_type min(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_min_ps(v1, v2);
   }
-}
-
-template <typename T, typename src_aligned, typename dst_aligned>
-MNN_MUST_INLINE void add(const typename T::value_type *src,
-                         std::size_t size,
-                         typename T::value_type *dst) {
-  auto sz     = T::unroll_size;
-  auto sz4    = T::unroll_size * 4;
-  auto n4     = size / sz4;
-  auto n1     = (size % sz4) / sz;
-  auto remain = size % sz;
-  for (size_t i = 0; i < n4; ++i) {
-    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
-    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
-    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
-    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
-    auto s0 = T::template load<src_aligned>(&src[i * sz4 + sz * 0]);
-    auto s1 = T::template load<src_aligned>(&src[i * sz4 + sz * 1]);
-    auto s2 = T::template load<src_aligned>(&src[i * sz4 + sz * 2]);
-    auto s3 = T::template load<src_aligned>(&src[i * sz4 + sz * 3]);
-    d0      = T::add(s0, d0);
-    d1      = T::add(s1, d1);
-    d2      = T::add(s2, d2);
-    d3      = T::add(s3, d3);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
+  static MNN_MUST_INLINE register_type max(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_max_ps(v1, v2);
   }
-  size_t idx = n4 * sz4;
-  for (size_t i = 0; i < n1; ++i) {
-    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
-    auto s = T::template load<src_aligned>(&src[idx + i * sz]);
-    d      = T::add(s, d);
-    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+  static MNN_MUST_INLINE register_type sqrt(const register_type &v) {
+    return _mm_sqrt_ps(v);
   }
-  idx += n1 * sz;
-  for (size_t i = 0; i < remain; ++i) {
-    dst[idx + i] += src[idx + i];
+
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    // n + 127 lands in the low mantissa bits of n + 2^23 + 127
+    return _mm_castsi128_ps(_mm_slli_epi32(
+        _mm_castps_si128(_mm_add_ps(n, set1(8388608.0f + 127.0f))), 23));
   }
-}
 
-template <typename T, typename src_aligned, typename dst_aligned>
-MNN_MUST_INLINE void muladd(const typename T::value_type *src,
-                            typename T::value_type c,
-                            std::size_t size,
-                            typename T::value_type *dst) {
-  auto factor = T::set1(c);
-  auto sz     = T::unroll_size;
-  auto sz4    = T::unroll_size * 4;
-  auto n4     = size / sz4;
-  auto n1     = (size % sz4) / sz;
-  auto remain = size % sz;
-  for (size_t i = 0; i < n4; ++i) {
-    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
-    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
-    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
-    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
-    auto s0 = T::template load<src_aligned>(&src[i * sz4 + sz * 0]);
-    auto s1 = T::template load<src_aligned>(&src[i * sz4 + sz * 1]);
-    auto s2 = T::template load<src_aligned>(&src[i * sz4 + sz * 2]);
-    auto s3 = T::template load<src_aligned>(&src[i * sz4 + sz * 3]);
-    d0      = T::madd(s0, factor, d0);
-    d1      = T::madd(s1, factor, d1);
-    d2      = T::madd(s2, factor, d2);
-    d3      = T::madd(s3, factor, d3);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
+  static MNN_MUST_INLINE register_type select_greater(const register_type &v1,
+                                                      const register_type &v2,
+                                                      const register_type &x,
+                                                      const register_type &y) {
+    register_type mask = _mm_cmpgt_ps(v1, v2);
+    return _mm_or_ps(_mm_and_ps(mask, x), _mm_andnot_ps(mask, y));
   }
-  size_t idx = n4 * sz4;
-  for (size_t i = 0; i < n1; ++i) {
-    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
-    auto s = T::template load<src_aligned>(&src[idx + i * sz]);
-    d      = T::madd(s, factor, d);
-    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+
+  template <typename aligned>
+  static MNN_MUST_INLINE register_type load(const value_type *px) {
+    return aligned::value ? _mm_load_ps(px) : _mm_loadu_ps(px);
   }
-  idx += n1 * sz;
-  for (size_t i = 0; i < remain; ++i) {
-    dst[idx + i] += src[idx + i] * c;
+  template <typename aligned>
+  static MNN_MUST_INLINE void store(value_type *px, const register_type &v) {
+    aligned::value ? _mm_store_ps(px, v) : _mm_storeu_ps(px, v);
   }
-}
 
-template <typename T, typename src_aligned, typename dst_aligned>
-MNN_MUST_INLINE void reduce(const typename T::value_type *src,
-                            std::size_t size,
-                            typename T::value_type *dst) {
-  auto sz     = T::unroll_size;
-  auto sz4    = T::unroll_size * 4;
-  auto n4     = size / sz4;
-  auto n1     = (size % sz4) / sz;
-  auto remain = size % sz;
-  for (size_t i = 0; i < n4; ++i) {
-    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
-    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
-    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
-    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
-    auto s0 = T::template load<src_aligned>(&src[i * sz4 + sz * 0]);
-    auto s1 = T::template load<src_aligned>(&src[i * sz4 + sz * 1]);
-    auto s2 = T::template load<src_aligned>(&src[i * sz4 + sz * 2]);
-    auto s3 = T::template load<src_aligned>(&src[i * sz4 + sz * 3]);
-    d0      = T::add(s0, d0);
-    d1      = T::add(s1, d1);
-    d2      = T::add(s2, d2);
-    d3      = T::add(s3, d3);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
-    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
-  }
-  size_t idx = n4 * sz4;
-  for (size_t i = 0; i < n1; ++i) {
-    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
-    auto s = T::template load<src_aligned>(&src[idx + i * sz]);
-    d      = T::add(s, d);
-    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+  static MNN_MUST_INLINE value_type resemble(const register_type &x) {
+    register_type sum = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
   }
-  idx += n1 * sz;
-  for (size_t i = 0; i < remain; ++i) {
-    dst[idx + i] += src[idx + i];
+
+  static MNN_MUST_INLINE bool is_aligned(value_type *p) {
+    return reinterpret_cast<std::size_t>(p) % 16 == 0;
   }
-}
+};
 
-template <typename T>
-void fill(T *dst, size_t size, T value) {
-  std::fill(dst, dst + size, value);
-}
+struct SseDouble {
+  typedef __m128d register_type;
+  typedef double value_type;
+  enum { unroll_size = 2 };
+  static MNN_MUST_INLINE register_type set1(const value_type &x) {
+    return _mm_set1_pd(x);
+  }
+  static MNN_MUST_INLINE register_type zero() { return _mm_setzero_pd(); }
+  static MNN_MUST_INLINE register_type mul(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_mul_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type add(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_add_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type madd(const register_type &v1,
+                                            const register_type &v2,
+                                            const register_type &v3) {
+    return _mm_add_pd(_mm_mul_pd(v1, v2), v3);
+  }
 
+  static MNN_MUST_INLINE register_type sub(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_sub_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type div(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_div_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type min(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_min_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type max(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm_max_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type sqrt(const register_type &v) {
+    return _mm_sqrt_pd(v);
+  }
 
-#ifdef MNN_USE_DOUBLE
-#define MNN_VECTORIZE_TYPE detail::GenericScalar<double>
-#else
-#define MNN_VECTORIZE_TYPE detail::GenericScalar<float>
-#endif
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    return _mm_castsi128_pd(_mm_slli_epi64(
+        _mm_castpd_si128(_mm_add_pd(n, set1(4503599627370496.0 + 1023.0))), 52));
+  }
 
-}  // namespace detail
+  static MNN_MUST_INLINE register_type select_greater(const register_type &v1,
+                                                      const register_type &v2,
+                                                      const register_type &x,
+                                                      const register_type &y) {
+    register_type mask = _mm_cmpgt_pd(v1, v2);
+    return _mm_or_pd(_mm_and_pd(mask, x), _mm_andnot_pd(mask, y));
+  }
+
+  template <typename aligned>
+  static MNN_MUST_INLINE register_type load(const value_type *px) {
+    return aligned::value ? _mm_load_pd(px) : _mm_loadu_pd(px);
+  }
+  template <typename aligned>
+  static MNN_MUST_INLINE void store(value_type *px, const register_type &v) {
+    aligned::value ? _mm_store_pd(px, v) : _mm_storeu_pd(px, v);
+  }
+
+  static MNN_MUST_INLINE value_type resemble(const register_type &x) {
+    return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x)));
+  }
+
+  static MNN_MUST_INLINE bool is_aligned(value_type *p) {
+    return reinterpret_cast<std::size_t>(p) % 16 == 0;
+  }
+};
+#endif  // MNN_USE_SSE
+
+#if defined(MNN_USE_AVX) || defined(MNN_USE_AVX2)
+struct AvxFloat {
+  typedef __m256 register_type;
+  typedef float value_type;
+  enum { unroll_size = 8 };
+  static MNN_MUST_INLINE register_type set1(const value_type &x) {
+    return _mm256_set1_ps(x);
+  }
+  static MNN_MUST_INLINE register_type zero() { return _mm256_setzero_ps(); }
+  static MNN_MUST_INLINE register_type mul(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_mul_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type add(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_add_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type madd(const register_type &v1,
+                                            const register_type &v2,
+                                            const register_type &v3) {
+    return _mm256_add_ps(_mm256_mul_ps(v1, v2), v3);
+  }
+
+  static MNN_MUST_INLINE register_type sub(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_sub_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type div(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_div_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type min(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_min_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type max(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_max_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type sqrt(const register_type &v) {
+    return _mm256_sqrt_ps(v);
+  }
+
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    // AVX has no 256-bit integer shifts, so shift the halves
+    __m256i i = _mm256_castps_si256(_mm256_add_ps(n, set1(8388608.0f + 127.0f)));
+    __m128i lo = _mm_slli_epi32(_mm256_castsi256_si128(i), 23);
+    __m128i hi = _mm_slli_epi32(_mm256_extractf128_si256(i, 1), 23);
+    return _mm256_castsi256_ps(
+        _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+  }
+
+  static MNN_MUST_INLINE register_type select_greater(const register_type &v1,
+                                                      const register_type &v2,
+                                                      const register_type &x,
+                                                      const register_type &y) {
+    return _mm256_blendv_ps(y, x, _mm256_cmp_ps(v1, v2, _CMP_GT_OQ));
+  }
+
+  template <typename aligned>
+  static MNN_MUST_INLINE register_type load(const value_type *px) {
+    return aligned::value ? _mm256_load_ps(px) : _mm256_loadu_ps(px);
+  }
+  template <typename aligned>
+  static MNN_MUST_INLINE void store(value_type *px, const register_type &v) {
+    aligned::value ? _mm256_store_ps(px, v) : _mm256_storeu_ps(px, v);
+  }
+
+  static MNN_MUST_INLINE value_type resemble(const register_type &x) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(x),
+                            _mm256_extractf128_ps(x, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+  }
+
+  static MNN_MUST_INLINE bool is_aligned(value_type *p) {
+    return reinterpret_cast<std::size_t>(p) % 32 == 0;
+  }
+};
+
+struct AvxDouble {
+  typedef __m256d register_type;
+  typedef double value_type;
+  enum { unroll_size = 4 };
+  static MNN_MUST_INLINE register_type set1(const value_type &x) {
+    return _mm256_set1_pd(x);
+  }
+  static MNN_MUST_INLINE register_type zero() { return _mm256_setzero_pd(); }
+  static MNN_MUST_INLINE register_type mul(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_mul_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type add(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_add_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type madd(const register_type &v1,
+                                            const register_type &v2,
+                                            const register_type &v3) {
+    return _mm256_add_pd(_mm256_mul_pd(v1, v2), v3);
+  }
+
+  static MNN_MUST_INLINE register_type sub(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_sub_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type div(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_div_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type min(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_min_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type max(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm256_max_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type sqrt(const register_type &v) {
+    return _mm256_sqrt_pd(v);
+  }
+
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    __m256i i = _mm256_castpd_si256(
+        _mm256_add_pd(n, set1(4503599627370496.0 + 1023.0)));
+    __m128i lo = _mm_slli_epi64(_mm256_castsi256_si128(i), 52);
+    __m128i hi = _mm_slli_epi64(_mm256_extractf128_si256(i, 1), 52);
+    return _mm256_castsi256_pd(
+        _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+  }
+
+  static MNN_MUST_INLINE register_type select_greater(const register_type &v1,
+                                                      const register_type &v2,
+                                                      const register_type &x,
+                                                      const register_type &y) {
+    return _mm256_blendv_pd(y, x, _mm256_cmp_pd(v1, v2, _CMP_GT_OQ));
+  }
+
+  template <typename aligned>
+  static MNN_MUST_INLINE register_type load(const value_type *px) {
+    return aligned::value ? _mm256_load_pd(px) : _mm256_loadu_pd(px);
+  }
+  template <typename aligned>
+  static MNN_MUST_INLINE void store(value_type *px, const register_type &v) {
+    aligned::value ? _mm256_store_pd(px, v) : _mm256_storeu_pd(px, v);
+  }
+
+  static MNN_MUST_INLINE value_type resemble(const register_type &x) {
+    __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(x),
+                             _mm256_extractf128_pd(x, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+  }
+
+  static MNN_MUST_INLINE bool is_aligned(value_type *p) {
+    return reinterpret_cast<std::size_t>(p) % 32 == 0;
+  }
+};
+#endif  // MNN_USE_AVX || MNN_USE_AVX2
+
+#ifdef MNN_USE_AVX2
+// AVX2-era cores all ship FMA3, so fold the multiply-add into one instruction.
+struct Avx2Float : public AvxFloat {
+  static MNN_MUST_INLINE register_type madd(const register_type &v1,
+                                            const register_type &v2,
+                                            const register_type &v3) {
+    return _mm256_fmadd_ps(v1, v2, v3);
+  }
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_castps_si256(_mm256_add_ps(n, set1(8388608.0f + 127.0f))), 23));
+  }
+};
+
+struct Avx2Double : public AvxDouble {
+  static MNN_MUST_INLINE register_type madd(const register_type &v1,
+                                            const register_type &v2,
+                                            const register_type &v3) {
+    return _mm256_fmadd_pd(v1, v2, v3);
+  }
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(
+        _mm256_add_pd(n, set1(4503599627370496.0 + 1023.0))), 52));
+  }
+};
+#endif  // MNN_USE_AVX2
+
+#ifdef MNN_USE_AVX512
+struct Avx512Float {
+  typedef __m512 register_type;
+  typedef float value_type;
+  enum { unroll_size = 16 };
+  static MNN_MUST_INLINE register_type set1(const value_type &x) {
+    return _mm512_set1_ps(x);
+  }
+  static MNN_MUST_INLINE register_type zero() { return _mm512_setzero_ps(); }
+  static MNN_MUST_INLINE register_type mul(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_mul_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type add(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_add_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type madd(const register_type &v1,
+                                            const register_type &v2,
+                                            const register_type &v3) {
+    return _mm512_fmadd_ps(v1, v2, v3);
+  }
+
+  static MNN_MUST_INLINE register_type sub(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_sub_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type div(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_div_ps(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type min(const register_type &v1,
+                                           const register_type &v2) {
+    // the maskz forms keep gcc 12 from warning on _mm512_undefined_ps
+    return _mm512_maskz_min_ps(0xFFFF, v1, v2);
+  }
+  static MNN_MUST_INLINE register_type max(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_maskz_max_ps(0xFFFF, v1, v2);
+  }
+  static MNN_MUST_INLINE register_type sqrt(const register_type &v) {
+    return _mm512_maskz_sqrt_ps(0xFFFF, v);
+  }
+
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(0xFFFF,
+        _mm512_castps_si512(_mm512_add_ps(n, set1(8388608.0f + 127.0f))), 23));
+  }
+
+  static MNN_MUST_INLINE register_type select_greater(const register_type &v1,
+                                                      const register_type &v2,
+                                                      const register_type &x,
+                                                      const register_type &y) {
+    return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(v1, v2, _CMP_GT_OQ), y, x);
+  }
+
+  template <typename aligned>
+  static MNN_MUST_INLINE register_type load(const value_type *px) {
+    return aligned::value ? _mm512_load_ps(px) : _mm512_loadu_ps(px);
+  }
+  template <typename aligned>
+  static MNN_MUST_INLINE void store(value_type *px, const register_type &v) {
+    aligned::value ? _mm512_store_ps(px, v) : _mm512_storeu_ps(px, v);
+  }
+
+  static MNN_MUST_INLINE value_type resemble(const register_type &x) {
+    alignas(64) value_type lanes[unroll_size];
+    _mm512_store_ps(lanes, x);
+    value_type sum = lanes[0];
+    for (int i = 1; i < unroll_size; i++) sum += lanes[i];
+    return sum;
+  }
+
+  static MNN_MUST_INLINE bool is_aligned(value_type *p) {
+    return reinterpret_cast<std::size_t>(p) % 64 == 0;
+  }
+};
+
+struct Avx512Double {
+  typedef __m512d register_type;
+  typedef double value_type;
+  enum { unroll_size = 8 };
+  static MNN_MUST_INLINE register_type set1(const value_type &x) {
+    return _mm512_set1_pd(x);
+  }
+  static MNN_MUST_INLINE register_type zero() { return _mm512_setzero_pd(); }
+  static MNN_MUST_INLINE register_type mul(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_mul_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type add(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_add_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type madd(const register_type &v1,
+                                            const register_type &v2,
+                                            const register_type &v3) {
+    return _mm512_fmadd_pd(v1, v2, v3);
+  }
+
+  static MNN_MUST_INLINE register_type sub(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_sub_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type div(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_div_pd(v1, v2);
+  }
+  static MNN_MUST_INLINE register_type min(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_maskz_min_pd(0xFF, v1, v2);
+  }
+  static MNN_MUST_INLINE register_type max(const register_type &v1,
+                                           const register_type &v2) {
+    return _mm512_maskz_max_pd(0xFF, v1, v2);
+  }
+  static MNN_MUST_INLINE register_type sqrt(const register_type &v) {
+    return _mm512_maskz_sqrt_pd(0xFF, v);
+  }
+
+  static MNN_MUST_INLINE register_type exp2_int(const register_type &n) {
+    return _mm512_castsi512_pd(_mm512_maskz_slli_epi64(0xFF,
+        _mm512_castpd_si512(_mm512_add_pd(n, set1(4503599627370496.0 + 1023.0))),
+        52));
+  }
+
+  static MNN_MUST_INLINE register_type select_greater(const register_type &v1,
+                                                      const register_type &v2,
+                                                      const register_type &x,
+                                                      const register_type &y) {
+    return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(v1, v2, _CMP_GT_OQ), y, x);
+  }
+
+  template <typename aligned>
+  static MNN_MUST_INLINE register_type load(const value_type *px) {
+    return aligned::value ? _mm512_load_pd(px) : _mm512_loadu_pd(px);
+  }
+  template <typename aligned>
+  static MNN_MUST_INLINE void store(value_type *px, const register_type &v) {
+    aligned::value ? _mm512_store_pd(px, v) : _mm512_storeu_pd(px, v);
+  }
+
+  static MNN_MUST_INLINE value_type resemble(const register_type &x) {
+    alignas(64) value_type lanes[unroll_size];
+    _mm512_store_pd(lanes, x);
+    value_type sum = lanes[0];
+    for (int i = 1; i < unroll_size; i++) sum += lanes[i];
+    return sum;
+  }
+
+  static MNN_MUST_INLINE bool is_aligned(value_type *p) {
+    return reinterpret_cast<std::size_t>(p) % 64 == 0;
+  }
+};
+#endif  // MNN_USE_AVX512
+
+#ifdef MNN_USE_AVX512VNNI
+// the float kernels of AVX-512; only the int8 GEMM differs, see QGemm
+struct Avx512VnniFloat : public Avx512Float {};
+#endif  // MNN_USE_AVX512VNNI
+
+// generic dot-product
+template <typename T, typename f1_aligned, typename f2_aligned>
+MNN_MUST_INLINE typename T::value_type dot_product(
+  const typename T::value_type *f1,
+  const typename T::value_type *f2,
+  std::size_t size) {
+  typename T::register_type r0 = T::zero();
+  typename T::register_type r1 = T::zero();
+  typename T::register_type r2 = T::zero();
+  typename T::register_type r3 = T::zero();
+  auto sz                      = T::unroll_size;
+  auto sz4                     = T::unroll_size * 4;
+  auto n4                      = size / sz4;
+  auto n1                      = (size % sz4) / sz;
+  auto remain                  = size % sz;
+  for (size_t i = 0; i < n4; ++i) {
+    auto s10 = T::template load<f1_aligned>(&f1[i * sz4 + sz * 0]);
+    auto s11 = T::template load<f1_aligned>(&f1[i * sz4 + sz * 1]);
+    auto s12 = T::template load<f1_aligned>(&f1[i * sz4 + sz * 2]);
+    auto s13 = T::template load<f1_aligned>(&f1[i * sz4 + sz * 3]);
+    auto s20 = T::template load<f2_aligned>(&f2[i * sz4 + sz * 0]);
+    auto s21 = T::template load<f2_aligned>(&f2[i * sz4 + sz * 1]);
+    auto s22 = T::template load<f2_aligned>(&f2[i * sz4 + sz * 2]);
+    auto s23 = T::template load<f2_aligned>(&f2[i * sz4 + sz * 3]);
+    r0       = T::madd(s10, s20, r0);
+    r1       = T::madd(s11, s21, r1);
+    r2       = T::madd(s12, s22, r2);
+    r3       = T::madd(s13, s23, r3);
+  }
+  size_t idx = n4 * sz4;
+  for (size_t i = 0; i < n1; ++i) {
+    auto s1 = T::template load<f1_aligned>(&f1[idx + i * sz]);
+    auto s2 = T::template load<f2_aligned>(&f2[idx + i * sz]);
+    r0      = T::madd(s1, s2, r0);
+  }
+  r0                         = T::add(r0, r1);
+  r2                         = T::add(r2, r3);
+  r0                         = T::add(r0, r2);
+  typename T::value_type sum = T::resemble(r0);
+  idx += n1 * sz;
+  for (size_t i = 0; i < remain; ++i) {
+    sum += f1[idx + i] * f2[idx + i];
+  }
+  return sum;
+}
+
+template <typename T, typename dst_aligned>
+MNN_MUST_INLINE void add(typename T::value_type c,
+                         std::size_t size,
+                         typename T::value_type *dst) {
+  typename T::register_type c2 = T::set1(c);
+  auto sz                      = T::unroll_size;
+  auto sz4                     = T::unroll_size * 4;
+  auto n4                      = size / sz4;
+  auto n1                      = (size % sz4) / sz;
+  auto remain                  = size % sz;
+  for (size_t i = 0; i < n4; ++i) {
+    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
+    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
+    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
+    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
+    d0      = T::add(c2, d0);
+    d1      = T::add(c2, d1);
+    d2      = T::add(c2, d2);
+    d3      = T::add(c2, d3);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
+  }
+  size_t idx = n4 * sz4;
+  for (size_t i = 0; i < n1; ++i) {
+    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
+    d      = T::add(c2, d);
+    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+  }
+  idx += n1 * sz;
+  for (size_t i = 0; i < remain; ++i) {
+    dst[idx + i] += c;
+  }
+}
+
+template <typename T, typename src_aligned, typename dst_aligned>
+MNN_MUST_INLINE void add(const typename T::value_type *src,
+                         std::size_t size,
+                         typename T::value_type *dst) {
+  auto sz     = T::unroll_size;
+  auto sz4    = T::unroll_size * 4;
+  auto n4     = size / sz4;
+  auto n1     = (size % sz4) / sz;
+  auto remain = size % sz;
+  for (size_t i = 0; i < n4; ++i) {
+    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
+    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
+    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
+    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
+    auto s0 = T::template load<src_aligned>(&src[i * sz4 + sz * 0]);
+    auto s1 = T::template load<src_aligned>(&src[i * sz4 + sz * 1]);
+    auto s2 = T::template load<src_aligned>(&src[i * sz4 + sz * 2]);
+    auto s3 = T::template load<src_aligned>(&src[i * sz4 + sz * 3]);
+    d0      = T::add(s0, d0);
+    d1      = T::add(s1, d1);
+    d2      = T::add(s2, d2);
+    d3      = T::add(s3, d3);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
+  }
+  size_t idx = n4 * sz4;
+  for (size_t i = 0; i < n1; ++i) {
+    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
+    auto s = T::template load<src_aligned>(&src[idx + i * sz]);
+    d      = T::add(s, d);
+    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+  }
+  idx += n1 * sz;
+  for (size_t i = 0; i < remain; ++i) {
+    dst[idx + i] += src[idx + i];
+  }
+}
+
+template <typename T, typename src_aligned, typename dst_aligned>
+MNN_MUST_INLINE void muladd(const typename T::value_type *src,
+                            typename T::value_type c,
+                            std::size_t size,
+                            typename T::value_type *dst) {
+  auto factor = T::set1(c);
+  auto sz     = T::unroll_size;
+  auto sz4    = T::unroll_size * 4;
+  auto n4     = size / sz4;
+  auto n1     = (size % sz4) / sz;
+  auto remain = size % sz;
+  for (size_t i = 0; i < n4; ++i) {
+    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
+    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
+    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
+    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
+    auto s0 = T::template load<src_aligned>(&src[i * sz4 + sz * 0]);
+    auto s1 = T::template load<src_aligned>(&src[i * sz4 + sz * 1]);
+    auto s2 = T::template load<src_aligned>(&src[i * sz4 + sz * 2]);
+    auto s3 = T::template load<src_aligned>(&src[i * sz4 + sz * 3]);
+    d0      = T::madd(s0, factor, d0);
+    d1      = T::madd(s1, factor, d1);
+    d2      = T::madd(s2, factor, d2);
+    d3      = T::madd(s3, factor, d3);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
+  }
+  size_t idx = n4 * sz4;
+  for (size_t i = 0; i < n1; ++i) {
+    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
+    auto s = T::template load<src_aligned>(&src[idx + i * sz]);
+    d      = T::madd(s, factor, d);
+    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+  }
+  idx += n1 * sz;
+  for (size_t i = 0; i < remain; ++i) {
+    dst[idx + i] += src[idx + i] * c;
+  }
+}
+
+template <typename T, typename src_aligned, typename dst_aligned>
+MNN_MUST_INLINE void reduce(const typename T::value_type *src,
+                            std::size_t size,
+                            typename T::value_type *dst) {
+  auto sz     = T::unroll_size;
+  auto sz4    = T::unroll_size * 4;
+  auto n4     = size / sz4;
+  auto n1     = (size % sz4) / sz;
+  auto remain = size % sz;
+  for (size_t i = 0; i < n4; ++i) {
+    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
+    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
+    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
+    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
+    auto s0 = T::template load<src_aligned>(&src[i * sz4 + sz * 0]);
+    auto s1 = T::template load<src_aligned>(&src[i * sz4 + sz * 1]);
+    auto s2 = T::template load<src_aligned>(&src[i * sz4 + sz * 2]);
+    auto s3 = T::template load<src_aligned>(&src[i * sz4 + sz * 3]);
+    d0      = T::add(s0, d0);
+    d1      = T::add(s1, d1);
+    d2      = T::add(s2, d2);
+    d3      = T::add(s3, d3);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
+  }
+  size_t idx = n4 * sz4;
+  for (size_t i = 0; i < n1; ++i) {
+    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
+    auto s = T::template load<src_aligned>(&src[idx + i * sz]);
+    d      = T::add(s, d);
+    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+  }
+  idx += n1 * sz;
+  for (size_t i = 0; i < remain; ++i) {
+    dst[idx + i] += src[idx + i];
+  }
+}
 
-// dst[i] += c
 template <typename T>
-void add(T c, std::size_t size, T *dst) {
-  bool is_dst_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)dst);
-  if (is_dst_aligned) {
-    detail::add<MNN_VECTORIZE_TYPE, std::true_type>(c, size, dst);
+void fill(T *dst, size_t size, T value) {
+  std::fill(dst, dst + size, value);
+}
+
+
+// pick the widest register traits enabled at build time
+#ifdef MNN_USE_DOUBLE
+#if defined(MNN_USE_AVX512)
+#define MNN_VECTORIZE_TYPE detail::Avx512Double
+#elif defined(MNN_USE_AVX2)
+#define MNN_VECTORIZE_TYPE detail::Avx2Double
+#elif defined(MNN_USE_AVX)
+#define MNN_VECTORIZE_TYPE detail::AvxDouble
+#elif defined(MNN_USE_SSE)
+#define MNN_VECTORIZE_TYPE detail::SseDouble
+#else
+#define MNN_VECTORIZE_TYPE detail::GenericScalar<double>
+#endif
+#else
+#if defined(MNN_USE_AVX512VNNI)
+#define MNN_VECTORIZE_TYPE detail::Avx512VnniFloat
+#elif defined(MNN_USE_AVX512)
+#define MNN_VECTORIZE_TYPE detail::Avx512Float
+#elif defined(MNN_USE_AVX2)
+#define MNN_VECTORIZE_TYPE detail::Avx2Float
+#elif defined(MNN_USE_AVX)
+#define MNN_VECTORIZE_TYPE detail::AvxFloat
+#elif defined(MNN_USE_SSE)
+#define MNN_VECTORIZE_TYPE detail::SseFloat
+#else
+#define MNN_VECTORIZE_TYPE detail::GenericScalar<float>
+#endif
+#endif
+
+// alignment dispatch of the kernels above for the register traits V
+template <typename V>
+void aligned_add(typename V::value_type c,
+                 std::size_t size,
+                 typename V::value_type *dst) {
+  if (V::is_aligned(dst)) {
+    add<V, std::true_type>(c, size, dst);
+  } else {
+    add<V, std::false_type>(c, size, dst);
+  }
+}
+
+template <typename V>
+void aligned_add(const typename V::value_type *src,
+                 std::size_t size,
+                 typename V::value_type *dst) {
+  bool src_aligned = V::is_aligned((typename V::value_type *)src);
+  bool dst_aligned = V::is_aligned(dst);
+  if (src_aligned) {
+    if (dst_aligned) {
+      add<V, std::true_type, std::true_type>(src, size, dst);
+    } else {
+      add<V, std::true_type, std::false_type>(src, size, dst);
+    }
+  } else {
+    if (dst_aligned) {
+      add<V, std::false_type, std::true_type>(src, size, dst);
+    } else {
+      add<V, std::false_type, std::false_type>(src, size, dst);
+    }
+  }
+}
+
+template <typename V>
+void aligned_muladd(const typename V::value_type *src,
+                    typename V::value_type c,
+                    std::size_t size,
+                    typename V::value_type *dst) {
+  bool src_aligned = V::is_aligned((typename V::value_type *)src);
+  bool dst_aligned = V::is_aligned(dst);
+  if (src_aligned) {
+    if (dst_aligned) {
+      muladd<V, std::true_type, std::true_type>(src, c, size, dst);
+    } else {
+      muladd<V, std::true_type, std::false_type>(src, c, size, dst);
+    }
+  } else {
+    if (dst_aligned) {
+      muladd<V, std::false_type, std::true_type>(src, c, size, dst);
+    } else {
+      muladd<V, std::false_type, std::false_type>(src, c, size, dst);
+    }
+  }
+}
+
+template <typename V>
+typename V::value_type aligned_dot(const typename V::value_type *s1,
+                                   const typename V::value_type *s2,
+                                   std::size_t size) {
+  bool s1_aligned = V::is_aligned((typename V::value_type *)s1);
+  bool s2_aligned = V::is_aligned((typename V::value_type *)s2);
+  if (s1_aligned) {
+    if (s2_aligned) {
+      return dot_product<V, std::true_type, std::true_type>(s1, s2, size);
+    } else {
+      return dot_product<V, std::true_type, std::false_type>(s1, s2, size);
+    }
   } else {
-    detail::add<MNN_VECTORIZE_TYPE, std::false_type>(c, size, dst);
+    if (s2_aligned) {
+      return dot_product<V, std::false_type, std::true_type>(s1, s2, size);
+    } else {
+      return dot_product<V, std::false_type, std::false_type>(s1, s2, size);
+    }
+  }
+}
+
+template <typename V>
+void aligned_reduce(const typename V::value_type *src,
+                    std::size_t size,
+                    typename V::value_type *dst) {
+  bool src_aligned = V::is_aligned((typename V::value_type *)src);
+  bool dst_aligned = V::is_aligned(dst);
+  if (src_aligned) {
+    if (dst_aligned) {
+      reduce<V, std::true_type, std::true_type>(src, size, dst);
+    } else {
+      reduce<V, std::true_type, std::false_type>(src, size, dst);
+    }
+  } else {
+    if (dst_aligned) {
+      reduce<V, std::false_type, std::true_type>(src, size, dst);
+    } else {
+      reduce<V, std::false_type, std::false_type>(src, size, dst);
+    }
+  }
+}
+
+// running max over candidate rows, for max pooling: where src[i] > dst[i]
+// the value goes to dst[i] and pos to arg[i], so ties keep the earlier pos.
+template <typename V>
+void max_update(const typename V::value_type *src,
+                std::size_t size,
+                typename V::value_type pos,
+                typename V::value_type *dst,
+                typename V::value_type *arg) {
+  typedef typename V::register_type register_type;
+  const std::size_t sz = V::unroll_size;
+  const std::size_t n  = size / sz * sz;
+  const register_type p = V::set1(pos);
+  std::size_t i = 0;
+  for (; i < n; i += sz) {
+    register_type s = V::template load<std::false_type>(&src[i]);
+    register_type d = V::template load<std::false_type>(&dst[i]);
+    register_type a = V::template load<std::false_type>(&arg[i]);
+    V::template store<std::false_type>(&arg[i], V::select_greater(s, d, p, a));
+    V::template store<std::false_type>(&dst[i], V::select_greater(s, d, s, d));
+  }
+  for (; i < size; ++i) {
+    if (src[i] > dst[i]) {
+      dst[i] = src[i];
+      arg[i] = pos;
+    }
+  }
+}
+
+// Half precision storage formats: IEEE binary16 and bfloat16, the upper
+// half of a binary32. from_float rounds to the nearest even value, with
+// fp16 overflowing to inf from 65520 on; NaN stays NaN.
+struct Fp16 {
+  static MNN_MUST_INLINE float to_float(std::uint16_t h) {
+    const std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+    const std::uint32_t exp  = (h >> 10) & 0x1f;
+    const std::uint32_t mant = h & 0x3ff;
+    std::uint32_t bits;
+    if (exp == 0) {
+      // zero or subnormal, mant * 2^-24
+      float f = std::ldexp(static_cast<float>(mant), -24);
+      return sign ? -f : f;
+    } else if (exp == 0x1f) {
+      bits = sign | 0x7f800000 | (mant << 13);
+    } else {
+      bits = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+
+  static MNN_MUST_INLINE std::uint16_t from_float(float f) {
+    std::uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const std::uint16_t sign = static_cast<std::uint16_t>((x >> 16) & 0x8000);
+    x &= 0x7fffffff;
+    if (x > 0x7f800000) return sign | 0x7e00;
+    if (x >= 0x477ff000) return sign | 0x7c00;
+    if (x < 0x38800000) {
+      // below the smallest normal: round in units of 2^-24
+      return sign | static_cast<std::uint16_t>(
+                      std::nearbyint(std::fabs(f) * 16777216.0f));
+    }
+    x -= 0x38000000;
+    x += 0xfff + ((x >> 13) & 1);
+    return sign | static_cast<std::uint16_t>(x >> 13);
+  }
+};
+
+struct Bf16 {
+  static MNN_MUST_INLINE float to_float(std::uint16_t h) {
+    const std::uint32_t bits = static_cast<std::uint32_t>(h) << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+
+  static MNN_MUST_INLINE std::uint16_t from_float(float f) {
+    std::uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) {
+      return static_cast<std::uint16_t>((x >> 16) | 0x40);
+    }
+    x += 0x7fff + ((x >> 16) & 1);
+    return static_cast<std::uint16_t>(x >> 16);
+  }
+};
+
+// unroll_size values in the half format H widened to a register of V
+template <typename V, typename H>
+struct HalfLoad {
+  static MNN_MUST_INLINE typename V::register_type load(
+    const std::uint16_t *px) {
+    alignas(64) typename V::value_type lanes[V::unroll_size];
+    for (int i = 0; i < V::unroll_size; i++) lanes[i] = H::to_float(px[i]);
+    return V::template load<std::true_type>(lanes);
+  }
+};
+
+#if defined(MNN_USE_SSE) || defined(MNN_USE_AVX) || defined(MNN_USE_AVX2)
+// fp16 held zero extended in 32-bit lanes, without F16C: exponent and
+// mantissa are shifted into place and scaled by 2^112, which normalizes
+// subnormals too, and inf and NaN get the full exponent
+MNN_MUST_INLINE __m128 fp16_to_float(__m128i h) {
+  __m128i mag = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+  __m128 f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(mag, 13)),
+                        _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+  __m128i inf = _mm_and_si128(_mm_cmpgt_epi32(mag, _mm_set1_epi32(0x7bff)),
+                              _mm_set1_epi32(0x7f800000));
+  __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+  return _mm_or_ps(f, _mm_castsi128_ps(_mm_or_si128(inf, sign)));
+}
+#endif
+
+#ifdef MNN_USE_SSE
+template <>
+struct HalfLoad<SseFloat, Fp16> {
+  static MNN_MUST_INLINE __m128 load(const std::uint16_t *px) {
+    __m128i h = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(px));
+    return fp16_to_float(_mm_unpacklo_epi16(h, _mm_setzero_si128()));
+  }
+};
+
+// a bf16 is the upper half of the float: interleave it with zeros
+template <>
+struct HalfLoad<SseFloat, Bf16> {
+  static MNN_MUST_INLINE __m128 load(const std::uint16_t *px) {
+    __m128i h = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(px));
+    return _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), h));
+  }
+};
+#endif
+
+#if defined(MNN_USE_AVX) || defined(MNN_USE_AVX2)
+// AVX lacks 256-bit integer ops, so the halves are widened 4 at a time;
+// F16C may be missing on AVX-only cores
+template <>
+struct HalfLoad<AvxFloat, Fp16> {
+  static MNN_MUST_INLINE __m256 load(const std::uint16_t *px) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(px));
+    __m128 lo = fp16_to_float(_mm_unpacklo_epi16(h, _mm_setzero_si128()));
+    __m128 hi = fp16_to_float(_mm_unpackhi_epi16(h, _mm_setzero_si128()));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+  }
+};
+
+template <>
+struct HalfLoad<AvxFloat, Bf16> {
+  static MNN_MUST_INLINE __m256 load(const std::uint16_t *px) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(px));
+    __m128i lo = _mm_unpacklo_epi16(_mm_setzero_si128(), h);
+    __m128i hi = _mm_unpackhi_epi16(_mm_setzero_si128(), h);
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_castsi128_ps(lo)),
+                                _mm_castsi128_ps(hi), 1);
+  }
+};
+#endif
+
+#ifdef MNN_USE_AVX2
+template <>
+struct HalfLoad<Avx2Float, Fp16> {
+  static MNN_MUST_INLINE __m256 load(const std::uint16_t *px) {
+    return _mm256_cvtph_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(px)));
+  }
+};
+
+template <>
+struct HalfLoad<Avx2Float, Bf16> {
+  static MNN_MUST_INLINE __m256 load(const std::uint16_t *px) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(px));
+    return _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+  }
+};
+#endif  // MNN_USE_AVX2
+
+#ifdef MNN_USE_AVX512
+template <>
+struct HalfLoad<Avx512Float, Fp16> {
+  static MNN_MUST_INLINE __m512 load(const std::uint16_t *px) {
+    // the maskz forms spare GCC 12 a bogus -Wmaybe-uninitialized
+    return _mm512_maskz_cvtph_ps(
+      0xffff, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(px)));
+  }
+};
+
+template <>
+struct HalfLoad<Avx512Float, Bf16> {
+  static MNN_MUST_INLINE __m512 load(const std::uint16_t *px) {
+    __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(px));
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(
+      0xffff, _mm512_maskz_cvtepu16_epi32(0xffff, h), 16));
+  }
+};
+#endif  // MNN_USE_AVX512
+
+#ifdef MNN_USE_AVX512VNNI
+template <typename H>
+struct HalfLoad<Avx512VnniFloat, H> : public HalfLoad<Avx512Float, H> {};
+#endif
+
+// dst[i] = src[i] widened from the half format H
+template <typename V, typename H>
+void widen(const std::uint16_t *src,
+           std::size_t size,
+           typename V::value_type *dst) {
+  const std::size_t sz = V::unroll_size;
+  const std::size_t n  = size / sz * sz;
+  std::size_t i = 0;
+  for (; i < n; i += sz) {
+    V::template store<std::false_type>(&dst[i], HalfLoad<V, H>::load(&src[i]));
+  }
+  for (; i < size; ++i) {
+    dst[i] = H::to_float(src[i]);
   }
 }
 
-// dst[i] += src[i]
+// dst[i] += c * src[i], with src in the half format H
+template <typename V, typename H>
+void muladd_half(const std::uint16_t *src,
+                 typename V::value_type c,
+                 std::size_t size,
+                 typename V::value_type *dst) {
+  typedef typename V::register_type register_type;
+  const std::size_t sz = V::unroll_size;
+  const std::size_t n  = size / sz * sz;
+  const register_type cv = V::set1(c);
+  std::size_t i = 0;
+  for (; i < n; i += sz) {
+    register_type d = V::template load<std::false_type>(&dst[i]);
+    V::template store<std::false_type>(
+      &dst[i], V::madd(cv, HalfLoad<V, H>::load(&src[i]), d));
+  }
+  for (; i < size; ++i) {
+    dst[i] += c * H::to_float(src[i]);
+  }
+}
+
+// the kernels above per format, as kernel table entries
+template <typename V>
+void widen_fp16(const std::uint16_t *src,
+                std::size_t size,
+                typename V::value_type *dst) {
+  widen<V, Fp16>(src, size, dst);
+}
+
+template <typename V>
+void widen_bf16(const std::uint16_t *src,
+                std::size_t size,
+                typename V::value_type *dst) {
+  widen<V, Bf16>(src, size, dst);
+}
+
+template <typename V>
+void muladd_fp16(const std::uint16_t *src,
+                 typename V::value_type c,
+                 std::size_t size,
+                 typename V::value_type *dst) {
+  muladd_half<V, Fp16>(src, c, size, dst);
+}
+
+template <typename V>
+void muladd_bf16(const std::uint16_t *src,
+                 typename V::value_type c,
+                 std::size_t size,
+                 typename V::value_type *dst) {
+  muladd_half<V, Bf16>(src, c, size, dst);
+}
+
+// exp, tanh and sigmoid on registers. exp reduces x = n ln2 + r with
+// |r| <= ln2 / 2 (Cody-Waite) and scales a polynomial of e^r by 2^n; tanh
+// uses an odd polynomial below 0.625 and 1 - 2 / (e^2x + 1) above, as in
+// cephes. Max errors measured against libm over the normal range, the
+// same on every tier:
+//   float:  exp 1 ulp, tanh 2 ulp, sigmoid 3 ulp
+//   double: exp 1 ulp, tanh 2 ulp, sigmoid 2 ulp
+// exp flushes to 0 where the result would be subnormal and overflows to
+// inf slightly early (88.376 for float, 709.43 for double). NaN propagates.
+template <typename V, typename T = typename V::value_type>
+struct Transcendental;
+
+template <typename V>
+struct Transcendental<V, float> {
+  typedef typename V::register_type register_type;
+
+  static MNN_MUST_INLINE register_type exp(const register_type &x) {
+    const register_type lo = V::set1(-87.68f);
+    const register_type hi = V::set1(88.376f);
+    const register_type magic = V::set1(12582912.0f);  // rounds to integers
+    register_type t = V::max(lo, V::min(hi, x));
+    register_type n = V::sub(
+        V::madd(t, V::set1(1.44269504088896341f), magic), magic);
+    register_type r = V::madd(n, V::set1(-0.693359375f), t);
+    r = V::madd(n, V::set1(2.12194440e-4f), r);
+
+    register_type p = V::set1(1.9875691500e-4f);
+    p = V::madd(p, r, V::set1(1.3981999507e-3f));
+    p = V::madd(p, r, V::set1(8.3334519073e-3f));
+    p = V::madd(p, r, V::set1(4.1665795894e-2f));
+    p = V::madd(p, r, V::set1(1.6666665459e-1f));
+    p = V::madd(p, r, V::set1(5.0000001201e-1f));
+    p = V::madd(p, V::mul(r, r), V::add(r, V::set1(1.0f)));
+
+    register_type y = V::mul(p, V::exp2_int(n));
+    y = V::select_greater(x, hi,
+                          V::set1(std::numeric_limits<float>::infinity()), y);
+    return V::select_greater(lo, x, V::zero(), y);
+  }
+
+  static MNN_MUST_INLINE register_type tanh(const register_type &x) {
+    const register_type one = V::set1(1.0f);
+    register_type ax = V::max(x, V::sub(V::zero(), x));
+
+    register_type z = V::mul(ax, ax);
+    register_type p = V::set1(-5.70498872745e-3f);
+    p = V::madd(p, z, V::set1(2.06390887954e-2f));
+    p = V::madd(p, z, V::set1(-5.37397155531e-2f));
+    p = V::madd(p, z, V::set1(1.33314422036e-1f));
+    p = V::madd(p, z, V::set1(-3.33332819422e-1f));
+    register_type small = V::madd(V::mul(p, z), ax, ax);
+
+    register_type e = exp(V::add(ax, ax));
+    register_type large = V::sub(one, V::div(V::set1(2.0f), V::add(e, one)));
+
+    register_type y = V::select_greater(ax, V::set1(0.625f), large, small);
+    return V::select_greater(V::zero(), x, V::sub(V::zero(), y), y);
+  }
+};
+
+template <typename V>
+struct Transcendental<V, double> {
+  typedef typename V::register_type register_type;
+
+  static MNN_MUST_INLINE register_type exp(const register_type &x) {
+    const register_type lo = V::set1(-708.74);
+    const register_type hi = V::set1(709.43);
+    const register_type magic = V::set1(6755399441055744.0);
+    register_type t = V::max(lo, V::min(hi, x));
+    register_type n = V::sub(
+        V::madd(t, V::set1(1.4426950408889634073599), magic), magic);
+    register_type r = V::madd(n, V::set1(-6.93145751953125e-1), t);
+    r = V::madd(n, V::set1(-1.42860682030941723212e-6), r);
+
+    // Taylor series up to r^13, below half an ulp on |r| <= ln2 / 2
+    register_type p = V::set1(1.0 / 6227020800.0);
+    p = V::madd(p, r, V::set1(1.0 / 479001600.0));
+    p = V::madd(p, r, V::set1(1.0 / 39916800.0));
+    p = V::madd(p, r, V::set1(1.0 / 3628800.0));
+    p = V::madd(p, r, V::set1(1.0 / 362880.0));
+    p = V::madd(p, r, V::set1(1.0 / 40320.0));
+    p = V::madd(p, r, V::set1(1.0 / 5040.0));
+    p = V::madd(p, r, V::set1(1.0 / 720.0));
+    p = V::madd(p, r, V::set1(1.0 / 120.0));
+    p = V::madd(p, r, V::set1(1.0 / 24.0));
+    p = V::madd(p, r, V::set1(1.0 / 6.0));
+    p = V::madd(p, r, V::set1(0.5));
+    p = V::madd(p, V::mul(r, r), V::add(r, V::set1(1.0)));
+
+    register_type y = V::mul(p, V::exp2_int(n));
+    y = V::select_greater(x, hi,
+                          V::set1(std::numeric_limits<double>::infinity()), y);
+    return V::select_greater(lo, x, V::zero(), y);
+  }
+
+  static MNN_MUST_INLINE register_type tanh(const register_type &x) {
+    const register_type one = V::set1(1.0);
+    register_type ax = V::max(x, V::sub(V::zero(), x));
+
+    register_type z = V::mul(ax, ax);
+    register_type p = V::set1(-9.64399179425052238628e-1);
+    p = V::madd(p, z, V::set1(-9.92877231001918586564e1));
+    p = V::madd(p, z, V::set1(-1.61468768441708447952e3));
+    register_type q = V::add(z, V::set1(1.12811678491632931402e2));
+    q = V::madd(q, z, V::set1(2.23548839060100448583e3));
+    q = V::madd(q, z, V::set1(4.84406305325125486048e3));
+    register_type small = V::madd(V::div(V::mul(p, z), q), ax, ax);
+
+    register_type e = exp(V::add(ax, ax));
+    register_type large = V::sub(one, V::div(V::set1(2.0), V::add(e, one)));
+
+    register_type y = V::select_greater(ax, V::set1(0.625), large, small);
+    return V::select_greater(V::zero(), x, V::sub(V::zero(), y), y);
+  }
+};
+
+template <typename V>
+struct ExpOp {
+  static MNN_MUST_INLINE typename V::register_type apply(
+      const typename V::register_type &x) {
+    return Transcendental<V>::exp(x);
+  }
+};
+
+template <typename V>
+struct TanhOp {
+  static MNN_MUST_INLINE typename V::register_type apply(
+      const typename V::register_type &x) {
+    return Transcendental<V>::tanh(x);
+  }
+};
+
+template <typename V>
+struct SigmoidOp {
+  static MNN_MUST_INLINE typename V::register_type apply(
+      const typename V::register_type &x) {
+    const typename V::register_type one = V::set1(1);
+    return V::div(one,
+                  V::add(one, Transcendental<V>::exp(V::sub(V::zero(), x))));
+  }
+};
+
+// dst[i] = Op(src[i]), src and dst may be the same. The tail goes through
+// a register as well, so a value doesn't depend on its position.
+template <typename V, template <typename> class Op>
+void transform(const typename V::value_type *src,
+               std::size_t size,
+               typename V::value_type *dst) {
+  typedef typename V::value_type value_type;
+  const std::size_t sz = V::unroll_size;
+  const std::size_t n  = size / sz * sz;
+  std::size_t i = 0;
+  for (; i < n; i += sz) {
+    V::template store<std::false_type>(
+        &dst[i], Op<V>::apply(V::template load<std::false_type>(&src[i])));
+  }
+  if (i < size) {
+    alignas(64) value_type tail[sz] = {};
+    std::copy(src + i, src + size, tail);
+    V::template store<std::true_type>(
+        tail, Op<V>::apply(V::template load<std::true_type>(tail)));
+    std::copy(tail, tail + (size - i), dst + i);
+  }
+}
+
+template <typename V>
+void exp(const typename V::value_type *src,
+         std::size_t size,
+         typename V::value_type *dst) {
+  transform<V, ExpOp>(src, size, dst);
+}
+
+template <typename V>
+void tanh(const typename V::value_type *src,
+          std::size_t size,
+          typename V::value_type *dst) {
+  transform<V, TanhOp>(src, size, dst);
+}
+
+template <typename V>
+void sigmoid(const typename V::value_type *src,
+             std::size_t size,
+             typename V::value_type *dst) {
+  transform<V, SigmoidOp>(src, size, dst);
+}
+
+// Hyper-parameters of the optimizer steps below, for the current step.
+// The steps take the raw merged gradient and apply scale (1 / batch) on
+// the fly, so gradient, weights and moments are read and written once.
 template <typename T>
-void add(const T *src, std::size_t size, T *dst) {
-  bool src_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)src);
-  bool dst_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)dst);
-  if (src_aligned) {
-    if (dst_aligned) {
-      detail::add<MNN_VECTORIZE_TYPE, std::true_type, std::true_type>(src, size,
-                                                                      dst);
-    } else {
-      detail::add<MNN_VECTORIZE_TYPE, std::true_type, std::false_type>(
-        src, size, dst);
+struct StepParams {
+  T scale;
+  T alpha;   // learning rate
+  T lambda;  // weight decay
+  T eps;
+  T b1, b2;  // decay terms
+  T c1, c2;  // bias corrections 1 / (1 - b1^t) and 1 / (1 - b2^t)
+};
+
+// W -= alpha * (g + lambda * W)
+template <typename V>
+void sgd_step(const typename V::value_type *dW,
+              std::size_t size,
+              typename V::value_type *W,
+              const StepParams<typename V::value_type> &p) {
+  typedef typename V::register_type register_type;
+  const std::size_t sz = V::unroll_size;
+  const std::size_t n  = size / sz * sz;
+  const register_type scale = V::set1(p.scale);
+  const register_type lambda = V::set1(p.lambda);
+  const register_type alpha = V::set1(-p.alpha);
+  std::size_t i = 0;
+  for (; i < n; i += sz) {
+    register_type w = V::template load<std::false_type>(&W[i]);
+    register_type g = V::mul(V::template load<std::false_type>(&dW[i]), scale);
+    V::template store<std::false_type>(
+        &W[i], V::madd(alpha, V::madd(lambda, w, g), w));
+  }
+  for (; i < size; ++i) {
+    W[i] -= p.alpha * (dW[i] * p.scale + p.lambda * W[i]);
+  }
+}
+
+// h += g^2, W -= alpha * g / (sqrt(h) + eps)
+template <typename V>
+void adagrad_step(const typename V::value_type *dW,
+                  std::size_t size,
+                  typename V::value_type *W,
+                  typename V::value_type *h,
+                  const StepParams<typename V::value_type> &p) {
+  typedef typename V::register_type register_type;
+  const std::size_t sz = V::unroll_size;
+  const std::size_t n  = size / sz * sz;
+  const register_type scale = V::set1(p.scale);
+  const register_type alpha = V::set1(p.alpha);
+  const register_type eps = V::set1(p.eps);
+  std::size_t i = 0;
+  for (; i < n; i += sz) {
+    register_type g = V::mul(V::template load<std::false_type>(&dW[i]), scale);
+    register_type hi = V::madd(g, g, V::template load<std::false_type>(&h[i]));
+    register_type w = V::template load<std::false_type>(&W[i]);
+    V::template store<std::false_type>(&h[i], hi);
+    V::template store<std::false_type>(
+        &W[i], V::sub(w, V::div(V::mul(alpha, g), V::add(V::sqrt(hi), eps))));
+  }
+  for (; i < size; ++i) {
+    typename V::value_type g = dW[i] * p.scale;
+    h[i] += g * g;
+    W[i] -= p.alpha * g / (std::sqrt(h[i]) + p.eps);
+  }
+}
+
+// m = b1 m + (1 - b1) g, v = b2 v + (1 - b2) g^2,
+// W -= alpha * m c1 / sqrt(v c2 + eps)
+template <typename V>
+void adam_step(const typename V::value_type *dW,
+               std::size_t size,
+               typename V::value_type *W,
+               typename V::value_type *m,
+               typename V::value_type *v,
+               const StepParams<typename V::value_type> &p) {
+  typedef typename V::register_type register_type;
+  typedef typename V::value_type value_type;
+  const std::size_t sz = V::unroll_size;
+  const std::size_t n  = size / sz * sz;
+  const register_type scale = V::set1(p.scale);
+  const register_type b1 = V::set1(p.b1);
+  const register_type b2 = V::set1(p.b2);
+  const register_type g1 = V::set1(value_type(1) - p.b1);
+  const register_type g2 = V::set1(value_type(1) - p.b2);
+  const register_type alpha = V::set1(p.alpha * p.c1);
+  const register_type c2 = V::set1(p.c2);
+  const register_type eps = V::set1(p.eps);
+  std::size_t i = 0;
+  for (; i < n; i += sz) {
+    register_type g = V::mul(V::template load<std::false_type>(&dW[i]), scale);
+    register_type mi = V::madd(b1, V::template load<std::false_type>(&m[i]),
+                               V::mul(g1, g));
+    register_type vi = V::madd(b2, V::template load<std::false_type>(&v[i]),
+                               V::mul(g2, V::mul(g, g)));
+    register_type w = V::template load<std::false_type>(&W[i]);
+    V::template store<std::false_type>(&m[i], mi);
+    V::template store<std::false_type>(&v[i], vi);
+    V::template store<std::false_type>(
+        &W[i], V::sub(w, V::div(V::mul(alpha, mi),
+                                V::sqrt(V::madd(vi, c2, eps)))));
+  }
+  for (; i < size; ++i) {
+    value_type g = dW[i] * p.scale;
+    m[i] = p.b1 * m[i] + (value_type(1) - p.b1) * g;
+    v[i] = p.b2 * v[i] + (value_type(1) - p.b2) * g * g;
+    W[i] -= p.alpha * p.c1 * m[i] / std::sqrt(v[i] * p.c2 + p.eps);
+  }
+}
+
+// Register-tiled GEMM micro kernel: c[MR x NR] += a * b over kc steps, where
+// a holds MR values per step and b holds NR = NV * unroll_size values per
+// step, the latter aligned to the register width. The accumulators stay in
+// registers as long as MR * NV + NV + 1 of them fit.
+template <typename V, int MR, int NV>
+void gemm_micro_kernel(std::size_t kc,
+                       const typename V::value_type *a,
+                       const typename V::value_type *b,
+                       typename V::value_type *c,
+                       std::size_t ldc) {
+  typedef typename V::register_type register_type;
+  const int sz = V::unroll_size;
+  register_type acc[MR][NV];
+  for (int i = 0; i < MR; ++i) {
+    for (int j = 0; j < NV; ++j) acc[i][j] = V::zero();
+  }
+  for (std::size_t p = 0; p < kc; ++p) {
+    register_type bv[NV];
+    for (int j = 0; j < NV; ++j) {
+      bv[j] = V::template load<std::true_type>(&b[j * sz]);
     }
-  } else {
-    if (dst_aligned) {
-      detail::add<MNN_VECTORIZE_TYPE, std::false_type, std::true_type>(
-        src, size, dst);
-    } else {
-      detail::add<MNN_VECTORIZE_TYPE, std::false_type, std::false_type>(
-        src, size, dst);
+    for (int i = 0; i < MR; ++i) {
+      register_type av = V::set1(a[i]);
+      for (int j = 0; j < NV; ++j) acc[i][j] = V::madd(av, bv[j], acc[i][j]);
+    }
+    a += MR;
+    b += NV * sz;
+  }
+  for (int i = 0; i < MR; ++i) {
+    for (int j = 0; j < NV; ++j) {
+      auto *pc = &c[i * ldc + j * sz];
+      auto d   = V::template load<std::false_type>(pc);
+      V::template store<std::false_type>(pc, V::add(d, acc[i][j]));
     }
   }
 }
 
-// dst[i] += c * src[i]
+// GEMM tile of the register traits V: 6 rows by two registers, which fills
+// the 16 SSE/AVX registers; the scalar fallback uses 4x4.
+template <typename V>
+struct GemmShape {
+  enum { mr = 6, nv = 2 };
+};
+
 template <typename T>
-void muladd(const T *src, T c, std::size_t size, T *dst) {
-  bool src_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)src);
-  bool dst_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)dst);
-  if (src_aligned) {
-    if (dst_aligned) {
-      detail::muladd<MNN_VECTORIZE_TYPE, std::true_type, std::true_type>(
-        src, c, size, dst);
-    } else {
-      detail::muladd<MNN_VECTORIZE_TYPE, std::true_type, std::false_type>(
-        src, c, size, dst);
+struct GemmShape<GenericScalar<T>> {
+  enum { mr = 4, nv = 4 };
+};
+
+// Int8 GEMM micro kernel of the tier whose float traits are V:
+// c[mr x nr] += a * b in exact int32 arithmetic over kp pairs of k.
+// Each step holds mr words of a, one per row, packing the int16 values of
+// two consecutive k as (lo, hi), and 2 * nr int8 values of b, the two k of
+// column j at 2 * j and 2 * j + 1. Operands are within [-127, 127], so the
+// 16-bit pair products (pmaddwd) never saturate, unlike pmaddubsw.
+template <typename V>
+struct QGemm {
+  enum { mr = 4, nr = 4 };
+
+  static void kernel(std::size_t kp,
+                     const std::int32_t *a,
+                     const std::int8_t *b,
+                     std::int32_t *c,
+                     std::size_t ldc) {
+    std::int32_t acc[mr][nr] = {};
+    for (std::size_t p = 0; p < kp; ++p) {
+      for (int i = 0; i < mr; ++i) {
+        const std::int32_t lo = static_cast<std::int16_t>(a[i] & 0xffff);
+        const std::int32_t hi = static_cast<std::int16_t>(
+          static_cast<std::uint32_t>(a[i]) >> 16);
+        for (int j = 0; j < nr; ++j) {
+          acc[i][j] += lo * b[2 * j] + hi * b[2 * j + 1];
+        }
+      }
+      a += mr;
+      b += 2 * nr;
     }
-  } else {
-    if (dst_aligned) {
-      detail::muladd<MNN_VECTORIZE_TYPE, std::false_type, std::true_type>(
-        src, c, size, dst);
-    } else {
-      detail::muladd<MNN_VECTORIZE_TYPE, std::false_type, std::false_type>(
-        src, c, size, dst);
+    for (int i = 0; i < mr; ++i) {
+      for (int j = 0; j < nr; ++j) c[i * ldc + j] += acc[i][j];
+    }
+  }
+
+  // dst[i] = round(src[i] * inv_step), clamped to [-127, 127]
+  static void quantize(const typename V::value_type *src,
+                       std::size_t size,
+                       typename V::value_type inv_step,
+                       std::int16_t *dst) {
+    typedef typename V::value_type value_type;
+    for (std::size_t i = 0; i < size; ++i) {
+      value_type q = std::max(value_type(-127),
+                              std::min(value_type(127), src[i] * inv_step));
+      dst[i]       = static_cast<std::int16_t>(std::nearbyint(q));
     }
   }
+};
+
+// the rest of QGemm<V>::quantize after a vectorized body, which rounds the
+// same way under the default rounding mode
+MNN_MUST_INLINE void quantize_tail(const float *src,
+                                   std::size_t size,
+                                   float inv_step,
+                                   std::int16_t *dst) {
+  for (std::size_t i = 0; i < size; ++i) {
+    float q = std::max(-127.0f, std::min(127.0f, src[i] * inv_step));
+    dst[i]  = static_cast<std::int16_t>(std::nearbyint(q));
+  }
 }
 
-// sum(s1[i] * s2[i])
-template <typename T>
-T dot(const T *s1, const T *s2, std::size_t size) {
-  bool s1_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)s1);
-  bool s2_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)s2);
-  if (s1_aligned) {
-    if (s2_aligned) {
-      return detail::dot_product<MNN_VECTORIZE_TYPE, std::true_type,
-                                 std::true_type>(s1, s2, size);
-    } else {
-      return detail::dot_product<MNN_VECTORIZE_TYPE, std::true_type,
-                                 std::false_type>(s1, s2, size);
+#if defined(MNN_USE_SSE) || defined(MNN_USE_AVX) || defined(MNN_USE_AVX2)
+// 128-bit integer registers; AVX has no 256-bit integer arithmetic.
+// Templated on the tier's traits so the SSE2 and AVX units each emit
+// their own copy, compiled with their own flags.
+template <typename V>
+struct QGemmSse {
+  enum { mr = 6, nv = 2, nr = nv * 4 };
+
+  static void kernel(std::size_t kp,
+                     const std::int32_t *a,
+                     const std::int8_t *b,
+                     std::int32_t *c,
+                     std::size_t ldc) {
+    __m128i acc[mr][nv];
+    for (int i = 0; i < mr; ++i) {
+      for (int j = 0; j < nv; ++j) acc[i][j] = _mm_setzero_si128();
     }
-  } else {
-    if (s2_aligned) {
-      return detail::dot_product<MNN_VECTORIZE_TYPE, std::false_type,
-                                 std::true_type>(s1, s2, size);
-    } else {
-      return detail::dot_product<MNN_VECTORIZE_TYPE, std::false_type,
-                                 std::false_type>(s1, s2, size);
+    for (std::size_t p = 0; p < kp; ++p) {
+      __m128i bv[nv];
+      for (int j = 0; j < nv; ++j) {
+        __m128i x =
+          _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + 8 * j));
+        bv[j] = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+      }
+      for (int i = 0; i < mr; ++i) {
+        __m128i av = _mm_set1_epi32(a[i]);
+        for (int j = 0; j < nv; ++j) {
+          acc[i][j] = _mm_add_epi32(acc[i][j], _mm_madd_epi16(av, bv[j]));
+        }
+      }
+      a += mr;
+      b += 2 * nr;
+    }
+    for (int i = 0; i < mr; ++i) {
+      for (int j = 0; j < nv; ++j) {
+        __m128i *pc = reinterpret_cast<__m128i *>(&c[i * ldc + j * 4]);
+        _mm_storeu_si128(pc, _mm_add_epi32(_mm_loadu_si128(pc), acc[i][j]));
+      }
+    }
+  }
+
+  static void quantize(const float *src,
+                       std::size_t size,
+                       float inv_step,
+                       std::int16_t *dst) {
+    const __m128 inv = _mm_set1_ps(inv_step);
+    const __m128 lo = _mm_set1_ps(-127.0f), hi = _mm_set1_ps(127.0f);
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      __m128 x0 = _mm_mul_ps(_mm_loadu_ps(src + i), inv);
+      __m128 x1 = _mm_mul_ps(_mm_loadu_ps(src + i + 4), inv);
+      x0 = _mm_min_ps(_mm_max_ps(x0, lo), hi);
+      x1 = _mm_min_ps(_mm_max_ps(x1, lo), hi);
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(dst + i),
+        _mm_packs_epi32(_mm_cvtps_epi32(x0), _mm_cvtps_epi32(x1)));
+    }
+    quantize_tail(src + i, size - i, inv_step, dst + i);
+  }
+};
+#endif
+
+#ifdef MNN_USE_SSE
+template <>
+struct QGemm<SseFloat> : public QGemmSse<SseFloat> {};
+#endif
+
+#if defined(MNN_USE_AVX) || defined(MNN_USE_AVX2)
+template <>
+struct QGemm<AvxFloat> : public QGemmSse<AvxFloat> {};
+#endif
+
+#ifdef MNN_USE_AVX2
+template <>
+struct QGemm<Avx2Float> {
+  enum { mr = 6, nv = 2, nr = nv * 8 };
+
+  static void kernel(std::size_t kp,
+                     const std::int32_t *a,
+                     const std::int8_t *b,
+                     std::int32_t *c,
+                     std::size_t ldc) {
+    __m256i acc[mr][nv];
+    for (int i = 0; i < mr; ++i) {
+      for (int j = 0; j < nv; ++j) acc[i][j] = _mm256_setzero_si256();
+    }
+    for (std::size_t p = 0; p < kp; ++p) {
+      __m256i bv[nv];
+      for (int j = 0; j < nv; ++j) {
+        bv[j] = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + 16 * j)));
+      }
+      for (int i = 0; i < mr; ++i) {
+        __m256i av = _mm256_set1_epi32(a[i]);
+        for (int j = 0; j < nv; ++j) {
+          acc[i][j] =
+            _mm256_add_epi32(acc[i][j], _mm256_madd_epi16(av, bv[j]));
+        }
+      }
+      a += mr;
+      b += 2 * nr;
+    }
+    for (int i = 0; i < mr; ++i) {
+      for (int j = 0; j < nv; ++j) {
+        __m256i *pc = reinterpret_cast<__m256i *>(&c[i * ldc + j * 8]);
+        _mm256_storeu_si256(
+          pc, _mm256_add_epi32(_mm256_loadu_si256(pc), acc[i][j]));
+      }
+    }
+  }
+
+  static void quantize(const float *src,
+                       std::size_t size,
+                       float inv_step,
+                       std::int16_t *dst) {
+    const __m256 inv = _mm256_set1_ps(inv_step);
+    const __m256 lo = _mm256_set1_ps(-127.0f), hi = _mm256_set1_ps(127.0f);
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+      __m256 x0 = _mm256_mul_ps(_mm256_loadu_ps(src + i), inv);
+      __m256 x1 = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), inv);
+      x0 = _mm256_min_ps(_mm256_max_ps(x0, lo), hi);
+      x1 = _mm256_min_ps(_mm256_max_ps(x1, lo), hi);
+      // packs works within 128-bit lanes, so put them back in order
+      __m256i q = _mm256_packs_epi32(_mm256_cvtps_epi32(x0),
+                                     _mm256_cvtps_epi32(x1));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                          _mm256_permute4x64_epi64(q, 0xd8));
     }
+    quantize_tail(src + i, size - i, inv_step, dst + i);
   }
+};
+#endif  // MNN_USE_AVX2
+
+#ifdef MNN_USE_AVX512
+// With VNNI the pair products and the accumulation fuse into vpdpwssd.
+template <typename V>
+struct QGemmAvx512 {
+  enum { mr = 8, nv = 2, nr = nv * 16 };
+
+  static MNN_MUST_INLINE __m512i dot_add(__m512i acc, __m512i a, __m512i b) {
+#ifdef MNN_USE_AVX512VNNI
+    return std::is_same<V, Avx512Float>::value
+             ? _mm512_add_epi32(acc, _mm512_madd_epi16(a, b))
+             : _mm512_dpwssd_epi32(acc, a, b);
+#else
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(a, b));
+#endif
+  }
+
+  static void kernel(std::size_t kp,
+                     const std::int32_t *a,
+                     const std::int8_t *b,
+                     std::int32_t *c,
+                     std::size_t ldc) {
+    __m512i acc[mr][nv];
+    for (int i = 0; i < mr; ++i) {
+      for (int j = 0; j < nv; ++j) acc[i][j] = _mm512_setzero_si512();
+    }
+    for (std::size_t p = 0; p < kp; ++p) {
+      __m512i bv[nv];
+      for (int j = 0; j < nv; ++j) {
+        bv[j] = _mm512_cvtepi8_epi16(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 32 * j)));
+      }
+      for (int i = 0; i < mr; ++i) {
+        __m512i av = _mm512_set1_epi32(a[i]);
+        for (int j = 0; j < nv; ++j) acc[i][j] = dot_add(acc[i][j], av, bv[j]);
+      }
+      a += mr;
+      b += 2 * nr;
+    }
+    for (int i = 0; i < mr; ++i) {
+      for (int j = 0; j < nv; ++j) {
+        std::int32_t *pc = &c[i * ldc + j * 16];
+        _mm512_storeu_si512(
+          pc, _mm512_add_epi32(_mm512_loadu_si512(pc), acc[i][j]));
+      }
+    }
+  }
+
+  static void quantize(const float *src,
+                       std::size_t size,
+                       float inv_step,
+                       std::int16_t *dst) {
+    // the zero-masked forms, since the plain ones trip gcc 12's
+    // -Wmaybe-uninitialized on their undefined pass-through operand
+    const __mmask16 all = 0xffff;
+    const __m512 inv    = _mm512_set1_ps(inv_step);
+    const __m512 lo = _mm512_set1_ps(-127.0f), hi = _mm512_set1_ps(127.0f);
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+      __m512 x = _mm512_mul_ps(_mm512_loadu_ps(src + i), inv);
+      x = _mm512_maskz_min_ps(all, _mm512_maskz_max_ps(all, x, lo), hi);
+      _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dst + i),
+        _mm512_maskz_cvtsepi32_epi16(all, _mm512_maskz_cvtps_epi32(all, x)));
+    }
+    quantize_tail(src + i, size - i, inv_step, dst + i);
+  }
+};
+
+template <>
+struct QGemm<Avx512Float> : public QGemmAvx512<Avx512Float> {};
+#endif  // MNN_USE_AVX512
+
+#ifdef MNN_USE_AVX512VNNI
+template <>
+struct QGemm<Avx512VnniFloat> : public QGemmAvx512<Avx512VnniFloat> {};
+#endif
+
+// Entry points of one instruction set tier. With runtime dispatch each tier
+// is compiled in its own translation unit (src/mnn/infra/vectorize_<isa>.cc)
+// with the matching -m flags, and the table of the best tier the host cpu
+// supports is picked on first use, see mnn::active_isa(). Those units must
+// include nothing but this header, so no inline code shared with the rest of
+// the library ends up compiled for a tier the host may lack.
+struct KernelTable {
+  typedef mnn::Float value_type;
+
+  mnn::Isa isa;
+  value_type (*dot)(const value_type *s1, const value_type *s2,
+                    std::size_t size);
+  void (*add_scalar)(value_type c, std::size_t size, value_type *dst);
+  void (*add)(const value_type *src, std::size_t size, value_type *dst);
+  void (*muladd)(const value_type *src, value_type c, std::size_t size,
+                 value_type *dst);
+  void (*reduce)(const value_type *src, std::size_t size, value_type *dst);
+  void (*max_update)(const value_type *src, std::size_t size, value_type pos,
+                     value_type *dst, value_type *arg);
+  void (*exp)(const value_type *src, std::size_t size, value_type *dst);
+  void (*tanh)(const value_type *src, std::size_t size, value_type *dst);
+  void (*sigmoid)(const value_type *src, std::size_t size, value_type *dst);
+  void (*sgd_step)(const value_type *dW, std::size_t size, value_type *W,
+                   const StepParams<value_type> &p);
+  void (*adagrad_step)(const value_type *dW, std::size_t size, value_type *W,
+                       value_type *h, const StepParams<value_type> &p);
+  void (*adam_step)(const value_type *dW, std::size_t size, value_type *W,
+                    value_type *m, value_type *v,
+                    const StepParams<value_type> &p);
+
+  // see gemm_micro_kernel and mnn::kernels::gemm
+  std::size_t gemm_mr;
+  std::size_t gemm_nr;
+  void (*gemm_kernel)(std::size_t kc, const value_type *a,
+                      const value_type *b, value_type *c, std::size_t ldc);
+
+  // see QGemm and mnn::kernels::qgemm
+  std::size_t qgemm_mr;
+  std::size_t qgemm_nr;
+  void (*qgemm_kernel)(std::size_t kp, const std::int32_t *a,
+                       const std::int8_t *b, std::int32_t *c,
+                       std::size_t ldc);
+  void (*quantize)(const value_type *src, std::size_t size,
+                   value_type inv_step, std::int16_t *dst);
+
+  // see widen and muladd_half
+  void (*widen_fp16)(const std::uint16_t *src, std::size_t size,
+                     value_type *dst);
+  void (*widen_bf16)(const std::uint16_t *src, std::size_t size,
+                     value_type *dst);
+  void (*muladd_fp16)(const std::uint16_t *src, value_type c,
+                      std::size_t size, value_type *dst);
+  void (*muladd_bf16)(const std::uint16_t *src, value_type c,
+                      std::size_t size, value_type *dst);
+};
+
+template <typename V>
+KernelTable make_kernel_table(mnn::Isa isa) {
+  static_assert(std::is_same<typename V::value_type, mnn::Float>::value,
+                "kernel tables are built for mnn::Float");
+  KernelTable table;
+  table.isa        = isa;
+  table.dot        = &aligned_dot<V>;
+  table.add_scalar = &aligned_add<V>;
+  table.add        = &aligned_add<V>;
+  table.muladd     = &aligned_muladd<V>;
+  table.reduce     = &aligned_reduce<V>;
+  table.max_update = &max_update<V>;
+  table.exp        = &exp<V>;
+  table.tanh       = &tanh<V>;
+  table.sigmoid    = &sigmoid<V>;
+  table.sgd_step     = &sgd_step<V>;
+  table.adagrad_step = &adagrad_step<V>;
+  table.adam_step    = &adam_step<V>;
+
+  const int mr      = GemmShape<V>::mr;
+  const int nv      = GemmShape<V>::nv;
+  table.gemm_mr     = mr;
+  table.gemm_nr     = nv * V::unroll_size;
+  table.gemm_kernel = &gemm_micro_kernel<V, mr, nv>;
+
+  table.qgemm_mr     = QGemm<V>::mr;
+  table.qgemm_nr     = QGemm<V>::nr;
+  table.qgemm_kernel = &QGemm<V>::kernel;
+  table.quantize     = &QGemm<V>::quantize;
+
+  table.widen_fp16  = &widen_fp16<V>;
+  table.widen_bf16  = &widen_bf16<V>;
+  table.muladd_fp16 = &muladd_fp16<V>;
+  table.muladd_bf16 = &muladd_bf16<V>;
+  return table;
+}
+
+// tables of the tiers built with runtime dispatch
+const KernelTable &sse2_kernel_table();
+const KernelTable &avx_kernel_table();
+const KernelTable &avx2_kernel_table();
+const KernelTable &avx512_kernel_table();
+const KernelTable &avx512_vnni_kernel_table();
+
+// table of the active tier
+const KernelTable &kernels();
+
+}  // namespace detail
+
+// With runtime dispatch the entry points go through the kernel table of the
+// active tier; otherwise they are inlined for the tier chosen at build time.
+#ifdef MNN_USE_RUNTIME_DISPATCH
+#define MNN_VECTORIZE_CALL(name, alt, ...) detail::kernels().alt(__VA_ARGS__)
+#else
+#define MNN_VECTORIZE_CALL(name, alt, ...) \
+  detail::name<MNN_VECTORIZE_TYPE>(__VA_ARGS__)
+#endif
+
+// dst[i] += c
+template <typename T>
+void add(T c, std::size_t size, T *dst) {
+  MNN_VECTORIZE_CALL(aligned_add, add_scalar, c, size, dst);
+}
+
+// dst[i] += src[i]
+template <typename T>
+void add(const T *src, std::size_t size, T *dst) {
+  MNN_VECTORIZE_CALL(aligned_add, add, src, size, dst);
+}
+
+// dst[i] += c * src[i]
+template <typename T>
+void muladd(const T *src, T c, std::size_t size, T *dst) {
+  MNN_VECTORIZE_CALL(aligned_muladd, muladd, src, c, size, dst);
+}
+
+// sum(s1[i] * s2[i])
+template <typename T>
+T dot(const T *s1, const T *s2, std::size_t size) {
+  return MNN_VECTORIZE_CALL(aligned_dot, dot, s1, s2, size);
 }
 
 /// dst[i] += src[i]
 template <typename T>
 void reduce(const T *src, std::size_t size, T *dst) {
-  bool src_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)src);
-  bool dst_aligned =
-    MNN_VECTORIZE_TYPE::is_aligned((MNN_VECTORIZE_TYPE::value_type *)dst);
-  if (src_aligned) {
-    if (dst_aligned) {
-      detail::reduce<MNN_VECTORIZE_TYPE, std::true_type, std::true_type>(
-        src, size, dst);
-    } else {
-      detail::reduce<MNN_VECTORIZE_TYPE, std::true_type, std::false_type>(
-        src, size, dst);
-    }
+  MNN_VECTORIZE_CALL(aligned_reduce, reduce, src, size, dst);
+}
+
+// dst[i] = max(dst[i], src[i]), with arg[i] = pos where src[i] wins
+template <typename T>
+void max_update(const T *src, std::size_t size, T pos, T *dst, T *arg) {
+  MNN_VECTORIZE_CALL(max_update, max_update, src, size, pos, dst, arg);
+}
+
+// dst[i] = exp(src[i]), see Transcendental for the accuracy
+template <typename T>
+void exp(const T *src, std::size_t size, T *dst) {
+  MNN_VECTORIZE_CALL(exp, exp, src, size, dst);
+}
+
+// dst[i] = tanh(src[i])
+template <typename T>
+void tanh(const T *src, std::size_t size, T *dst) {
+  MNN_VECTORIZE_CALL(tanh, tanh, src, size, dst);
+}
+
+// dst[i] = 1 / (1 + exp(-src[i]))
+template <typename T>
+void sigmoid(const T *src, std::size_t size, T *dst) {
+  MNN_VECTORIZE_CALL(sigmoid, sigmoid, src, size, dst);
+}
+
+using detail::StepParams;
+
+// fused optimizer steps on size weights, see detail::StepParams
+template <typename T>
+void sgd_step(const T *dW, std::size_t size, T *W, const StepParams<T> &p) {
+  MNN_VECTORIZE_CALL(sgd_step, sgd_step, dW, size, W, p);
+}
+
+template <typename T>
+void adagrad_step(const T *dW, std::size_t size, T *W, T *h,
+                  const StepParams<T> &p) {
+  MNN_VECTORIZE_CALL(adagrad_step, adagrad_step, dW, size, W, h, p);
+}
+
+template <typename T>
+void adam_step(const T *dW, std::size_t size, T *W, T *m, T *v,
+               const StepParams<T> &p) {
+  MNN_VECTORIZE_CALL(adam_step, adam_step, dW, size, W, m, v, p);
+}
+
+// dst[i] = src[i] rounded to the half precision p, see detail::Fp16
+template <typename T>
+void narrow(mnn::Precision p, const T *src, std::size_t size,
+            std::uint16_t *dst) {
+  for (std::size_t i = 0; i < size; ++i) {
+    const float f = static_cast<float>(src[i]);
+    dst[i] = p == mnn::Precision::BF16 ? detail::Bf16::from_float(f)
+                                       : detail::Fp16::from_float(f);
+  }
+}
+
+// dst[i] = src[i] widened from the half precision p
+template <typename T>
+void widen(mnn::Precision p, const std::uint16_t *src, std::size_t size,
+           T *dst) {
+  if (p == mnn::Precision::BF16) {
+    MNN_VECTORIZE_CALL(widen_bf16, widen_bf16, src, size, dst);
   } else {
-    if (dst_aligned) {
-      detail::reduce<MNN_VECTORIZE_TYPE, std::false_type, std::true_type>(
-        src, size, dst);
-    } else {
-      detail::reduce<MNN_VECTORIZE_TYPE, std::false_type, std::false_type>(
-        src, size, dst);
-    }
+    MNN_VECTORIZE_CALL(widen_fp16, widen_fp16, src, size, dst);
+  }
+}
+
+// dst[i] += c * src[i], with src in the half precision p
+template <typename T>
+void muladd(mnn::Precision p, const std::uint16_t *src, T c,
+            std::size_t size, T *dst) {
+  if (p == mnn::Precision::BF16) {
+    MNN_VECTORIZE_CALL(muladd_bf16, muladd_bf16, src, c, size, dst);
+  } else {
+    MNN_VECTORIZE_CALL(muladd_fp16, muladd_fp16, src, c, size, dst);
   }
 }
 
@@ -0,0 +1,58 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <deque>
+
+#include "mnn/infra/util.h"
+
+namespace mnn {
+
+// Scratch memory of the calling thread, kept between calls so hot kernels
+// do not allocate. A thread waiting inside a parallel region may run other
+// tasks that lease scratch too, so leases nest: each live one owns its own
+// buffer, and they are released in reverse order by construction.
+class ScratchBuffer {
+ public:
+  ScratchBuffer() : level_(depth()++) {
+    if (level_ == buffers().size()) buffers().emplace_back();
+  }
+  ~ScratchBuffer() { --depth(); }
+
+  ScratchBuffer(const ScratchBuffer &) = delete;
+  ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+
+  // at least size elements, aligned like Vector; the contents are garbage.
+  Float *reserve(size_t size) {
+    Vector &buf = buffers()[level_];
+    if (buf.size() < size) buf.resize(size);
+    return buf.empty() ? nullptr : &buf[0];
+  }
+
+  // the same for size elements of another trivial type
+  template <typename T>
+  T *reserve_as(size_t size) {
+    return reinterpret_cast<T *>(
+      reserve((size * sizeof(T) + sizeof(Float) - 1) / sizeof(Float)));
+  }
+
+ private:
+  static std::deque<Vector> &buffers() {
+    thread_local std::deque<Vector> buffers;
+    return buffers;
+  }
+  static size_t &depth() {
+    thread_local size_t depth = 0;
+    return depth;
+  }
+
+  size_t level_;
+};
+
+}  // namespace mnn
@@ -0,0 +1,111 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace mnn {
+
+// non-owning reference to a callable taking a task index; it never
+// allocates, so the callable must outlive the parallel region.
+class TaskRef {
+ public:
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+              typename std::decay<F>::type, TaskRef>::value>::type>
+  TaskRef(const F &f) : obj_(&f), call_(&invoke<F>) {}
+
+  void operator()(size_t i) const { call_(obj_, i); }
+
+ private:
+  template <typename F>
+  static void invoke(const void *obj, size_t i) {
+    (*static_cast<const F *>(obj))(i);
+  }
+
+  const void *obj_;
+  void (*call_)(const void *, size_t);
+};
+
+// thread count from MNN_NUM_THREADS, else hardware_concurrency().
+size_t requested_num_threads();
+
+// whether MNN_PIN_THREADS=1 asks to pin worker threads to cores.
+bool requested_thread_pinning();
+
+// binds the calling thread to core index % hardware_concurrency() (Linux).
+void pin_thread_to_core(size_t index);
+
+// Process-wide pool of worker threads behind the default parallel_for.
+// The workers are started once and sleep between parallel regions; the
+// calling thread always takes part in its own region.
+//
+// The pool size defaults to std::thread::hardware_concurrency() and can be
+// set with the MNN_NUM_THREADS environment variable or set_num_threads().
+// MNN_PIN_THREADS=1 or set_pinning(true) binds worker i to core i (Linux);
+// the calling threads are left alone.
+class ThreadPool {
+ public:
+  static ThreadPool &instance();
+
+  ~ThreadPool();
+
+  // threads taking part in a parallel region, the caller included.
+  size_t num_threads() const { return workers_.size() + 1; }
+
+  // restart the workers, so call them outside any parallel region;
+  // 0 threads picks requested_num_threads().
+  void set_num_threads(size_t n);
+  void set_pinning(bool pin);
+
+  // runs task(i) for every i in [0, num_tasks) and returns once all of
+  // them finished. Tasks are claimed dynamically, so uneven ones balance
+  // out. Nested calls, and calls while another thread owns the pool, run
+  // serially on the calling thread. The first exception thrown by a task
+  // is rethrown here.
+  void run(size_t num_tasks, TaskRef task);
+
+ private:
+  ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void start(size_t n, bool pin);
+  void stop();
+  void worker_loop(size_t index);
+  void drain();
+
+  std::vector<std::thread> workers_;
+  bool pin_ = false;
+
+  // serializes parallel regions started from outside the pool
+  std::mutex run_mutex_;
+
+  // current job; everything but next_ is guarded by mutex_
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  size_t generation_ = 0;
+  bool job_open_     = false;
+  bool stopping_     = false;
+  const TaskRef *task_ = nullptr;
+  size_t num_tasks_    = 0;
+  std::atomic<size_t> next_{0};
+  size_t active_ = 0;
+  std::exception_ptr error_;
+};
+
+}  // namespace mnn
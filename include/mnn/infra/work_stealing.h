@@ -0,0 +1,122 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace mnn {
+
+// non-owning reference to a callable taking a [begin, end) range.
+class RangeRef {
+ public:
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+              typename std::decay<F>::type, RangeRef>::value>::type>
+  RangeRef(const F &f) : obj_(&f), call_(&invoke<F>) {}
+
+  void operator()(size_t begin, size_t end) const { call_(obj_, begin, end); }
+
+ private:
+  template <typename F>
+  static void invoke(const void *obj, size_t begin, size_t end) {
+    (*static_cast<const F *>(obj))(begin, end);
+  }
+
+  const void *obj_;
+  void (*call_)(const void *, size_t, size_t);
+};
+
+// Work-stealing scheduler behind the MNN_USE_WORK_STEALING parallel_for.
+//
+// A range is split in halves down to the grain size. The thread running it
+// keeps the left half and pushes the right one onto its own deque, where
+// idle workers steal it from the other end. A thread waiting for its range
+// runs pending tasks meanwhile, so a parallel_for nested in another one
+// becomes more stealable work instead of more threads. Threads outside the
+// pool go through a shared injection queue, except for one at a time that
+// borrows a deque of its own.
+//
+// The thread count and pinning follow MNN_NUM_THREADS and MNN_PIN_THREADS,
+// see thread_pool.h.
+class WorkStealingScheduler {
+ public:
+  static WorkStealingScheduler &instance();
+
+  ~WorkStealingScheduler();
+
+  // threads running tasks, an outside caller included.
+  size_t num_threads() const { return workers_.size() + 1; }
+
+  // restarts the workers, so call it outside any parallel region;
+  // 0 threads picks requested_num_threads().
+  void set_num_threads(size_t n);
+
+  // runs body over [begin, end) in blocks of at most grain elements and
+  // returns once all of them finished. The first exception thrown by body
+  // is rethrown here.
+  void parallel_for(size_t begin, size_t end, size_t grain, RangeRef body);
+
+ private:
+  struct Job {
+    Job(RangeRef b, size_t g) : body(b), grain(g) {}
+
+    RangeRef body;
+    size_t grain;
+    std::atomic<size_t> done{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+  };
+
+  struct Task {
+    Job *job;
+    size_t begin;
+    size_t end;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  WorkStealingScheduler();
+  WorkStealingScheduler(const WorkStealingScheduler &) = delete;
+  WorkStealingScheduler &operator=(const WorkStealingScheduler &) = delete;
+
+  void start(size_t n, bool pin);
+  void stop();
+  void worker_loop(size_t slot);
+
+  void execute(Task task);
+  void push(const Task &task);
+  bool find_task(Task &task);
+
+  // slot 0 is borrowed by an outside caller, slot i is worker i
+  std::vector<std::unique_ptr<Queue>> queues_;
+  Queue injection_;
+  std::mutex external_mutex_;
+  std::vector<std::thread> workers_;
+  bool pin_ = false;
+
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  std::atomic<size_t> epoch_{0};
+  std::atomic<size_t> sleepers_{0};
+  bool stopping_ = false;
+};
+
+}  // namespace mnn
@@ -9,116 +9,188 @@
 #pragma once
 
 #include "mnn/infra/util.h"
+#include "mnn/core/graph/tensor.h"
 #include "mnn/core/params/conv_params.h"
+#include "mnn/kernel/cpu/qgemm.h"
+#include "mnn/kernel/cpu/winograd.h"
 
 namespace mnn {
 namespace kernels {
 
-void conv2d_op_internal(const Matrix &in_data, const Vector &W,
-        const Vector &bias, Matrix &out_data, const ConvParams &params,
-        const bool parallelize);
+// a non-null winograd filter takes over from the GEMM and direct paths;
+// the epilogue, if any, runs on the biased outputs
+void conv2d_op_internal(const Tensor<> &in_data, Span<const Float> W,
+        Span<const Float> bias, Tensor<> &out_data, const ConvParams &params,
+        const bool parallelize, const WinogradFilter *winograd = nullptr,
+        const Epilogue *epilogue = nullptr);
+
+// W as an out.depth x (in.depth * kh * kw) int8 matrix, with the pairs
+// the connection table leaves out zeroed
+void conv2d_quantize_weights(Span<const Float> W, const ConvParams &params,
+        QuantizedWeights &q, bool parallelize);
+
+// out = epilogue(conv(in, W) + bias) on every padded sample, lowered with
+// im2col to int8 GEMMs with in quantized to multiples of in_step
+void conv2d_int8_forward(const Tensor<> &in_data, const QuantizedWeights &W,
+        Span<const Float> bias, Tensor<> &out_data, const ConvParams &params,
+        Float in_step, bool parallelize, const Epilogue *epilogue = nullptr);
+
+// Dense layers with enough work are lowered with im2col to GEMMs over the
+// weights viewed as an out.depth x (in.depth * kh * kw) matrix; tiny layers
+// and sparse connection tables keep the direct loops.
+bool conv2d_use_gemm(const ConvParams &params);
+
+// unfolds a padded sample into (in.depth * kh * kw) x out.area() columns
+void conv2d_im2col(const Float *in, const ConvParams &params, Float *col);
+
+// folds columns back, accumulating into a padded sample
+void conv2d_col2im(const Float *col, const ConvParams &params, Float *in);
+
+// accumulate prev_delta and dW of one sample
+void conv2d_gemm_backward_data(Span<const Float> W, const Float *curr_delta,
+        Float *prev_delta, const ConvParams &params, bool parallelize);
+void conv2d_gemm_backward_weights(const Float *prev_out, Float *dW,
+        const Float *curr_delta, const ConvParams &params, bool parallelize);
 
 /******************************************************************/
 
-template<typename Matrix, typename Vector>
-void conv2d_op_internal(const Matrix &prev_out, const Vector &W, Matrix &dW,
-        Matrix &db, Matrix &curr_delta, Matrix &prev_delta,
-        const ConvParams &params, const bool parallelize)
+inline void conv2d_direct_backward_data(Span<const Float> W,
+        Span<const Float> curr_delta, Span<Float> prev_delta,
+        const ConvParams &params)
 {
-    typedef typename Vector::value_type Float;
-
-    for_i(parallelize, prev_out.size(), [&](size_t sample) {
     // propagate delta to previous layer
-        for (size_t inc = 0; inc < params.in.depth_; inc++) {
-            for (size_t outc = 0; outc < params.out.depth_; outc++) {
-                if (!params.tbl.is_connected(outc, inc)) continue;
+    for (size_t inc = 0; inc < params.in.depth_; inc++) {
+        for (size_t outc = 0; outc < params.out.depth_; outc++) {
+            if (!params.tbl.is_connected(outc, inc)) continue;
 
-                size_t idx = 0;
-                idx = params.in.depth_ * outc + inc;
-                idx = params.weight.get_index(0, 0, idx);
-                const Float *pw = &W[idx];
+            size_t idx = 0;
+            idx = params.in.depth_ * outc + inc;
+            idx = params.weight.get_index(0, 0, idx);
+            const Float *pw = &W[idx];
 
-                idx = params.out.get_index(0, 0, outc);
-                const Float *pdelta_src = &curr_delta[sample][idx];
+            idx = params.out.get_index(0, 0, outc);
+            const Float *pdelta_src = &curr_delta[idx];
 
-                idx = params.in_padded.get_index(0, 0, inc);
-                // Float* pdelta_dst = &(*prev_delta)[sample][idx];
-                Float *pdelta_dst = &prev_delta[sample][idx];
+            idx = params.in_padded.get_index(0, 0, inc);
+            // Float* pdelta_dst = &(*prev_delta)[idx];
+            Float *pdelta_dst = &prev_delta[idx];
 
-                for (size_t y = 0; y < params.out.height_; y++) {
-                    for (size_t x = 0; x < params.out.width_; x++) {
-                        const Float *ppw = pw;
+            for (size_t y = 0; y < params.out.height_; y++) {
+                for (size_t x = 0; x < params.out.width_; x++) {
+                    const Float *ppw = pw;
 
-                        idx = y * params.out.width_ + x;
-                        const Float ppdelta_src = pdelta_src[idx];
+                    idx = y * params.out.width_ + x;
+                    const Float ppdelta_src = pdelta_src[idx];
 
-                        Float *ppdelta_dst =
-                        pdelta_dst + y * params.h_stride * params.in_padded.width_ +
-                        x * params.w_stride;
+                    Float *ppdelta_dst =
+                    pdelta_dst + y * params.h_stride * params.in_padded.width_ +
+                    x * params.w_stride;
 
-                        for (size_t wy = 0; wy < params.weight.height_; wy++) { // NOLINT
-                            for (size_t wx = 0; wx < params.weight.width_; wx++) { // NOLINT
-                                idx = wy * params.in_padded.width_ + wx;
-                                ppdelta_dst[idx] += *ppw++ * ppdelta_src;
-                            }
+                    for (size_t wy = 0; wy < params.weight.height_; wy++) { // NOLINT
+                        for (size_t wx = 0; wx < params.weight.width_; wx++) { // NOLINT
+                            idx = wy * params.in_padded.width_ + wx;
+                            ppdelta_dst[idx] += *ppw++ * ppdelta_src;
                         }
                     }
                 }
             }
         }
+    }
+}
 
-        // accumulate dw
-        for (size_t inc = 0; inc < params.in.depth_; inc++) {
-            for (size_t outc = 0; outc < params.out.depth_; outc++) {
-                if (!params.tbl.is_connected(outc, inc)) continue;
-
-                for (size_t wy = 0; wy < params.weight.height_; wy++) {
-                    for (size_t wx = 0; wx < params.weight.width_; wx++) {
-                        Float dst {0};
-
-                        size_t idx = 0;
-                        idx = params.in_padded.get_index(wx, wy, inc);
-                        const Float *prevo = &prev_out[sample][idx];
-
-                        idx = params.out.get_index(0, 0, outc);
-                        const Float *delta = &curr_delta[sample][idx];
-
-                        if (params.w_stride > 1) {
-                            for (size_t y = 0; y < params.out.height_; y++) {
-                                size_t prevo_idx =
-                                y * params.in_padded.width_ * params.h_stride;
-                                size_t delta_idx = y * params.out.width_;
-
-                                for (size_t x = 0; x < params.out.width_; x++) {
-                                    dst += prevo[prevo_idx + x * params.w_stride] *
-                                    delta[delta_idx + x];
-                                }
-                            }
-                        } else {
-                            for (size_t y = 0; y < params.out.height_; y++) {
-                                dst += vectorize::dot(
-                                        prevo + y * params.in_padded.width_ * params.h_stride,
-                                        delta + y * params.out.width_, params.out.width_);
+inline void conv2d_direct_backward_weights(Span<const Float> prev_out,
+        Span<Float> dW, Span<const Float> curr_delta, const ConvParams &params)
+{
+    // accumulate dw
+    for (size_t inc = 0; inc < params.in.depth_; inc++) {
+        for (size_t outc = 0; outc < params.out.depth_; outc++) {
+            if (!params.tbl.is_connected(outc, inc)) continue;
+
+            for (size_t wy = 0; wy < params.weight.height_; wy++) {
+                for (size_t wx = 0; wx < params.weight.width_; wx++) {
+                    Float dst {0};
+
+                    size_t idx = 0;
+                    idx = params.in_padded.get_index(wx, wy, inc);
+                    const Float *prevo = &prev_out[idx];
+
+                    idx = params.out.get_index(0, 0, outc);
+                    const Float *delta = &curr_delta[idx];
+
+                    if (params.w_stride > 1) {
+                        for (size_t y = 0; y < params.out.height_; y++) {
+                            size_t prevo_idx =
+                            y * params.in_padded.width_ * params.h_stride;
+                            size_t delta_idx = y * params.out.width_;
+
+                            for (size_t x = 0; x < params.out.width_; x++) {
+                                dst += prevo[prevo_idx + x * params.w_stride] *
+                                delta[delta_idx + x];
                             }
                         }
-
-                        idx = params.in.depth_ * outc + inc;
-                        dW[sample][params.weight.get_index(wx, wy, idx)] += dst;
+                    } else {
+                        for (size_t y = 0; y < params.out.height_; y++) {
+                            dst += vectorize::dot(
+                                    prevo + y * params.in_padded.width_ * params.h_stride,
+                                    delta + y * params.out.width_, params.out.width_);
+                        }
                     }
+
+                    idx = params.in.depth_ * outc + inc;
+                    dW[params.weight.get_index(wx, wy, idx)] += dst;
                 }
             }
         }
+    }
+}
+
+inline void conv2d_op_internal(const Tensor<> &prev_out,
+        Span<const Float> W, Tensor<> &dW, Tensor<> &db, Tensor<> &curr_delta,
+        Tensor<> &prev_delta, const ConvParams &params, const bool parallelize,
+        const WinogradFilter *winograd = nullptr)
+{
+    const bool use_gemm = conv2d_use_gemm(params);
+
+    if (winograd) {
+        conv2d_winograd_backward_data(curr_delta, *winograd, prev_delta,
+                params, parallelize);
+    }
+
+    // dW and db hold one slot per share of the batch
+    const size_t sample_count = prev_out.shape(0);
+    const size_t slots = dW.shape(0);
+    for_i(parallelize, slots, [&](size_t slot) {
+        for (size_t sample = slot * sample_count / slots;
+                sample < (slot + 1) * sample_count / slots; sample++) {
+            if (winograd) {
+                // the batch went through the Winograd kernel above
+            } else if (use_gemm) {
+                conv2d_gemm_backward_data(W, &curr_delta[sample][0],
+                        &prev_delta[sample][0], params, parallelize);
+            } else {
+                conv2d_direct_backward_data(W, curr_delta[sample],
+                        prev_delta[sample], params);
+            }
 
-        // accumulate db
-        if (params.has_bias) {
-            for (size_t outc = 0; outc < params.out.depth_; outc++) {
-                size_t idx = params.out.get_index(0, 0, outc);
-                const Float *delta = &curr_delta[sample][idx];
-                const Float *deltaa = delta + params.out.width_ * params.out.height_;
-                db[sample][outc] += std::accumulate(delta, deltaa, Float {0});
+            if (use_gemm) {
+                conv2d_gemm_backward_weights(&prev_out[sample][0], &dW[slot][0],
+                        &curr_delta[sample][0], params, parallelize);
+            } else {
+                conv2d_direct_backward_weights(prev_out[sample], dW[slot],
+                        curr_delta[sample], params);
+            }
+
+            // accumulate db
+            if (params.has_bias) {
+                for (size_t outc = 0; outc < params.out.depth_; outc++) {
+                    size_t idx = params.out.get_index(0, 0, outc);
+                    const Float *delta = &curr_delta[sample][idx];
+                    const Float *deltaa = delta + params.out.width_ * params.out.height_;
+                    db[slot][outc] += std::accumulate(delta, deltaa, Float {0});
+                }
             }
         }
-    });
+    }, 1);
 }
 
 }  // namespace kernels
@@ -9,25 +9,59 @@
 #pragma once
 
 #include "mnn/infra/util.h"
+#include "mnn/core/graph/tensor.h"
+#include "mnn/core/graph/epilogue.h"
 #include "mnn/core/params/fully_params.h"
+#include "mnn/kernel/cpu/qgemm.h"
 
 namespace mnn {
 namespace kernels {
 
-void fully_connected_op_internal(const Matrix &in_data,
-                                        const Vector &W,
-                                        const Vector &bias,
-                                        Matrix &out_data,
+// W rounded to a half precision, in the same layout
+struct HalfWeights {
+    Precision precision = Precision::FLOAT;
+    std::vector<uint16_t, AlignedAllocator<uint16_t, 64>> data;
+
+    bool empty() const { return precision == Precision::FLOAT; }
+    void clear() { precision = Precision::FLOAT; }
+};
+
+void fully_connected_half_weights(Span<const Float> W, Precision precision,
+                                  HalfWeights &half);
+
+void fully_connected_op_internal(const Tensor<> &in_data,
+                                        Span<const Float> W,
+                                        Span<const Float> bias,
+                                        Tensor<> &out_data,
                                         const FullyParams &params,
-                                        const bool layer_parallelize);
+                                        const bool layer_parallelize,
+                                        const Epilogue *epilogue = nullptr);
+
+// the same in int8, in quantized to multiples of in_step
+void fully_connected_int8_forward(const Tensor<> &in_data,
+                                  const QuantizedWeights &W,
+                                  Span<const Float> bias,
+                                  Tensor<> &out_data,
+                                  const FullyParams &params,
+                                  Float in_step,
+                                  const bool layer_parallelize,
+                                  const Epilogue *epilogue = nullptr);
 
+// the same with W in half precision, summed in Float
+void fully_connected_half_forward(const Tensor<> &in_data,
+                                  const HalfWeights &W,
+                                  Span<const Float> bias,
+                                  Tensor<> &out_data,
+                                  const FullyParams &params,
+                                  const bool layer_parallelize,
+                                  const Epilogue *epilogue = nullptr);
 
-void fully_connected_op_internal(const Matrix &prev_out,
-                                        const Vector &W,
-                                        Matrix &dW,
-                                        Matrix &db,
-                                        Matrix &curr_delta,
-                                        Matrix &prev_delta,
+void fully_connected_op_internal(const Tensor<> &prev_out,
+                                        Span<const Float> W,
+                                        Tensor<> &dW,
+                                        Tensor<> &db,
+                                        Tensor<> &curr_delta,
+                                        Tensor<> &prev_delta,
                                         const FullyParams &params,
                                         const bool layer_parallelize);
 }  // namespace kernels
@@ -0,0 +1,37 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "mnn/infra/config.h"
+
+namespace mnn {
+namespace kernels {
+
+// C = alpha * op(A) * op(B) + beta * C on row-major matrices, where op(A) is
+// m x k, op(B) is k x n and op(X) is X or its transpose. A beta of zero
+// overwrites C without reading it.
+//
+// Blocked after Goto: op(B) is packed into kc x nr panels and op(A) into
+// mr x kc panels, and the register-tiled micro kernel of the active SIMD
+// tier computes one mr x nr tile of C per panel pair.
+void gemm(bool trans_a, bool trans_b, size_t m, size_t n, size_t k,
+        Float alpha, const Float *a, size_t lda, const Float *b, size_t ldb,
+        Float beta, Float *c, size_t ldc, bool parallelize = false);
+
+// the same with B stored in the half precision b_precision, widened to
+// Float as its panels are packed
+void gemm(bool trans_a, bool trans_b, size_t m, size_t n, size_t k,
+        Float alpha, const Float *a, size_t lda, const uint16_t *b,
+        Precision b_precision, size_t ldb, Float beta, Float *c, size_t ldc,
+        bool parallelize = false);
+
+}  // namespace kernels
+}  // namespace mnn
@@ -0,0 +1,29 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include "mnn/infra/util.h"
+#include "mnn/core/graph/tensor.h"
+#include "mnn/core/params/maxpool_params.h"
+
+namespace mnn {
+namespace kernels {
+
+// out = max of every pooling window, saving the input index of each max to
+// params.out2inmax, which must hold one vector per sample
+void maxpool_op_internal(const Tensor<> &in_data, Tensor<> &out_data,
+        MaxpoolParams &params, const bool layer_parallelize);
+
+// prev_delta[out2inmax[o]] += curr_delta[o]; prev_delta must be zeroed
+void maxpool_grad_op_internal(const Tensor<> &curr_delta,
+        Tensor<> &prev_delta, const MaxpoolParams &params,
+        const bool layer_parallelize);
+
+}  // namespace kernels
+}  // namespace mnn
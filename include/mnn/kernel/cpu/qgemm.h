@@ -0,0 +1,56 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mnn/infra/util.h"
+
+namespace mnn {
+namespace kernels {
+
+// A k x n weight matrix quantized to int8, symmetric per column:
+// w[p][j] ~ scale[j] * q[p][j] with q in [-127, 127]. The values are
+// packed for the int8 micro kernel of the active SIMD tier, in panels of
+// nr columns, each holding the pairs of consecutive k side by side; k is
+// padded to an even size with zeros.
+struct QuantizedWeights {
+    size_t k = 0;
+    size_t n = 0;
+    size_t nr = 0;
+    Vector scale;
+    std::vector<int8_t, AlignedAllocator<int8_t, 64>> packed;
+
+    bool empty() const { return n == 0; }
+    void clear() { k = n = 0; }
+};
+
+// quantizes op(W), where W is k x n, or n x k with trans
+void quantize_weights(bool trans, size_t k, size_t n, const Float *w,
+        size_t ldw, QuantizedWeights &q, bool parallelize = false);
+
+// q[i] = round(x[i] / step), clamped to [-127, 127]
+void quantize(const Float *x, size_t size, Float step, int16_t *q);
+
+// c = op(A) * W + bias, where op(A) is m x k, A is quantized to multiples
+// of a_step on the fly and the products are accumulated in int32. Element
+// (i, j) of c lives at c[i * ldc_row + j * ldc_col], so c may be stored
+// either way round; bias may be null.
+void qgemm(bool trans_a, size_t m, const Float *a, size_t lda, Float a_step,
+        const QuantizedWeights &w, const Float *bias, Float *c,
+        size_t ldc_row, size_t ldc_col, bool parallelize = false);
+
+// the same with A already quantized to multiples of a_step
+void qgemm(bool trans_a, size_t m, const int16_t *a, size_t lda,
+        Float a_step, const QuantizedWeights &w, const Float *bias, Float *c,
+        size_t ldc_row, size_t ldc_col, bool parallelize = false);
+
+}  // namespace kernels
+}  // namespace mnn
@@ -0,0 +1,60 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#pragma once
+
+#include "mnn/infra/util.h"
+#include "mnn/core/graph/tensor.h"
+#include "mnn/core/graph/epilogue.h"
+#include "mnn/core/params/conv_params.h"
+
+namespace mnn {
+namespace kernels {
+
+// 3x3 filters transformed for Winograd's minimal filtering F(m x m, 3 x 3),
+// stored as alpha^2 = (m + 2)^2 matrices of in x out channels, one per
+// point of the transformed tile. Pairs the connection table leaves out are
+// zero, so sparse tables need no special casing.
+struct WinogradFilter {
+    size_t m = 0;
+    size_t out_channels = 0;
+    size_t in_channels = 0;
+    Vector U;
+
+    bool empty() const { return m == 0; }
+    void clear() { m = 0; }
+};
+
+// 3x3 kernels with unit strides and no dilation, on layers wide enough to
+// pay for the transforms.
+bool conv2d_use_winograd(const ConvParams &params);
+
+// F(4x4, 3x3) saves 4x the multiplies but needs larger outputs; smaller
+// ones use F(2x2, 3x3), which saves 2.25x.
+size_t winograd_tile_size(const ConvParams &params);
+
+// transforms the layer weights W (out.depth x in.depth x 3 x 3). With
+// backward_data the filters are rotated by 180 degrees and in/out swapped,
+// which turns the data gradient into a forward Winograd convolution.
+void winograd_transform_filter(Span<const Float> W, const ConvParams &params,
+        bool backward_data, WinogradFilter &filter);
+
+// out = epilogue(conv(in, W) + bias) on every padded sample
+void conv2d_winograd_forward(const Tensor<> &in_data,
+        const WinogradFilter &filter, Span<const Float> bias,
+        Tensor<> &out_data, const ConvParams &params, bool parallelize,
+        const Epilogue *epilogue = nullptr);
+
+// prev_delta += full conv(curr_delta, rot180(W)) on every sample, with a
+// filter transformed for backward_data and padded prev_deltas.
+void conv2d_winograd_backward_data(const Tensor<> &curr_delta,
+        const WinogradFilter &filter, Tensor<> &prev_delta,
+        const ConvParams &params, bool parallelize);
+
+}  // namespace kernels
+}  // namespace mnn
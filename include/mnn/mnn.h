@@ -12,6 +12,10 @@
 #include "mnn/core/layer/convolutional_layer.h"
 #include "mnn/core/layer/fully_connected_layer.h"
 #include "mnn/core/graph/network.h"
+#include "mnn/core/graph/model_format.h"
+#include "mnn/core/graph/checkpoint.h"
+#include "mnn/core/graph/quantization.h"
+#include "mnn/core/graph/batch_predictor.h"
 #include "mnn/infra/config.h"
 #include "mnn/core/graph/tensor.h"
 
@@ -21,14 +25,21 @@
 #include "mnn/core/activation/tanh_layer.h"
 
 #include "mnn/core/layer/average_pooling_layer.h"
+#include "mnn/core/layer/max_pooling_layer.h"
 #include "mnn/core/loss/mse.h"
 #include "mnn/core/loss/cross_entropy.h"
+#include "mnn/core/loss/softmax_cross_entropy.h"
 
 #include "mnn/core/optimizer/adam.h"
 #include "mnn/core/optimizer/adagrad.h"
 #include "mnn/core/optimizer/gradient_descent.h"
 
+#include "mnn/infra/cpu_features.h"
+#include "mnn/infra/exact_math.h"
+#include "mnn/infra/mapped_file.h"
 #include "mnn/infra/product.h"
 #include "mnn/infra/weight_init.h"
 #include "mnn/infra/text_progress.h"
+#include "mnn/infra/thread_pool.h"
 #include "mnn/infra/timer.h"
+#include "mnn/infra/work_stealing.h"
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "mnn/core/graph/op_kernel.h"
+#include "mnn/kernel/cpu/winograd.h"
 
 namespace mnn {
 
@@ -16,6 +17,11 @@ class Conv2dGradOp: public OpKernel {
 public:
     explicit Conv2dGradOp(const OpKernelConstruction &context);
     void compute(OpKernelContext &context) override;
+    void invalidate() override;
+
+private:
+    /* Winograd transformed weights, built on first use */
+    kernels::WinogradFilter winograd_;
 };
 
 }  // namespace mnn
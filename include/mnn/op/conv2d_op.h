@@ -9,6 +9,8 @@
 #pragma once
 
 #include "mnn/core/graph/op_kernel.h"
+#include "mnn/kernel/cpu/qgemm.h"
+#include "mnn/kernel/cpu/winograd.h"
 
 namespace mnn {
 
@@ -16,6 +18,15 @@ class Conv2dOp: public OpKernel {
 public:
     explicit Conv2dOp(const OpKernelConstruction &context);
     void compute(OpKernelContext &context) override;
+    void invalidate() override;
+    void prepare_int8(Span<const Float> W, bool parallelize) override;
+
+private:
+    /* Winograd transformed weights, built on first use */
+    kernels::WinogradFilter winograd_;
+
+    /* int8 weights, built on first int8 use */
+    kernels::QuantizedWeights quantized_;
 };
 
 }  // namespace mnn
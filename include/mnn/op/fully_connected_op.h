@@ -9,6 +9,7 @@
 #pragma once
 
 #include "mnn/core/graph/op_kernel.h"
+#include "mnn/kernel/cpu/fully_connected_op_cpu.h"
 
 namespace mnn {
 
@@ -16,6 +17,14 @@ class FullyConnectedOp: public OpKernel {
 public:
     explicit FullyConnectedOp(const OpKernelConstruction &context);
     void compute(OpKernelContext &context) override;
+    void invalidate() override;
+    void prepare_int8(Span<const Float> W, bool parallelize) override;
+
+private:
+    /* int8 weights, built on first int8 use */
+    kernels::QuantizedWeights quantized_;
+    /* half precision weights, built on first use */
+    kernels::HalfWeights half_;
 };
 
 }  // namespace mnn
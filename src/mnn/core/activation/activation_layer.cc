@@ -41,6 +41,11 @@ ActivationLayer::ActivationLayer(const Layer &prev_layer) :
 {
 }
 
+std::vector<size_t> ActivationLayer::shape_params() const
+{
+    return { in_shape_.width_, in_shape_.height_, in_shape_.depth_ };
+}
+
 std::vector<Shape3d> ActivationLayer::in_shape() const
 {
     return {in_shape_};
@@ -56,30 +61,45 @@ void ActivationLayer::set_in_shape(const Shape3d &in_shape)
     this->in_shape_ = in_shape;
 }
 
+bool ActivationLayer::needs_out_data() const
+{
+    return true;
+}
+
+Epilogue ActivationLayer::epilogue()
+{
+    if (!can_run_in_place()) {
+        return Epilogue();
+    }
+    return [this](Span<Float> y) {
+        forward_activation(y, y);
+    };
+}
+
 void ActivationLayer::forward_propagation(
-        const std::vector<Matrix*> &in_data,
-        std::vector<Matrix*> &out_data)
+        const std::vector<Tensor<>*> &in_data,
+        std::vector<Tensor<>*> &out_data)
 {
-    const Matrix &x = *in_data[0];
-    Matrix &y = *out_data[0];
+    const Tensor<> &x = *in_data[0];
+    Tensor<> &y = *out_data[0];
 
-    for_i(x.size(), [&](size_t i) {
+    for_i(x.shape(0), [&](size_t i) {
         forward_activation(x[i], y[i]);
     });
 }
 
 void ActivationLayer::back_propagation(
-        const std::vector<Matrix*> &in_data,
-        const std::vector<Matrix*> &out_data,
-        std::vector<Matrix*> &out_grad,
-        std::vector<Matrix*> &in_grad)
+        const std::vector<Tensor<>*> &in_data,
+        const std::vector<Tensor<>*> &out_data,
+        std::vector<Tensor<>*> &out_grad,
+        std::vector<Tensor<>*> &in_grad)
 {
-    Matrix &dx = *in_grad[0];
-    const Matrix &dy = *out_grad[0];
-    const Matrix &x = *in_data[0];
-    const Matrix &y = *out_data[0];
+    Tensor<> &dx = *in_grad[0];
+    const Tensor<> &dy = *out_grad[0];
+    const Tensor<> &x = *in_data[0];
+    const Tensor<> &y = *out_data[0];
 
-    for_i(x.size(), [&](size_t i) {
+    for_i(x.shape(0), [&](size_t i) {
         backward_activation(x[i], y[i], dx[i], dy[i]);
     });
 }
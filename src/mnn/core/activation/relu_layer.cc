@@ -8,17 +8,29 @@
 
 #include "mnn/core/activation/relu_layer.h"
 #include <algorithm>
+#include <memory>
 #include <string>
 #include <utility>
 
 namespace mnn {
 
+std::shared_ptr<Layer> ReluLayer::clone() const
+{
+    return replicate(*this);
+}
+
 std::string ReluLayer::layer_type() const
 {
     return "relu-activation";
 }
 
-void ReluLayer::forward_activation(const Vector &x, Vector &y)
+bool ReluLayer::can_run_in_place() const
+{
+    // the derivative is a function of y alone
+    return true;
+}
+
+void ReluLayer::forward_activation(Span<const Float> x, Span<Float> y)
 {
     for (size_t j = 0; j < x.size(); j++) {
         y[j] = std::max(Float(0), x[j]);
@@ -26,10 +38,10 @@ void ReluLayer::forward_activation(const Vector &x, Vector &y)
 }
 
 void ReluLayer::backward_activation(
-        const Vector &x,
-        const Vector &y,
-        Vector &dx,
-        const Vector &dy)
+        Span<const Float> x,
+        Span<const Float> y,
+        Span<Float> dx,
+        Span<const Float> dy)
 {
     for (size_t j = 0; j < x.size(); j++) {
         // dx = dy * (gradient of relu)
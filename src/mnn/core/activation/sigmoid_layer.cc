@@ -8,25 +8,43 @@
 
 #include "mnn/core/activation/sigmoid_layer.h"
 
+#include <memory>
 #include <string>
 #include <utility>
 
+#include "mnn/infra/exact_math.h"
+
 namespace mnn {
 
+std::shared_ptr<Layer> SigmoidLayer::clone() const
+{
+    return replicate(*this);
+}
+
 std::string SigmoidLayer::layer_type() const
 {
     return "sigmoid-activation";
 }
 
-void SigmoidLayer::forward_activation(const Vector &x, Vector &y)
+bool SigmoidLayer::can_run_in_place() const
 {
+    // the derivative is a function of y alone
+    return true;
+}
+
+void SigmoidLayer::forward_activation(Span<const Float> x, Span<Float> y)
+{
+    if (!exact_math()) {
+        vectorize::sigmoid(x.data(), x.size(), y.data());
+        return;
+    }
     for (size_t j = 0; j < x.size(); j++) {
         y[j] = Float(1) / (Float(1) + std::exp(-x[j]));
     }
 }
 
-void SigmoidLayer::backward_activation(const Vector &x, const Vector &y,
-        Vector &dx, const Vector &dy)
+void SigmoidLayer::backward_activation(Span<const Float> x, Span<const Float> y,
+        Span<Float> dx, Span<const Float> dy)
 {
     for (size_t j = 0; j < x.size(); j++) {
         // dx = dy * (gradient of sigmoid)
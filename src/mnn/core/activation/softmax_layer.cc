@@ -8,44 +8,53 @@
 
 #include "mnn/core/activation/softmax_layer.h"
 
+#include <memory>
 #include <string>
 #include <utility>
 
+#include "mnn/infra/exact_math.h"
+
 namespace mnn {
 
+std::shared_ptr<Layer> SoftmaxLayer::clone() const
+{
+    return replicate(*this);
+}
+
 std::string SoftmaxLayer::layer_type() const
 {
     return "softmax-activation";
 }
 
-void SoftmaxLayer::forward_activation(const Vector &x, Vector &y)
+void SoftmaxLayer::forward_activation(Span<const Float> x, Span<Float> y)
 {
     const Float alpha = *std::max_element(x.begin(), x.end());
     Float denominator(0);
-    for (size_t j = 0; j < x.size(); j++) {
-        y[j] = std::exp(x[j] - alpha);
-        denominator += y[j];
+    if (exact_math()) {
+        for (size_t j = 0; j < x.size(); j++) {
+            y[j] = std::exp(x[j] - alpha);
+            denominator += y[j];
+        }
+    } else {
+        for (size_t j = 0; j < x.size(); j++) {
+            y[j] = x[j] - alpha;
+        }
+        vectorize::exp(y.data(), y.size(), y.data());
+        denominator = std::accumulate(y.begin(), y.end(), Float(0));
     }
     for (size_t j = 0; j < x.size(); j++) {
         y[j] /= denominator;
     }
 }
 
-void SoftmaxLayer::backward_activation(const Vector &x, const Vector &y,
-        Vector &dx, const Vector &dy)
+void SoftmaxLayer::backward_activation(Span<const Float> x, Span<const Float> y,
+        Span<Float> dx, Span<const Float> dy)
 {
-    const size_t len = dy.size();
-
-#if HAS_CXX11_THREAD_LOCAL
-    thread_local
-#endif
-    Vector df(len, 0);
+    // dx = dy * (gradient of softmax) = dy * (diag(y) - y y^T)
+    //    = y * (dy - <dy, y>)
+    const Float dot = vectorize::dot(dy.data(), y.data(), y.size());
     for (size_t j = 0; j < x.size(); j++) {
-        for (size_t k = 0; k < x.size(); k++) {
-            df[k] = (k == j) ? y[j] * (Float(1) - y[j]) : -y[k] * y[j];
-        }
-        // dx = dy * (gradient of softmax)
-        dx[j] = vectorize::dot(&dy[0], &df[0], len);
+        dx[j] = y[j] * (dy[j] - dot);
     }
 }
 
@@ -8,25 +8,43 @@
 
 #include "mnn/core/activation/tanh_layer.h"
 
+#include <memory>
 #include <string>
 #include <utility>
 
+#include "mnn/infra/exact_math.h"
+
 namespace mnn {
 
+std::shared_ptr<Layer> TanhLayer::clone() const
+{
+    return replicate(*this);
+}
+
 std::string TanhLayer::layer_type() const
 {
     return "tanh-activation";
 }
 
-void TanhLayer::forward_activation(const Vector &x, Vector &y)
+bool TanhLayer::can_run_in_place() const
 {
+    // the derivative is a function of y alone
+    return true;
+}
+
+void TanhLayer::forward_activation(Span<const Float> x, Span<Float> y)
+{
+    if (!exact_math()) {
+        vectorize::tanh(x.data(), x.size(), y.data());
+        return;
+    }
     for (size_t j = 0; j < x.size(); j++) {
         y[j] = std::tanh(x[j]);
     }
 }
 
-void TanhLayer::backward_activation(const Vector &x, const Vector &y, Vector &dx,
-        const Vector &dy)
+void TanhLayer::backward_activation(Span<const Float> x, Span<const Float> y,
+        Span<Float> dx, Span<const Float> dy)
 {
     for (size_t j = 0; j < x.size(); j++) {
         // dx = dy * (gradient of tanh)
@@ -0,0 +1,130 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/core/graph/batch_predictor.h"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <utility>
+
+namespace mnn {
+
+BatchPredictor::BatchPredictor(const Forward &forward, size_t in_size,
+        size_t max_batch, std::chrono::microseconds max_delay) :
+        forward_(forward), in_size_(in_size),
+        max_batch_(std::max<size_t>(max_batch, 1)), max_delay_(max_delay),
+        stopping_(false), batches_(0), samples_(0)
+{
+    worker_ = std::thread([this] { run(); });
+}
+
+BatchPredictor::~BatchPredictor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_one();
+    worker_.join();
+}
+
+std::future<Vector> BatchPredictor::predict(const Vector &in)
+{
+    // checked here, so a bad sample can't fail the others of its batch
+    if (in.size() != in_size_) {
+        throw MnnError("Input of size " + std::to_string(in.size()) +
+                " to a network taking " + std::to_string(in_size_));
+    }
+
+    Request request;
+    request.in = in;
+    request.queued = Clock::now();
+    std::future<Vector> out = request.out.get_future();
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            throw MnnError("BatchPredictor is shutting down");
+        }
+        queue_.push_back(std::move(request));
+        // the worker only waits for the first sample and a full batch
+        wake = queue_.size() == 1 || queue_.size() >= max_batch_;
+    }
+    if (wake) {
+        queued_.notify_one();
+    }
+    return out;
+}
+
+size_t BatchPredictor::batch_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return batches_;
+}
+
+size_t BatchPredictor::sample_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_;
+}
+
+void BatchPredictor::run()
+{
+    std::vector<Request> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        queued_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+
+        // wait for a full batch until the oldest sample is due; when
+        // stopping, whatever is queued goes at once
+        Clock::time_point due = queue_.front().queued + max_delay_;
+        queued_.wait_until(lock, due, [this] {
+            return stopping_ || queue_.size() >= max_batch_;
+        });
+
+        size_t n = std::min(max_batch_, queue_.size());
+        for (size_t i = 0; i < n; i++) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        batches_++;
+        samples_ += n;
+
+        lock.unlock();
+        run_batch(batch);
+        batch.clear();
+        lock.lock();
+    }
+}
+
+void BatchPredictor::run_batch(std::vector<Request> &batch)
+{
+    std::vector<Matrix> in(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        in[i].push_back(std::move(batch[i].in));
+    }
+
+    std::vector<Matrix> out;
+    try {
+        out = forward_(in);
+    } catch (...) {
+        for (auto &r : batch) {
+            r.out.set_exception(std::current_exception());
+        }
+        return;
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+        batch[i].out.set_value(std::move(out[i][0]));
+    }
+}
+
+}  // namespace mnn
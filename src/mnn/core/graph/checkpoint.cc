@@ -0,0 +1,444 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/core/graph/checkpoint.h"
+#include "mnn/core/layer/layer.h"
+#include "mnn/core/optimizer/optimizer.h"
+#include "mnn/infra/mapped_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace mnn {
+
+namespace {
+
+const char checkpoint_magic[8] = { 'M', 'N', 'N', 'C', 'H', 'K', 'P', 'T' };
+const uint32_t checkpoint_version = 1;
+const uint32_t byte_order_mark = 0x01020304;
+
+// elements copied at once; small enough for an update to wait on
+const size_t block_size = 2048;
+
+const uint64_t array_alignment = 64;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t float_size;
+    uint32_t reserved;
+    uint64_t epoch;
+    uint64_t sample;
+    uint64_t weight_count;
+    uint64_t array_count;
+    uint64_t scalar_count;
+};
+
+static_assert(sizeof(CheckpointHeader) == 64, "the header takes 64 bytes");
+
+uint64_t align_up(uint64_t n)
+{
+    return (n + array_alignment - 1) / array_alignment * array_alignment;
+}
+
+// the arrays of a checkpoint: the weights of layers, then opt's state
+std::vector<Vector*> checkpoint_arrays(const std::vector<Layer*> &layers,
+        Optimizer &opt, size_t *weight_count)
+{
+    std::vector<Vector*> arrays;
+    for (auto l : layers) {
+        for (auto w : l->weights()) {
+            arrays.push_back(w);
+        }
+    }
+    *weight_count = arrays.size();
+    for (auto s : opt.state_arrays()) {
+        arrays.push_back(s);
+    }
+    return arrays;
+}
+
+// the written data of file reaches the disk
+bool sync_file(std::FILE *file)
+{
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// so does a rename in the directory of path, where that's possible
+void sync_directory_of(const std::string &path)
+{
+#ifndef _WIN32
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." :
+            slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#else
+    MNN_UNREFERENCED_PARAMETER(path);
+#endif
+}
+
+}  // namespace
+
+Checkpointer::Checkpointer(const std::string &path) :
+        path_(path), weight_count_(0), block_count_(0), all_copied_(true),
+        writing_(false), stop_(false)
+{
+}
+
+Checkpointer::~Checkpointer()
+{
+    finish_copies();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void Checkpointer::snapshot(const std::vector<Layer*> &layers,
+        Optimizer &opt, const CheckpointPosition &pos)
+{
+    finish_copies();
+
+    size_t weight_count;
+    auto arrays = checkpoint_arrays(layers, opt, &weight_count);
+    std::unique_ptr<Buffer> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_) {
+            std::exception_ptr e = error_;
+            error_ = nullptr;
+            std::rethrow_exception(e);
+        }
+        // a snapshot the writer hasn't started on is superseded by this one
+        buffer = queued_ ? std::move(queued_) : std::move(spare_);
+    }
+    bool same_layout = buffer && buffer->sizes.size() == arrays.size();
+    for (size_t r = 0; same_layout && r < arrays.size(); r++) {
+        same_layout = arrays[r]->size() == buffer->sizes[r];
+    }
+    if (!same_layout) {
+        // left uninitialized, so the pages are touched by the copies
+        buffer.reset(new Buffer);
+        for (auto a : arrays) {
+            buffer->sizes.push_back(a->size());
+            buffer->arrays.emplace_back(new Float[a->size()]);
+        }
+    }
+
+    const size_t old_block_count = block_count_;
+    regions_.clear();
+    weight_index_.clear();
+    block_count_ = 0;
+    for (size_t r = 0; r < arrays.size(); r++) {
+        regions_.push_back({arrays[r]->data(), buffer->arrays[r].get(),
+                arrays[r]->size(), block_count_});
+        block_count_ += (arrays[r]->size() + block_size - 1) / block_size;
+        if (r < weight_count) {
+            weight_index_[arrays[r]] = r;
+        }
+    }
+    if (block_count_ != old_block_count || !blocks_) {
+        blocks_.reset(new std::atomic<unsigned char>[block_count_]);
+    }
+    for (size_t b = 0; b < block_count_; b++) {
+        blocks_[b].store(pending, std::memory_order_relaxed);
+    }
+    weight_count_ = weight_count;
+
+    buffer->scalars.clear();
+    for (auto s : opt.state_scalars()) {
+        buffer->scalars.push_back(*s);
+    }
+    buffer->weight_count = weight_count;
+    buffer->pos = pos;
+    capture_ = std::move(buffer);
+    all_copied_.store(false);
+
+    if (!writer_.joinable()) {
+        writer_ = std::thread([this] { write_loop(); });
+    }
+    copier_ = std::thread([this] {
+        for (size_t r = 0; r < regions_.size(); r++) {
+            copy_blocks(r, 0, regions_[r].size);
+        }
+        all_copied_.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_ = std::move(capture_);
+        cond_.notify_all();
+    });
+}
+
+void Checkpointer::preserve(const Vector *W, size_t slot, size_t begin,
+        size_t end)
+{
+    if (all_copied_.load(std::memory_order_acquire)) {
+        return;
+    }
+    auto it = weight_index_.find(W);
+    if (it == weight_index_.end()) {
+        return;
+    }
+    copy_blocks(it->second, begin, end);
+    for (size_t r = weight_count_; r < regions_.size(); r++) {
+        copy_blocks(r, slot + begin, slot + end);
+    }
+}
+
+void Checkpointer::preserve_weight(const Vector *W)
+{
+    if (all_copied_.load(std::memory_order_acquire)) {
+        return;
+    }
+    auto it = weight_index_.find(W);
+    if (it != weight_index_.end()) {
+        copy_blocks(it->second, 0, regions_[it->second].size);
+    }
+}
+
+void Checkpointer::preserve_state()
+{
+    if (all_copied_.load(std::memory_order_acquire)) {
+        return;
+    }
+    for (size_t r = weight_count_; r < regions_.size(); r++) {
+        copy_blocks(r, 0, regions_[r].size);
+    }
+}
+
+void Checkpointer::wait()
+{
+    finish_copies();
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return !queued_ && !writing_; });
+    if (error_) {
+        std::exception_ptr e = error_;
+        error_ = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+// The steps since the snapshot copied what they updated, so this is
+// mostly what they didn't touch, copied along with the copier.
+void Checkpointer::finish_copies()
+{
+    if (!copier_.joinable()) {
+        return;
+    }
+    for (size_t r = 0; r < regions_.size(); r++) {
+        copy_blocks(r, 0, regions_[r].size);
+    }
+    copier_.join();
+}
+
+void Checkpointer::copy_blocks(size_t region, size_t begin, size_t end)
+{
+    end = std::min(end, regions_[region].size);
+    if (begin >= end) {
+        return;
+    }
+    for (size_t b = begin / block_size; b <= (end - 1) / block_size; b++) {
+        copy_block(region, b);
+    }
+}
+
+// whoever claims a block copies it; the others wait for the copy
+void Checkpointer::copy_block(size_t region, size_t block)
+{
+    const Region &r = regions_[region];
+    std::atomic<unsigned char> &state = blocks_[r.first_block + block];
+    unsigned char expected = pending;
+    if (state.compare_exchange_strong(expected, copying,
+            std::memory_order_acquire)) {
+        size_t begin = block * block_size;
+        size_t end = std::min(r.size, begin + block_size);
+        std::copy(r.src + begin, r.src + end, r.dst + begin);
+        state.store(copied, std::memory_order_release);
+        return;
+    }
+    while (state.load(std::memory_order_acquire) != copied) {
+        std::this_thread::yield();
+    }
+}
+
+void Checkpointer::write_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cond_.wait(lock, [this] { return queued_ || stop_; });
+        if (!queued_) {
+            return;
+        }
+        std::unique_ptr<Buffer> buffer = std::move(queued_);
+        writing_ = true;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            write(*buffer);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        if (error) {
+            error_ = error;
+        }
+        spare_ = std::move(buffer);
+        writing_ = false;
+        cond_.notify_all();
+    }
+}
+
+// to a temporary file first, synced, which then replaces path_
+void Checkpointer::write(const Buffer &buffer)
+{
+    std::vector<uint64_t> offsets;
+    uint64_t end = sizeof(CheckpointHeader) + 8 * buffer.sizes.size()
+            + buffer.scalars.size() * sizeof(Float);
+    for (size_t size : buffer.sizes) {
+        end = align_up(end);
+        offsets.push_back(end);
+        end += size * sizeof(Float);
+    }
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+    header.version = checkpoint_version;
+    header.byte_order = byte_order_mark;
+    header.float_size = sizeof(Float);
+    header.epoch = buffer.pos.epoch;
+    header.sample = buffer.pos.sample;
+    header.weight_count = buffer.weight_count;
+    header.array_count = buffer.sizes.size();
+    header.scalar_count = buffer.scalars.size();
+
+    const std::string tmp = path_ + ".tmp";
+    std::FILE *out = std::fopen(tmp.c_str(), "wb");
+    if (!out) {
+        throw MnnError("Can't open " + tmp);
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+    for (size_t size : buffer.sizes) {
+        uint64_t n = size;
+        ok = ok && std::fwrite(&n, sizeof(n), 1, out) == 1;
+    }
+    ok = ok && std::fwrite(buffer.scalars.data(), sizeof(Float),
+            buffer.scalars.size(), out) == buffer.scalars.size();
+    uint64_t pos = sizeof(header) + 8 * buffer.sizes.size()
+            + buffer.scalars.size() * sizeof(Float);
+    static const char zeros[array_alignment] = { 0 };
+    for (size_t r = 0; ok && r < buffer.sizes.size(); r++) {
+        size_t pad = offsets[r] - pos;
+        ok = std::fwrite(zeros, 1, pad, out) == pad
+                && std::fwrite(buffer.arrays[r].get(), sizeof(Float),
+                        buffer.sizes[r], out) == buffer.sizes[r];
+        pos = offsets[r] + buffer.sizes[r] * sizeof(Float);
+    }
+    ok = ok && std::fflush(out) == 0 && sync_file(out);
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok) {
+        throw MnnError("Can't write " + tmp);
+    }
+#ifdef _WIN32
+    std::remove(path_.c_str());
+#endif
+    if (std::rename(tmp.c_str(), path_.c_str()) != 0) {
+        throw MnnError("Can't replace " + path_);
+    }
+    sync_directory_of(path_);
+}
+
+CheckpointPosition Checkpointer::restore(const std::string &path,
+        const std::vector<Layer*> &layers, Optimizer &opt)
+{
+    MappedFile file(path);
+    CheckpointHeader header;
+    if (file.size() < sizeof(header)) {
+        throw MnnError(path + " isn't a checkpoint");
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, checkpoint_magic,
+            sizeof(checkpoint_magic)) != 0) {
+        throw MnnError(path + " isn't a checkpoint");
+    }
+    if (header.version > checkpoint_version) {
+        throw MnnError(path + " has an unsupported checkpoint version");
+    }
+    if (header.byte_order != byte_order_mark
+            || header.float_size != sizeof(Float)) {
+        throw MnnError(path + " was saved with another byte order or Float");
+    }
+
+    size_t weight_count;
+    auto arrays = checkpoint_arrays(layers, opt, &weight_count);
+    auto scalars = opt.state_scalars();
+    if (header.weight_count != weight_count
+            || header.array_count != arrays.size()
+            || header.scalar_count != scalars.size()) {
+        throw MnnError(path + " doesn't match the network or the optimizer");
+    }
+
+    uint64_t pos = sizeof(header);
+    uint64_t end = pos + 8 * arrays.size() + scalars.size() * sizeof(Float);
+    if (end > file.size()) {
+        throw MnnError(path + " is truncated");
+    }
+    for (auto a : arrays) {
+        uint64_t size;
+        std::memcpy(&size, file.data() + pos, sizeof(size));
+        pos += sizeof(size);
+        if (size != a->size()) {
+            throw MnnError(path
+                    + " doesn't match the network or the optimizer");
+        }
+        end = align_up(end) + size * sizeof(Float);
+    }
+    if (end > file.size()) {
+        throw MnnError(path + " is truncated");
+    }
+
+    for (auto s : scalars) {
+        std::memcpy(s, file.data() + pos, sizeof(Float));
+        pos += sizeof(Float);
+    }
+    for (auto a : arrays) {
+        pos = align_up(pos);
+        std::memcpy(a->data(), file.data() + pos, a->size() * sizeof(Float));
+        pos += a->size() * sizeof(Float);
+    }
+    for (auto l : layers) {
+        l->post_update();
+    }
+
+    CheckpointPosition p;
+    p.epoch = header.epoch;
+    p.sample = header.sample;
+    return p;
+}
+
+}  // namespace mnn
@@ -10,54 +10,106 @@
 
 namespace mnn {
 
+namespace {
+
+// elements of dst summed over all samples at once, small enough to stay
+// in L1 while the samples stream through
+const size_t merge_block = 2048;
+
+// below this many gradient elements one thread merges everything
+const size_t merge_parallel_min = 1 << 16;
+
+}  // namespace
+
 Edge::Edge(Node *prev, const Shape3d &shape, VectorType vtype) : shape_(shape), vtype_(
-        vtype), data_( { Vector(shape.size()) }), grad_(
-        { Vector(shape.size()) }), prev_(prev)
+        vtype), data_( { 1, shape.depth_, shape.height_, shape.width_ }), grad_(
+        { 1, shape.depth_, shape.height_, shape.width_ }), prev_(prev)
 {
 }
 
 void Edge::merge_grads(Vector *dst)
 {
-    assert(!grad_.empty());
-    const auto &grad_head = grad_[0];
-    size_t sz = grad_head.size();
+    assert(grad_.shape(0) > 0);
+    const size_t sz = grad_.sample_size();
+    const size_t sample_count = grad_.shape(0);
     dst->resize(sz);
-    Float *pdst = &(*dst)[0];
+    Float *pdst = dst->data();
+
+    // blocks of dst are independent, and each one sums the samples in
+    // order, so the result doesn't depend on the threads
+    const size_t block_count = (sz + merge_block - 1) / merge_block;
+    const bool parallelize = sz * sample_count >= merge_parallel_min;
+    for_i(parallelize, block_count, [&](size_t block) {
+        const size_t begin = block * merge_block;
+        const size_t end = std::min(sz, begin + merge_block);
+        merge_grads(begin, end, pdst + begin);
+    }, 1);
+}
+
+void Edge::merge_grads(size_t begin, size_t end, Float *dst) const
+{
+    const size_t sz = grad_.sample_size();
+    const Float *src = grad_.data();
     // dst = grad_[0]
-    std::copy(grad_head.begin(), grad_head.end(), pdst);
-    // @todo consider adding parallelism
-    for (size_t sample = 1, sample_count = grad_.size(); sample < sample_count;
-            ++sample) {
+    std::copy(src + begin, src + end, dst);
+    for (size_t sample = 1; sample < grad_.shape(0); ++sample) {
         // dst += grad_[sample]
-        vectorize::reduce < Float > (&grad_[sample][0], sz, pdst);
+        vectorize::reduce<Float>(src + sample * sz + begin, end - begin, dst);
     }
 }
 
 void Edge::clear_grads()
 {
-    for (size_t sample = 0, sample_count = grad_.size(); sample < sample_count;
-            ++sample) {
-        auto &g = grad_[sample];
-        vectorize::fill(&g[0], g.size(), Float { 0 });
+    vectorize::fill(grad_.data(), grad_.numel(), Float { 0 });
+}
+
+void Edge::bind_data(Float *data, size_t sample_count)
+{
+    data_ = Tensor<>(data,
+            { sample_count, shape_.depth_, shape_.height_, shape_.width_ });
+}
+
+void Edge::unbind_data()
+{
+    if (data_.is_borrowed()) {
+        data_ = Tensor<>( { 1, shape_.depth_, shape_.height_, shape_.width_ });
+    }
+}
+
+void Edge::bind_gradient(Float *grad, size_t sample_count)
+{
+    grad_ = Tensor<>(grad,
+            { sample_count, shape_.depth_, shape_.height_, shape_.width_ });
+}
+
+void Edge::unbind_gradient()
+{
+    if (grad_.is_borrowed()) {
+        grad_ = Tensor<>( { 1, shape_.depth_, shape_.height_, shape_.width_ });
     }
 }
 
-Matrix* Edge::get_data()
+void Edge::share_data(const Edge &other)
+{
+    data_ = other.data_.reshape(other.data_.shape());
+}
+
+Tensor<>* Edge::get_data()
 {
     return &data_;
 }
 
-const Matrix* Edge::get_data() const
+const Tensor<>* Edge::get_data() const
 {
     return &data_;
 }
 
-Matrix* Edge::get_gradient()
+Tensor<>* Edge::get_gradient()
 {
     return &grad_;
 }
 
-const Matrix* Edge::get_gradient() const
+const Tensor<>* Edge::get_gradient() const
 {
     return &grad_;
 }
@@ -0,0 +1,116 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/core/graph/memory_planner.h"
+
+#include <algorithm>
+
+namespace mnn {
+
+namespace {
+
+// keeps every buffer on a 64-byte boundary
+const size_t arena_alignment = 64 / sizeof(Float);
+
+size_t align_up(size_t n)
+{
+    return (n + arena_alignment - 1) / arena_alignment * arena_alignment;
+}
+
+}  // namespace
+
+size_t MemoryPlanner::add(size_t size, size_t first, size_t last)
+{
+    buffers_.push_back({size, first, last, buffers_.size(), 0});
+    return buffers_.size() - 1;
+}
+
+void MemoryPlanner::share(size_t a, size_t b)
+{
+    Buffer &to = buffers_[owner(a)];
+    Buffer &from = buffers_[owner(b)];
+    if (&to == &from) {
+        return;
+    }
+    to.size = std::max(to.size, from.size);
+    to.first = std::min(to.first, from.first);
+    to.last = std::max(to.last, from.last);
+    from.owner = to.owner;
+}
+
+size_t MemoryPlanner::owner(size_t id) const
+{
+    while (buffers_[id].owner != id) {
+        id = buffers_[id].owner;
+    }
+    return id;
+}
+
+size_t MemoryPlanner::plan()
+{
+    std::vector<size_t> order;
+    for (size_t i = 0; i < buffers_.size(); i++) {
+        if (owner(i) == i) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (buffers_[a].first != buffers_[b].first) {
+            return buffers_[a].first < buffers_[b].first;
+        }
+        return buffers_[a].size > buffers_[b].size;
+    });
+
+    struct Slot {
+        size_t offset;
+        size_t size;
+        size_t last;  // last step of the buffer placed here
+    };
+    std::vector<Slot> slots;
+    size_t arena = 0;
+
+    for (size_t id : order) {
+        Buffer &b = buffers_[id];
+        size_t size = align_up(b.size);
+
+        // best fit among the slots free by now
+        Slot *best = nullptr;
+        for (auto &s : slots) {
+            if (s.last < b.first && s.size >= size &&
+                    (!best || s.size < best->size)) {
+                best = &s;
+            }
+        }
+        // the slot at the end of the arena can grow in place
+        if (!best && !slots.empty() && slots.back().last < b.first) {
+            best = &slots.back();
+            arena += size - best->size;
+            best->size = size;
+        }
+        if (!best) {
+            slots.push_back({arena, size, 0});
+            arena += size;
+            best = &slots.back();
+        }
+        best->last = b.last;
+        b.offset = best->offset;
+    }
+    return arena;
+}
+
+size_t MemoryPlanner::offset(size_t id) const
+{
+    return buffers_[owner(id)].offset;
+}
+
+void MemoryPlanner::clear()
+{
+    buffers_.clear();
+}
+
+}  // namespace mnn
@@ -0,0 +1,452 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/core/graph/model_format.h"
+#include "mnn/core/graph/edge.h"
+#include "mnn/core/layer/layer.h"
+#include "mnn/core/layer/convolutional_layer.h"
+#include "mnn/core/layer/fully_connected_layer.h"
+#include "mnn/core/layer/max_pooling_layer.h"
+#include "mnn/core/layer/average_pooling_layer.h"
+#include "mnn/core/activation/relu_layer.h"
+#include "mnn/core/activation/sigmoid_layer.h"
+#include "mnn/core/activation/softmax_layer.h"
+#include "mnn/core/activation/tanh_layer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+
+namespace mnn {
+
+namespace {
+
+const char model_magic[8] = { 'M', 'N', 'N', 'M', 'O', 'D', 'E', 'L' };
+const uint32_t model_version = 1;
+const uint32_t byte_order_mark = 0x01020304;
+
+const uint32_t has_model_flag = 1;
+const uint32_t has_weights_flag = 2;
+
+const uint64_t weight_alignment = 64;
+
+// elements of any one tensor of a layer read from a file
+const size_t max_layer_elements = size_t(1) << 30;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t float_size;
+    uint32_t content;
+    uint64_t layer_count;
+    uint64_t file_size;
+    uint8_t reserved[24];
+};
+
+static_assert(sizeof(FileHeader) == 64, "the header takes 64 bytes");
+
+uint64_t align_up(uint64_t n)
+{
+    return (n + weight_alignment - 1) / weight_alignment * weight_alignment;
+}
+
+// trainable weights of layer, as the edges holding them
+std::vector<edgeptr_t> weight_edges(Layer &layer)
+{
+    std::vector<edgeptr_t> edges;
+    auto types = layer.in_types();
+    auto inputs = layer.inputs();
+    for (size_t i = 0; i < types.size(); i++) {
+        if (is_trainable_weight(types[i])) {
+            edges.push_back(inputs[i]);
+        }
+    }
+    return edges;
+}
+
+std::shared_ptr<Layer> make_layer(const std::string &type,
+        const std::vector<size_t> &p)
+{
+    auto need = [&](size_t n) {
+        if (p.size() < n) {
+            throw MnnError("Truncated " + type + " layer in the model file");
+        }
+    };
+    auto bad_shape = [&]() {
+        throw MnnError("Bad shape of a " + type + " layer in the model file");
+    };
+    // sizes, strides and dilations, which the layers divide by and whose
+    // products they allocate
+    auto sizes = [&](std::initializer_list<size_t> dims) {
+        size_t n = 1;
+        for (size_t d : dims) {
+            if (d == 0 || d > max_layer_elements / n) {
+                bad_shape();
+            }
+            n *= d;
+        }
+    };
+    // a window of size spread dilation apart inside in, for VALID padding
+    auto fits = [&](size_t in, size_t size, size_t dilation, size_t pad) {
+        if (static_cast<Padding>(pad) == Padding::VALID
+                && size - 1 > (in - 1) / dilation) {
+            bad_shape();
+        }
+    };
+    auto padding = [&](size_t v) {
+        if (v > static_cast<size_t>(Padding::SAME)) {
+            bad_shape();
+        }
+        return static_cast<Padding>(v);
+    };
+
+    if (type == "conv") {
+        need(14);
+        sizes({p[0], p[1], p[2]});
+        sizes({p[3], p[4], p[2], p[5]});
+        sizes({p[8], p[9], p[10], p[11]});
+        padding(p[6]);
+        fits(p[0], p[3], p[10], p[6]);
+        fits(p[1], p[4], p[11], p[6]);
+        ConnectionTable tbl;
+        // divided, so a wrapped product can't pass need()
+        if (p[13] != 0 && p[12] > (p.size() - 14) / p[13]) {
+            throw MnnError("Truncated " + type + " layer in the model file");
+        }
+        if (p[12] * p[13] != 0) {
+            need(14 + p[12] * p[13]);
+            std::unique_ptr<bool[]> connected(new bool[p[12] * p[13]]);
+            for (size_t i = 0; i < p[12] * p[13]; i++) {
+                connected[i] = p[14 + i] != 0;
+            }
+            tbl = ConnectionTable(connected.get(), p[12], p[13]);
+        }
+        return std::make_shared<ConvolutionalLayer>(p[0], p[1], p[3], p[4],
+                p[2], p[5], tbl, padding(p[6]), p[7] != 0, p[8], p[9], p[10],
+                p[11]);
+    }
+    if (type == "fully-connected") {
+        need(3);
+        sizes({p[0], p[1]});
+        return std::make_shared<FullyConnectedLayer>(p[0], p[1], p[2] != 0);
+    }
+    if (type == "max-pool") {
+        need(9);
+        sizes({p[0], p[1], p[2]});
+        sizes({p[3], p[4]});
+        sizes({p[5], p[6]});
+        padding(p[8]);
+        fits(p[0], p[3], 1, p[8]);
+        fits(p[1], p[4], 1, p[8]);
+        return std::make_shared<MaxPoolingLayer>(p[0], p[1], p[2], p[3], p[4],
+                p[5], p[6], p[7] != 0, padding(p[8]));
+    }
+    if (type == "ave-pool") {
+        need(9);
+        sizes({p[0], p[1], p[2]});
+        sizes({p[3], p[4]});
+        sizes({p[5], p[6]});
+        padding(p[8]);
+        fits(p[0], p[3], 1, p[8]);
+        fits(p[1], p[4], 1, p[8]);
+        return std::make_shared<AveragePoolingLayer>(p[0], p[1], p[2], p[3],
+                p[4], p[5], p[6], p[7] != 0, padding(p[8]));
+    }
+    if (type == "relu-activation") {
+        need(3);
+        sizes({p[0], p[1], p[2]});
+        return std::make_shared<ReluLayer>(p[0], p[1], p[2]);
+    }
+    if (type == "sigmoid-activation") {
+        need(3);
+        sizes({p[0], p[1], p[2]});
+        return std::make_shared<SigmoidLayer>(p[0], p[1], p[2]);
+    }
+    if (type == "softmax-activation") {
+        need(3);
+        sizes({p[0], p[1], p[2]});
+        return std::make_shared<SoftmaxLayer>(p[0], p[1], p[2]);
+    }
+    if (type == "tanh-activation") {
+        need(3);
+        sizes({p[0], p[1], p[2]});
+        return std::make_shared<TanhLayer>(p[0], p[1], p[2]);
+    }
+    throw MnnError("Unknown layer type in the model file: " + type);
+}
+
+// bounds-checked reads from the layer table
+class Reader {
+public:
+    Reader(const char *data, size_t size, size_t pos) :
+            data_(data), size_(size), pos_(pos)
+    {
+    }
+
+    uint64_t word()
+    {
+        uint64_t v;
+        bytes(&v, sizeof(v));
+        return v;
+    }
+
+    // a count of records of words words each that still fit in the table
+    uint64_t count(size_t words)
+    {
+        uint64_t n = word();
+        if (n > (size_ - pos_) / (words * sizeof(uint64_t))) {
+            throw MnnError("Truncated model file");
+        }
+        return n;
+    }
+
+    std::string text()
+    {
+        uint64_t n = word();
+        // n first, so the padding can't wrap around
+        check(n);
+        uint64_t padded = (n + 7) / 8 * 8;
+        check(padded);
+        std::string s(data_ + pos_, data_ + pos_ + n);
+        pos_ += padded;
+        return s;
+    }
+
+    void bytes(void *dst, size_t n)
+    {
+        check(n);
+        std::memcpy(dst, data_ + pos_, n);
+        pos_ += n;
+    }
+
+private:
+    void check(uint64_t n) const
+    {
+        if (n > size_ - pos_) {
+            throw MnnError("Truncated model file");
+        }
+    }
+
+    const char *data_;
+    size_t size_;
+    size_t pos_;
+};
+
+class Writer {
+public:
+    explicit Writer(std::ofstream &out) : out_(out), pos_(0)
+    {
+    }
+
+    void word(uint64_t v)
+    {
+        bytes(&v, sizeof(v));
+    }
+
+    void text(const std::string &s)
+    {
+        word(s.size());
+        bytes(s.data(), s.size());
+        pad_to((pos_ + 7) / 8 * 8);
+    }
+
+    void bytes(const void *src, size_t n)
+    {
+        out_.write(static_cast<const char*>(src), n);
+        pos_ += n;
+    }
+
+    void pad_to(uint64_t pos)
+    {
+        static const char zeros[weight_alignment] = { 0 };
+        while (pos_ < pos) {
+            bytes(zeros, std::min<uint64_t>(pos - pos_, sizeof(zeros)));
+        }
+    }
+
+    uint64_t pos() const
+    {
+        return pos_;
+    }
+
+private:
+    std::ofstream &out_;
+    uint64_t pos_;
+};
+
+}  // namespace
+
+void save_model(const std::string &path, const std::vector<Layer*> &layers,
+        ContentType what)
+{
+    const bool model = what != ContentType::weights;
+    const bool weights = what != ContentType::model;
+
+    std::vector<std::vector<size_t>> params(layers.size());
+    std::vector<std::vector<edgeptr_t>> edges(layers.size());
+    uint64_t table_size = 0;
+    for (size_t l = 0; l < layers.size(); l++) {
+        if (model) {
+            params[l] = layers[l]->shape_params();
+        }
+        if (weights) {
+            edges[l] = weight_edges(*layers[l]);
+        }
+        table_size += 8 + (layers[l]->layer_type().size() + 7) / 8 * 8;
+        table_size += 8 * (2 + params[l].size() + 2 * edges[l].size());
+    }
+
+    // the weights follow the table, each one aligned
+    std::vector<std::vector<uint64_t>> offsets(layers.size());
+    uint64_t end = sizeof(FileHeader) + table_size;
+    for (size_t l = 0; l < layers.size(); l++) {
+        for (auto &e : edges[l]) {
+            end = align_up(end);
+            offsets[l].push_back(end);
+            end += e->get_data()->numel() * sizeof(Float);
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw MnnError("Can't open " + path);
+    }
+    Writer w(out);
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, model_magic, sizeof(model_magic));
+    header.version = model_version;
+    header.byte_order = byte_order_mark;
+    header.float_size = sizeof(Float);
+    header.content = (model ? has_model_flag : 0)
+            | (weights ? has_weights_flag : 0);
+    header.layer_count = layers.size();
+    header.file_size = end;
+    w.bytes(&header, sizeof(header));
+
+    for (size_t l = 0; l < layers.size(); l++) {
+        w.text(layers[l]->layer_type());
+        w.word(params[l].size());
+        for (size_t p : params[l]) {
+            w.word(p);
+        }
+        w.word(edges[l].size());
+        for (size_t i = 0; i < edges[l].size(); i++) {
+            w.word(offsets[l][i]);
+            w.word(edges[l][i]->get_data()->numel());
+        }
+    }
+
+    for (size_t l = 0; l < layers.size(); l++) {
+        for (size_t i = 0; i < edges[l].size(); i++) {
+            const Tensor<> &W = *edges[l][i]->get_data();
+            w.pad_to(offsets[l][i]);
+            w.bytes(W.data(), W.numel() * sizeof(Float));
+        }
+    }
+    if (!out.flush()) {
+        throw MnnError("Can't write " + path);
+    }
+}
+
+ModelFile::ModelFile(const std::string &path) :
+        path_(path), file_(path), content_(0)
+{
+    FileHeader header;
+    Reader r(file_.data(), file_.size(), 0);
+    r.bytes(&header, sizeof(header));
+    if (std::memcmp(header.magic, model_magic, sizeof(model_magic)) != 0) {
+        throw MnnError(path + " isn't a model file");
+    }
+    if (header.version > model_version) {
+        throw MnnError(path + " has an unsupported model file version");
+    }
+    if (header.byte_order != byte_order_mark
+            || header.float_size != sizeof(Float)) {
+        throw MnnError(path + " was saved with another byte order or Float");
+    }
+    if (header.file_size != file_.size()) {
+        throw MnnError(path + " is truncated");
+    }
+    content_ = header.content;
+
+    for (uint64_t l = 0; l < header.layer_count; l++) {
+        LayerRecord layer;
+        layer.type = r.text();
+        layer.params.resize(r.count(1));
+        for (auto &p : layer.params) {
+            p = r.word();
+        }
+        layer.weights.resize(r.count(2));
+        for (auto &w : layer.weights) {
+            w.offset = r.word();
+            w.size = r.word();
+            if (w.offset % weight_alignment != 0 || w.offset > file_.size()
+                    || w.size > (file_.size() - w.offset) / sizeof(Float)) {
+                throw MnnError(path + " has a weight out of the file");
+            }
+        }
+        layers_.push_back(layer);
+    }
+}
+
+bool ModelFile::has_model() const
+{
+    return (content_ & has_model_flag) != 0;
+}
+
+bool ModelFile::has_weights() const
+{
+    return (content_ & has_weights_flag) != 0;
+}
+
+std::vector<std::shared_ptr<Layer>> ModelFile::make_layers() const
+{
+    if (!has_model()) {
+        throw MnnError(path_ + " has no model");
+    }
+    std::vector<std::shared_ptr<Layer>> layers;
+    for (auto &layer : layers_) {
+        layers.push_back(make_layer(layer.type, layer.params));
+    }
+    return layers;
+}
+
+void ModelFile::load_weights(const std::vector<Layer*> &layers,
+        bool in_place) const
+{
+    if (!has_weights()) {
+        throw MnnError(path_ + " has no weights");
+    }
+    if (layers.size() != layers_.size()) {
+        throw MnnError(path_ + " doesn't match the network");
+    }
+    for (size_t l = 0; l < layers.size(); l++) {
+        const LayerRecord &record = layers_[l];
+        auto edges = weight_edges(*layers[l]);
+        if (layers[l]->layer_type() != record.type
+                || edges.size() != record.weights.size()) {
+            throw MnnError(path_ + " doesn't match the network");
+        }
+        std::vector<const Float*> data;
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (edges[i]->shape().size() != record.weights[i].size) {
+                throw MnnError(path_ + " doesn't match the network");
+            }
+            data.push_back(reinterpret_cast<const Float*>(
+                    file_.data() + record.weights[i].offset));
+        }
+        layers[l]->load_weights(data, in_place);
+    }
+}
+
+}  // namespace mnn
@@ -8,6 +8,9 @@
 
 #include "mnn/core/graph/node_list.h"
 #include "mnn/core/layer/layer.h"
+#include "mnn/core/graph/edge.h"
+#include "mnn/core/graph/checkpoint.h"
+#include <algorithm>
 #include <memory>
 #include <tuple>
 #include <unordered_map>
@@ -19,10 +22,138 @@
 
 namespace mnn {
 
+namespace {
+
+// elements of one weight merged and stepped by one task
+const size_t update_chunk = 2048;
+
+// below this many weights in total one thread updates everything
+const size_t update_parallel_min = 512;
+
+}  // namespace
+
 void NodeList::update_weights(Optimizer *opt)
 {
-    for (auto l : nodes_) {
-        l->update_weight(opt);
+    update_weights(opt, std::vector<NodeList*>());
+}
+
+// All trainable weights are cut into chunks, and one parallel region
+// merges, scales and steps them, so small weights share the threads
+// with large ones instead of running serially or forking on their own.
+// The gradients of the replicas are summed in on the way.
+void NodeList::update_weights(Optimizer *opt,
+        const std::vector<NodeList*> &replicas)
+{
+    struct Param {
+        std::vector<Edge*> edges;  // this network's first, then replicas'
+        Vector *W;
+        size_t slot;
+        Float scale;
+    };
+    struct Chunk {
+        size_t param;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Param> params;
+    std::vector<Chunk> chunks;
+    size_t total = 0;
+    const bool ranged = opt->supports_ranges();
+
+    for (size_t l = 0; l < nodes_.size(); l++) {
+        if (!nodes_[l]->trainable()) {
+            continue;
+        }
+        auto types = nodes_[l]->in_types();
+        auto edges = nodes_[l]->inputs();
+        for (size_t i = 0; i < types.size(); i++) {
+            if (!is_trainable_weight(types[i])) {
+                continue;
+            }
+            Tensor<> *data = edges[i]->get_data();
+            Vector &W = data->storage();
+            Param param {{edges[i].get()}, &W, 0,
+                    Float(1) / Float(data->shape(0))};
+            for (auto r : replicas) {
+                param.edges.push_back(r->nodes_[l]->inputs()[i].get());
+            }
+            if (ranged) {
+                param.slot = opt->bind(W);
+            }
+            params.push_back(param);
+            for (size_t begin = 0; begin < W.size(); begin += update_chunk) {
+                chunks.push_back({params.size() - 1, begin,
+                        std::min(W.size(), begin + update_chunk)});
+            }
+            total += W.size();
+        }
+    }
+
+    // sums the chunk's gradient slots over all networks
+    auto merge = [&](const Chunk &chunk, Float *dW) {
+        const Param &param = params[chunk.param];
+        param.edges[0]->merge_grads(chunk.begin, chunk.end, dW);
+        alignas(64) Float other[update_chunk];
+        for (size_t e = 1; e < param.edges.size(); e++) {
+            param.edges[e]->merge_grads(chunk.begin, chunk.end, other);
+            vectorize::reduce<Float>(other, chunk.end - chunk.begin, dW);
+        }
+    };
+
+    if (ranged) {
+        for_i(total >= update_parallel_min, chunks.size(), [&](size_t c) {
+            const Chunk &chunk = chunks[c];
+            const Param &param = params[chunk.param];
+            alignas(64) Float dW[update_chunk];
+            merge(chunk, dW);
+            if (checkpointer_) {
+                checkpointer_->preserve(param.W, param.slot, chunk.begin,
+                        chunk.end);
+            }
+            opt->update_range(param.slot, dW, param.scale, *param.W,
+                    chunk.begin, chunk.end);
+        }, 1);
+        opt->end_step();
+        for (auto l : nodes_) {
+            l->clear_grads();
+            l->post_update();
+        }
+    } else {
+        // the sums go to the first slots, for the layers to update as usual
+        if (!replicas.empty()) {
+            for_i(total >= update_parallel_min, chunks.size(), [&](size_t c) {
+                const Chunk &chunk = chunks[c];
+                alignas(64) Float dW[update_chunk];
+                merge(chunk, dW);
+                Tensor<> &grad = *params[chunk.param].edges[0]->get_gradient();
+                std::copy(dW, dW + chunk.end - chunk.begin,
+                        grad[0].data() + chunk.begin);
+                for (size_t slot = 1; slot < grad.shape(0); slot++) {
+                    std::fill(grad[slot].data() + chunk.begin,
+                            grad[slot].data() + chunk.end, Float(0));
+                }
+            }, 1);
+        }
+        // the state of such optimizers is opaque, but the weights are
+        // preserved a layer at a time, while the copier copies the rest
+        if (checkpointer_) {
+            checkpointer_->preserve_state();
+        }
+        for (auto l : nodes_) {
+            if (checkpointer_ && l->trainable()) {
+                for (auto W : l->weights()) {
+                    checkpointer_->preserve_weight(W);
+                }
+            }
+            l->update_weight(opt);
+        }
+    }
+
+    for (auto r : replicas) {
+        for (auto l : r->nodes_) {
+            l->clear_grads();
+            l->post_update();
+        }
     }
 }
 
@@ -33,6 +164,11 @@ void NodeList::setup(bool reset_weight)
     }
 }
 
+void NodeList::set_checkpointer(Checkpointer *checkpointer)
+{
+    checkpointer_ = checkpointer;
+}
+
 void NodeList::clear_grads()
 {
     for (auto l : nodes_) {
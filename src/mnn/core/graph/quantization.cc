@@ -0,0 +1,41 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/core/graph/quantization.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mnn {
+
+void InputQuantizer::set_mode(Quantization mode)
+{
+    // a new calibration starts from scratch
+    if (mode == Quantization::CALIBRATING && mode_ != mode) {
+        absmax_ = 0;
+    }
+    mode_ = mode;
+}
+
+Float InputQuantizer::step(const Tensor<> &in)
+{
+    if (phase_ == NetPhase::TRAINING) {
+        return 0;
+    }
+    if (mode_ == Quantization::CALIBRATING) {
+        const Float *p = in.data();
+        for (size_t i = 0; i < in.numel(); i++) {
+            absmax_ = std::max(absmax_, std::abs(p[i]));
+        }
+        return 0;
+    }
+    // without a recorded range the layer stays in float
+    return mode_ == Quantization::INT8 ? absmax_ / 127 : Float(0);
+}
+
+}  // namespace mnn
@@ -7,40 +7,298 @@
  */
 
 #include "mnn/core/graph/sequential.h"
+#include "mnn/core/graph/edge.h"
+#include "mnn/core/graph/memory_planner.h"
+#include "mnn/core/activation/softmax_layer.h"
 
 namespace mnn {
 
 void Sequential::backward(const std::vector<Matrix> &first)
+{
+    run_backward(first, nodes_.size());
+}
+
+void Sequential::backward_from_logits(const std::vector<Matrix> &first)
+{
+    if (nodes_.empty() || !dynamic_cast<SoftmaxLayer*>(nodes_.back())) {
+        throw MnnError("The loss needs a SoftmaxLayer closing the network");
+    }
+    run_backward(first, nodes_.size() - 1);
+}
+
+// backward of the first layers, with first the gradient of their output
+void Sequential::run_backward(const std::vector<Matrix> &first,
+        size_t layers)
 {
     std::vector<std::vector<const Vector*>> reordered_grad;
     reorder_for_layerwise_processing(first, reordered_grad);
     assert(reordered_grad.size() == 1);
 
-    nodes_.back()->set_out_grads(&reordered_grad[0], 1);
+    if (planned_ && planned_phase_ != NetPhase::TRAINING) {
+        throw MnnError("Backward needs the TRAINING memory plan");
+    }
+    if (!fused_.empty()) {
+        throw MnnError("Backward needs a forward pass without fused layers");
+    }
+
+    if (layers == 0) {
+        return;
+    }
+    nodes_[layers - 1]->set_out_grads(&reordered_grad[0], 1);
 
-    for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
-        (*l)->backward();
+    for (size_t l = layers; l-- > 0;) {
+        nodes_[l]->backward();
     }
 }
 
 std::vector<Matrix> Sequential::forward(const std::vector<Matrix> &first)
 {
+    unbind();
+
     std::vector<std::vector<const Vector*>> reordered_data;
     reorder_for_layerwise_processing(first, reordered_data);
     assert(reordered_data.size() == 1);
 
-    nodes_.front()->set_in_data(&reordered_data[0], 1);
+    plan_memory(reordered_data[0].size());
 
-    for (auto l : nodes_) {
-        l->forward();
-    }
+    nodes_.front()->set_in_data(&reordered_data[0], 1);
+    fuse_layers(reordered_data[0].size());
+    run_forward();
 
-    std::vector<const Matrix*> out;
+    std::vector<const Tensor<>*> out;
     nodes_.back()->output(out);
 
     return normalize_out(out);
 }
 
+void Sequential::bind(const Float *in, Float *out, size_t batch)
+{
+    if (!in || !out || batch == 0) {
+        throw MnnError("Can't bind an empty batch");
+    }
+    // the network only reads its input
+    nodes_.front()->inputs()[0]->bind_data(const_cast<Float*>(in), batch);
+    nodes_.back()->outputs()[0]->bind_data(out, batch);
+    bound_ = true;
+    bound_samples_ = batch;
+}
+
+void Sequential::unbind()
+{
+    if (!bound_) {
+        return;
+    }
+    nodes_.front()->inputs()[0]->unbind_data();
+    nodes_.back()->outputs()[0]->unbind_data();
+    bound_ = false;
+}
+
+void Sequential::forward_bound()
+{
+    if (!bound_) {
+        throw MnnError("No buffers bound");
+    }
+    plan_memory(bound_samples_);
+    fuse_layers(bound_samples_);
+    run_forward();
+}
+
+void Sequential::run_forward()
+{
+    for (size_t l = 0; l < nodes_.size(); l++) {
+        if (fused_.empty() || !fused_[l]) {
+            nodes_[l]->forward();
+        }
+    }
+}
+
+void Sequential::set_memory_planning(bool enable)
+{
+    planning_ = enable;
+    if (!enable) {
+        release_plan();
+    }
+}
+
+void Sequential::set_fusion(bool enable)
+{
+    fusion_ = enable;
+    if (!enable) {
+        unfuse_layers();
+    }
+}
+
+void Sequential::set_phase(NetPhase phase)
+{
+    phase_ = phase;
+}
+
+size_t Sequential::planned_size() const
+{
+    return data_arena_.size() + grad_arena_.size();
+}
+
+void Sequential::plan_memory(size_t sample_count)
+{
+    if (!planning_ || (planned_ && planned_samples_ == sample_count
+            && planned_phase_ == phase_)) {
+        return;
+    }
+
+    const size_t L = nodes_.size();
+    const bool training = phase_ == NetPhase::TRAINING;
+    // layer l runs forward at step l and backward at step 2L - 1 - l
+    auto bwd = [L](size_t l) {return 2 * L - 1 - l;};
+
+    // edges[i] connects layer i - 1 to layer i
+    std::vector<edgeptr_t> edges(L + 1);
+    for (size_t l = 0; l < L; l++) {
+        edges[l] = nodes_[l]->inputs()[0];
+    }
+    edges[L] = nodes_.back()->outputs()[0];
+    auto size = [&](size_t i) {return edges[i]->shape().size() * sample_count;};
+
+    // the network's input and output data keep their own buffers, as
+    // callers read and bind them
+    MemoryPlanner data, grad;
+    std::vector<size_t> data_id(L + 1), grad_id(L + 1);
+    for (size_t i = 1; i < L; i++) {
+        size_t last = i;
+        if (training) {
+            last = nodes_[i - 1]->needs_out_data() ? bwd(i - 1) : bwd(i);
+        }
+        data_id[i] = data.add(size(i), i - 1, last);
+    }
+    for (size_t i = 0; i <= L; i++) {
+        // the output gradient is set right after the forward pass
+        size_t first = (i == L) ? L - 1 : bwd(i);
+        size_t last = (i == 0) ? first : bwd(i - 1);
+        grad_id[i] = grad.add(size(i), first, last);
+        // TESTING only ever clears them
+        if (!training) {
+            grad.share(grad_id[0], grad_id[i]);
+        }
+    }
+    for (size_t l = 0; l < L; l++) {
+        if (!nodes_[l]->can_run_in_place()) {
+            continue;
+        }
+        // the producer may need its output back in backward
+        if (l > 0 && l + 1 < L
+                && (!training || !nodes_[l - 1]->needs_out_data())) {
+            data.share(data_id[l], data_id[l + 1]);
+        }
+        if (training) {
+            grad.share(grad_id[l + 1], grad_id[l]);
+        }
+    }
+
+    release_plan();
+    data_arena_.resize(data.plan());
+    grad_arena_.resize(grad.plan());
+    for (size_t i = 1; i < L; i++) {
+        edges[i]->bind_data(data_arena_.data() + data.offset(data_id[i]),
+                sample_count);
+    }
+    for (size_t i = 0; i <= L; i++) {
+        edges[i]->bind_gradient(grad_arena_.data() + grad.offset(grad_id[i]),
+                sample_count);
+    }
+
+    planned_ = true;
+    planned_samples_ = sample_count;
+    planned_phase_ = phase_;
+}
+
+void Sequential::release_plan()
+{
+    if (!planned_) {
+        return;
+    }
+    for (size_t l = 0; l < nodes_.size(); l++) {
+        if (l > 0) {
+            nodes_[l]->inputs()[0]->unbind_data();
+        }
+        nodes_[l]->inputs()[0]->unbind_gradient();
+    }
+    nodes_.back()->outputs()[0]->unbind_gradient();
+    Vector().swap(data_arena_);
+    Vector().swap(grad_arena_);
+    planned_ = false;
+}
+
+void Sequential::fuse_layers(size_t sample_count)
+{
+    if (!fusion_ || phase_ != NetPhase::TESTING) {
+        unfuse_layers();
+        return;
+    }
+
+    if (fused_.empty()) {
+        fused_.assign(nodes_.size(), false);
+        for (size_t l = 1; l < nodes_.size(); l++) {
+            Epilogue epilogue = nodes_[l]->epilogue();
+            if (epilogue && !fused_[l - 1]
+                    && nodes_[l - 1]->set_epilogue(epilogue)) {
+                fused_[l] = true;
+            }
+        }
+    }
+
+    // the producer writes into the fused layer's output, which may be
+    // planned or bound, or else is sized here as the fused layer won't
+    for (size_t l = 1; l < nodes_.size(); l++) {
+        if (!fused_[l]) {
+            continue;
+        }
+        Tensor<> &out = *nodes_[l]->outputs()[0]->get_data();
+        if (!out.is_borrowed()) {
+            auto shape = out.shape();
+            shape[0] = sample_count;
+            out.resize(shape);
+        }
+        edgeptr_t in = nodes_[l]->inputs()[0];
+        if (in->get_data()->data() != out.data()
+                || in->get_data()->shape(0) != sample_count) {
+            in->bind_data(out.data(), sample_count);
+        }
+    }
+}
+
+void Sequential::unfuse_layers()
+{
+    if (fused_.empty()) {
+        return;
+    }
+    for (size_t l = 1; l < nodes_.size(); l++) {
+        if (fused_[l]) {
+            nodes_[l - 1]->set_epilogue(Epilogue());
+            nodes_[l]->inputs()[0]->unbind_data();
+        }
+    }
+    fused_.clear();
+    // the plan may have bound those edges
+    release_plan();
+}
+
+std::shared_ptr<Sequential> Sequential::replicate() const
+{
+    auto replica = std::make_shared<Sequential>();
+    for (auto l : nodes_) {
+        auto copy = l->clone();
+        if (!copy) {
+            return nullptr;
+        }
+        replica->own_nodes_.push_back(copy);
+        replica->nodes_.push_back(replica->own_nodes_.back().get());
+        size_t n = replica->nodes_.size();
+        if (n > 1) {
+            connect(replica->nodes_[n - 2], replica->nodes_[n - 1], 0, 0);
+        }
+    }
+    return replica;
+}
+
 void Sequential::check_connectivity()
 {
     for (size_t i = 0; i < nodes_.size() - 1; i++) {
@@ -54,15 +312,16 @@ void Sequential::check_connectivity()
 }
 
 std::vector<Matrix> Sequential::normalize_out(
-        const std::vector<const Matrix*> &out)
+        const std::vector<const Tensor<>*> &out)
 {
     std::vector < Matrix > normalized_output;
 
-    const size_t sample_count = out[0]->size();
+    const size_t sample_count = out[0]->shape(0);
     normalized_output.resize(sample_count, Matrix(1));
 
     for (size_t sample = 0; sample < sample_count; ++sample) {
-        normalized_output[sample][0] = (*out[0])[sample];
+        const auto src = (*out[0])[sample];
+        normalized_output[sample][0].assign(src.begin(), src.end());
     }
 
     return normalized_output;
@@ -8,93 +8,145 @@
 #include "mnn/core/layer/average_pooling_layer.h"
 
 #include <algorithm>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 #include "mnn/infra/util.h"
+#include "mnn/infra/scratch_buffer.h"
 
 namespace mnn {
 
-void average_pooling_kernel(bool parallelize,
-        const std::vector<Matrix*> &in_data, std::vector<Matrix*> &out_data,
-        const Shape3d &out_dim, Float scale_factor,
-        std::vector<typename PartialConnectedLayer::wi_connections> &out2wi)
-{
-    for_i(parallelize, in_data[0]->size(),
-            [&](
-                    size_t sample) {
-                        const Vector &in = (*in_data[0])[sample];
-                        const Vector &W = (*in_data[1])[0];
-                        const Vector &b = (*in_data[2])[0];
-                        Vector &out = (*out_data[0])[sample];
-
-                        auto oarea = out_dim.area();
-                        size_t idx = 0;
-                        for (size_t d = 0; d < out_dim.depth_; ++d) {
-                            Float weight = W[d] * scale_factor;
-                            Float bias = b[d];
-                            for (size_t i = 0; i < oarea; ++i, ++idx) {
-                                const auto &connections = out2wi[idx];
-                                Float value {0};
-                                for (auto connection : connections) value += in[connection.second];
-                                value *= weight;
-                                value += bias;
-                                out[idx] = value;
-                            }
-                        }
+namespace {
+
+// Windows start at (ox * stride_x, oy * stride_y) and are clipped at the
+// right and bottom edges. Each output row first sums the pool_size_y input
+// rows of its windows over the whole width, SIMD across the width, and then
+// reads the window sums off that row.
+struct PoolingGeometry {
+    Shape3d in;
+    Shape3d out;
+    size_t pool_x;
+    size_t pool_y;
+    size_t stride_x;
+    size_t stride_y;
+
+    size_t row_begin(size_t oy) const { return oy * stride_y; }
+    size_t row_end(size_t oy) const
+    {
+        return std::min(oy * stride_y + pool_y, in.height_);
+    }
+    size_t col_begin(size_t ox) const { return ox * stride_x; }
+    size_t col_end(size_t ox) const
+    {
+        return std::min(ox * stride_x + pool_x, in.width_);
+    }
 
-                        assert(out.size() == out2wi.size());
-                    });
-}
+    // rows[x] = sum of the input rows of output row oy in channel c
+    void sum_rows(const Float *in_channel, size_t oy, Float *rows) const
+    {
+        std::fill(rows, rows + in.width_, Float {0});
+        for (size_t y = row_begin(oy); y < row_end(oy); y++) {
+            vectorize::add(in_channel + y * in.width_, in.width_, rows);
+        }
+    }
+};
 
-void average_pooling_back_kernel(bool parallelize,
-        const std::vector<Matrix*> &in_data,
-        const std::vector<Matrix*> &out_data,
-        std::vector<Matrix*> &out_grad, std::vector<Matrix*> &in_grad,
-        const Shape3d &in_dim, Float scale_factor,
-        std::vector<typename PartialConnectedLayer::io_connections> &weight2io,
-        std::vector<typename PartialConnectedLayer::wo_connections> &in2wo,
-        std::vector<std::vector<size_t>> &bias2out)
+void average_pooling_kernel(bool parallelize, const Tensor<> &in_data,
+        Span<const Float> W, Span<const Float> b, Tensor<> &out_data,
+        const PoolingGeometry &g, Float scale_factor, const Epilogue &epilogue)
 {
-    MNN_UNREFERENCED_PARAMETER(out_data);
-    for_i(parallelize, in_data[0]->size(), [&](size_t sample) {
-        const Vector &prev_out = (*in_data[0])[sample];
-        const Vector &W = (*in_data[1])[0];
-        Vector &dW = (*in_grad[1])[sample];
-        Vector &db = (*in_grad[2])[sample];
-        Vector &prev_delta = (*in_grad[0])[sample];
-        Vector &curr_delta = (*out_grad[0])[sample];
-
-        auto inarea = in_dim.area();
-        size_t idx = 0;
-        for (size_t i = 0; i < in_dim.depth_; ++i) {
-            Float weight = W[i] * scale_factor;
-            for (size_t j = 0; j < inarea; ++j, ++idx) {
-                prev_delta[idx] = weight * curr_delta[in2wo[idx][0].second];
+    for_i(parallelize, in_data.shape(0), [&](size_t sample) {
+        Span<const Float> in = in_data[sample];
+        Span<Float> out = out_data[sample];
+
+        ScratchBuffer buf;
+        Float *rows = buf.reserve(g.in.width_);
+
+        for (size_t c = 0; c < g.in.depth_; c++) {
+            const Float *in_channel = &in[g.in.get_index(0, 0, c)];
+            Float weight = W[c] * scale_factor;
+            Float bias = b[c];
+
+            for (size_t oy = 0; oy < g.out.height_; oy++) {
+                g.sum_rows(in_channel, oy, rows);
+
+                Float *out_row = &out[g.out.get_index(0, oy, c)];
+                for (size_t ox = 0; ox < g.out.width_; ox++) {
+                    Float sum {0};
+                    for (size_t x = g.col_begin(ox); x < g.col_end(ox); x++) {
+                        sum += rows[x];
+                    }
+                    out_row[ox] = sum * weight + bias;
+                }
+                if (epilogue) {
+                    epilogue(Span<Float>(out_row, g.out.width_));
+                }
             }
         }
+    });
+}
 
-        for (size_t i = 0; i < weight2io.size(); ++i) {
-            const auto &connections = weight2io[i];
-            Float diff {0};
-
-            for (auto connection : connections)
-            diff += prev_out[connection.first] * curr_delta[connection.second];
-
-            dW[i] += diff * scale_factor;
-        }
+void average_pooling_back_kernel(bool parallelize, const Tensor<> &prev_out,
+        Span<const Float> W, Tensor<> &dW, Tensor<> &db, Tensor<> &prev_delta,
+        const Tensor<> &curr_delta, const PoolingGeometry &g,
+        Float scale_factor)
+{
+    // dW and db hold one slot per share of the batch
+    const size_t sample_count = prev_out.shape(0);
+    const size_t slots = dW.shape(0);
+    for_i(parallelize, slots, [&](size_t slot) {
+        Span<Float> dw = dW[slot];
+        Span<Float> dbias = db[slot];
+        ScratchBuffer buf;
+        Float *rows = buf.reserve(2 * g.in.width_);
+        Float *spread = rows + g.in.width_;
+
+        for (size_t sample = slot * sample_count / slots;
+                sample < (slot + 1) * sample_count / slots; sample++) {
+            Span<const Float> in = prev_out[sample];
+            Span<const Float> delta = curr_delta[sample];
+            Span<Float> prev = prev_delta[sample];
+
+            std::fill(prev.begin(), prev.end(), Float {0});
+
+            for (size_t c = 0; c < g.in.depth_; c++) {
+                const Float *in_channel = &in[g.in.get_index(0, 0, c)];
+                Float *prev_channel = &prev[g.in.get_index(0, 0, c)];
+                Float weight = W[c] * scale_factor;
+                Float diff {0};
+                Float bias_diff {0};
+
+                for (size_t oy = 0; oy < g.out.height_; oy++) {
+                    const Float *delta_row = &delta[g.out.get_index(0, oy, c)];
+
+                    // spread[x] = sum of the deltas of the windows covering x
+                    std::fill(spread, spread + g.in.width_, Float {0});
+                    for (size_t ox = 0; ox < g.out.width_; ox++) {
+                        for (size_t x = g.col_begin(ox); x < g.col_end(ox); x++) {
+                            spread[x] += delta_row[ox];
+                        }
+                        bias_diff += delta_row[ox];
+                    }
 
-        for (size_t i = 0; i < bias2out.size(); i++) {
-            const std::vector<size_t> &outs = bias2out[i];
-            Float diff {0};
+                    for (size_t y = g.row_begin(oy); y < g.row_end(oy); y++) {
+                        vectorize::muladd(spread, weight, g.in.width_,
+                                prev_channel + y * g.in.width_);
+                    }
 
-            for (auto o : outs) diff += curr_delta[o];
+                    g.sum_rows(in_channel, oy, rows);
+                    diff += vectorize::dot(spread, rows, g.in.width_);
+                }
 
-            db[i] += diff;
+                dw[c] += diff * scale_factor;
+                dbias[c] += bias_diff;
+            }
         }
     });
 }
 
+}  // namespace
+
 AveragePoolingLayer::AveragePoolingLayer(size_t in_width, size_t in_height,
         size_t in_channels, size_t pool_size, bool ceil_mode) : AveragePoolingLayer(
         in_width, in_height, in_channels, pool_size,
@@ -120,10 +172,10 @@ AveragePoolingLayer::AveragePoolingLayer(size_t in_width, size_t in_height,
 AveragePoolingLayer::AveragePoolingLayer(size_t in_width, size_t in_height,
         size_t in_channels, size_t pool_size_x, size_t pool_size_y,
         size_t stride_x, size_t stride_y, bool ceil_mode, Padding pad_type)
+    // the dense kernels below need no connection tables
     : Base(
-              in_width * in_height * in_channels,
-              pool_out_length(in_width, pool_size_x, stride_x, ceil_mode, pad_type) *
-              pool_out_length(in_height, pool_size_y, stride_y, ceil_mode,pad_type) * in_channels,
+              0,
+              0,
               in_channels,
               in_channels,
               Float(1) / (pool_size_x * pool_size_y)
@@ -133,6 +185,8 @@ AveragePoolingLayer::AveragePoolingLayer(size_t in_width, size_t in_height,
         stride_y_(stride_y),
         pool_size_x_(pool_size_x),
         pool_size_y_(pool_size_y),
+        ceil_mode_(ceil_mode),
+        pad_type_(pad_type),
         in_(in_width, in_height, in_channels),
 
         out_(
@@ -146,8 +200,28 @@ AveragePoolingLayer::AveragePoolingLayer(size_t in_width, size_t in_height,
     if ((in_width % pool_size_x) || (in_height % pool_size_y)) {
         pooling_size_mismatch(in_width, in_height, pool_size_x, pool_size_y);
     }
+}
+
+std::shared_ptr<Layer> AveragePoolingLayer::clone() const
+{
+    return replicate(*this);
+}
+
+std::vector<size_t> AveragePoolingLayer::shape_params() const
+{
+    return { in_.width_, in_.height_, in_.depth_, pool_size_x_, pool_size_y_,
+            stride_x_, stride_y_, ceil_mode_, static_cast<size_t>(pad_type_) };
+}
 
-    init_connection(pool_size_x, pool_size_y);
+size_t AveragePoolingLayer::fan_in_size() const
+{
+    return pool_size_x_ * pool_size_y_;
+}
+
+size_t AveragePoolingLayer::fan_out_size() const
+{
+    return ((pool_size_x_ + stride_x_ - 1) / stride_x_)
+            * ((pool_size_y_ + stride_y_ - 1) / stride_y_);
 }
 
 std::vector<Index3d<size_t>> AveragePoolingLayer::in_shape() const
@@ -168,21 +242,33 @@ std::string AveragePoolingLayer::layer_type() const
 }
 
 void AveragePoolingLayer::forward_propagation(
-        const std::vector<Matrix*> &in_data, std::vector<Matrix*> &out_data)
+        const std::vector<Tensor<>*> &in_data, std::vector<Tensor<>*> &out_data)
 {
-    average_pooling_kernel(parallelize_, in_data, out_data, out_,
-            Base::scale_factor_, Base::out2wi_);
+    PoolingGeometry g {in_, out_, pool_size_x_, pool_size_y_, stride_x_,
+        stride_y_};
+    average_pooling_kernel(parallelize_, *in_data[0], (*in_data[1])[0],
+            (*in_data[2])[0], *out_data[0], g, Base::scale_factor_,
+            epilogue_);
 }
 
 void AveragePoolingLayer::back_propagation(
-        const std::vector<Matrix*> &in_data,
-        const std::vector<Matrix*> &out_data,
-        std::vector<Matrix*> &out_grad, std::vector<Matrix*> &in_grad)
+        const std::vector<Tensor<>*> &in_data,
+        const std::vector<Tensor<>*> &out_data,
+        std::vector<Tensor<>*> &out_grad, std::vector<Tensor<>*> &in_grad)
+
+{
+    MNN_UNREFERENCED_PARAMETER(out_data);
+    PoolingGeometry g {in_, out_, pool_size_x_, pool_size_y_, stride_x_,
+        stride_y_};
+    average_pooling_back_kernel(parallelize_, *in_data[0], (*in_data[1])[0],
+            *in_grad[1], *in_grad[2], *in_grad[0], *out_grad[0], g,
+            Base::scale_factor_);
+}
 
+bool AveragePoolingLayer::set_epilogue(const Epilogue &epilogue)
 {
-    average_pooling_back_kernel(parallelize_, in_data, out_data, out_grad,
-            in_grad, in_, Base::scale_factor_, Base::weight2io_, Base::in2wo_,
-            Base::bias2out_);
+    epilogue_ = epilogue;
+    return true;
 }
 
 std::pair<size_t, size_t> AveragePoolingLayer::pool_size() const
@@ -197,42 +283,4 @@ size_t AveragePoolingLayer::pool_out_dim(size_t in_size, size_t pooling_size,
             (static_cast<Float>(in_size) - pooling_size) / stride) + 1);
 }
 
-void AveragePoolingLayer::init_connection(size_t pooling_size_x,
-        size_t pooling_size_y)
-{
-    for (size_t c = 0; c < in_.depth_; ++c) {
-        for (size_t y = 0; y < in_.height_ - pooling_size_y + 1; y +=
-                stride_y_) {
-            for (size_t x = 0; x < in_.width_ - pooling_size_x + 1; x +=
-                    stride_x_) {
-                connect_kernel(pooling_size_x, pooling_size_y, x, y, c);
-            }
-        }
-    }
-
-    for (size_t c = 0; c < in_.depth_; ++c) {
-        for (size_t y = 0; y < out_.height_; ++y) {
-            for (size_t x = 0; x < out_.width_; ++x) {
-                this->connect_bias(c, out_.get_index(x, y, c));
-            }
-        }
-    }
-}
-
-void AveragePoolingLayer::connect_kernel(size_t pooling_size_x,
-        size_t pooling_size_y, size_t x, size_t y, size_t inc)
-{
-    size_t dymax = std::min(pooling_size_y, in_.height_ - y);
-    size_t dxmax = std::min(pooling_size_x, in_.width_ - x);
-    size_t dstx = x / stride_x_;
-    size_t dsty = y / stride_y_;
-    size_t outidx = out_.get_index(dstx, dsty, inc);
-    for (size_t dy = 0; dy < dymax; ++dy) {
-        for (size_t dx = 0; dx < dxmax; ++dx) {
-            this->connect_weight(in_.get_index(x + dx, y + dy, inc), outidx,
-                    inc);
-        }
-    }
-}
-
 }  // namespace mnn
@@ -66,15 +66,40 @@ ConvolutionalLayer::ConvolutionalLayer(size_t in_width, size_t in_height,
     Layer::set_backend_type(backend_type);
 }
 
+ConvolutionalLayer::ConvolutionalLayer(const ConvolutionalLayer &other) : Layer(
+        other), params_(other.params_), padding_op_(other.padding_op_),
+        quantizer_(other.quantizer_)
+{
+    init_backend(other.engine());
+}
+
 ConvolutionalLayer::ConvolutionalLayer(ConvolutionalLayer &&other)  // NOLINT
 : Layer(std::move(other)), params_(std::move(other.params_)), padding_op_(
-        std::move(other.padding_op_)), kernel_fwd_(
-        std::move(other.kernel_fwd_)), kernel_back_(
+        std::move(other.padding_op_)), quantizer_(other.quantizer_),
+        kernel_fwd_(std::move(other.kernel_fwd_)), kernel_back_(
         std::move(other.kernel_back_)), cws_(std::move(other.cws_))
 {
     init_backend(std::move(other.engine()));
 }
 
+std::shared_ptr<Layer> ConvolutionalLayer::clone() const
+{
+    return replicate(*this);
+}
+
+// the connection table follows the scalars, as rows, cols and entries
+std::vector<size_t> ConvolutionalLayer::shape_params() const
+{
+    const ConnectionTable &tbl = params_.tbl;
+    std::vector<size_t> p { params_.in.width_, params_.in.height_,
+            params_.in.depth_, params_.weight.width_, params_.weight.height_,
+            params_.out.depth_, static_cast<size_t>(params_.pad_type),
+            params_.has_bias, params_.w_stride, params_.h_stride,
+            params_.w_dilation, params_.h_dilation, tbl.rows_, tbl.cols_ };
+    p.insert(p.end(), tbl.connected_.begin(), tbl.connected_.end());
+    return p;
+}
+
 size_t ConvolutionalLayer::fan_in_size() const
 {
     return params_.weight.width_ * params_.weight.height_ * params_.in.depth_;
@@ -87,7 +112,7 @@ size_t ConvolutionalLayer::fan_out_size() const
 }
 
 void ConvolutionalLayer::forward_propagation(
-        const std::vector<Matrix*> &in_data, std::vector<Matrix*> &out_data)
+        const std::vector<Tensor<>*> &in_data, std::vector<Tensor<>*> &out_data)
 {
     padding_op_.copy_and_pad_input(*in_data[0], cws_.prev_out_padded_);
 
@@ -98,15 +123,17 @@ void ConvolutionalLayer::forward_propagation(
     fwd_ctx_.set_in_out(fwd_in_data_, out_data);
     fwd_ctx_.setParallelize(Layer::parallelize());
     fwd_ctx_.setEngine(Layer::engine());
+    fwd_ctx_.setEpilogue(epilogue_ ? &epilogue_ : nullptr);
+    fwd_ctx_.setInputStep(quantizer_.step(*in_data[0]));
 
     // launch convolutional kernel
     kernel_fwd_->compute(fwd_ctx_);
 }
 
 void ConvolutionalLayer::back_propagation(
-        const std::vector<Matrix*> &in_data,
-        const std::vector<Matrix*> &out_data,
-        std::vector<Matrix*> &out_grad, std::vector<Matrix*> &in_grad)
+        const std::vector<Tensor<>*> &in_data,
+        const std::vector<Tensor<>*> &out_data,
+        std::vector<Tensor<>*> &out_grad, std::vector<Tensor<>*> &in_grad)
 {
     bwd_in_data_.resize(in_data.size());
     std::copy(in_data.begin(), in_data.end(), bwd_in_data_.begin());
@@ -130,11 +157,54 @@ void ConvolutionalLayer::back_propagation(
     padding_op_.copy_and_unpad_delta(cws_.prev_delta_padded_, *in_grad[0]);
 }
 
+void ConvolutionalLayer::post_update()
+{
+    kernel_fwd_->invalidate();
+    kernel_back_->invalidate();
+}
+
+bool ConvolutionalLayer::set_epilogue(const Epilogue &epilogue)
+{
+    epilogue_ = epilogue;
+    return true;
+}
+
+void ConvolutionalLayer::set_context(NetPhase phase)
+{
+    quantizer_.set_phase(phase);
+}
+
+bool ConvolutionalLayer::set_quantization(Quantization mode)
+{
+    if (float_released() && mode != Quantization::INT8) {
+        throw MnnError("The float weights of " + layer_type() +
+                " were released");
+    }
+    quantizer_.set_mode(mode);
+    return true;
+}
+
+bool ConvolutionalLayer::release_float_weights()
+{
+    // without a recorded input range the layer runs in float
+    if (!quantizer_.calibrated()) {
+        return false;
+    }
+    const Layer &self = *this;
+    kernel_fwd_->prepare_int8(self.weights()[0], Layer::parallelize());
+    kernel_back_->invalidate();
+    release_weight(1);
+    return true;
+}
+
 void ConvolutionalLayer::set_sample_count(size_t sample_count)
 {
     Layer::set_sample_count(sample_count);
-    cws_.prev_delta_padded_.resize(sample_count,
-            Vector(params_.in_padded.size(), Float(0)));
+    if (cws_.prev_delta_padded_.rank() == 0
+            || cws_.prev_delta_padded_.shape(0) != sample_count) {
+        cws_.prev_delta_padded_.resize({sample_count, params_.in_padded.depth_,
+                params_.in_padded.height_, params_.in_padded.width_});
+    }
 }
 
 std::vector<Index3d<size_t>> ConvolutionalLayer::in_shape() const
@@ -157,7 +227,7 @@ std::string ConvolutionalLayer::layer_type() const
     return std::string("conv");
 }
 
-Matrix* ConvolutionalLayer::in_data_padded(const std::vector<Matrix*> &in)
+Tensor<>* ConvolutionalLayer::in_data_padded(const std::vector<Tensor<>*> &in)
 {
     return (params_.pad_type == Padding::VALID) ? in[0] : &cws_.prev_out_padded_;
 }
@@ -185,8 +255,8 @@ void ConvolutionalLayer::conv_set_params(const Shape3d &in, size_t w_width,
 
     // init padding buffer
     if (params_.pad_type == Padding::SAME) {
-        cws_.prev_delta_padded_.resize(1,
-                Vector(params_.in_padded.size(), Float(0)));
+        cws_.prev_delta_padded_.resize({1, params_.in_padded.depth_,
+                params_.in_padded.height_, params_.in_padded.width_});
     }
 
     // set parameters to padding operation
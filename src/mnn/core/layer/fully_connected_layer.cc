@@ -25,14 +25,32 @@ FullyConnectedLayer::FullyConnectedLayer(size_t in_dim, size_t out_dim,
     Layer::set_backend_type(backend_type);
 }
 
+FullyConnectedLayer::FullyConnectedLayer(const FullyConnectedLayer &other) : Layer(
+        other), params_(other.params_), quantizer_(other.quantizer_),
+        precision_(other.precision_), phase_(other.phase_)
+{
+    init_backend(other.engine());
+}
+
 FullyConnectedLayer::FullyConnectedLayer(FullyConnectedLayer &&other) : Layer(
-        std::move(other)), params_(std::move(other.params_)), kernel_fwd_(
-        std::move(other.kernel_fwd_)), kernel_back_(
-        std::move(other.kernel_back_))
+        std::move(other)), params_(std::move(other.params_)), quantizer_(
+        other.quantizer_), precision_(other.precision_), phase_(
+        other.phase_), kernel_fwd_(std::move(other.kernel_fwd_)),
+        kernel_back_(std::move(other.kernel_back_))
 {
     init_backend(std::move(other.engine()));
 }
 
+std::shared_ptr<Layer> FullyConnectedLayer::clone() const
+{
+    return replicate(*this);
+}
+
+std::vector<size_t> FullyConnectedLayer::shape_params() const
+{
+    return { params_.in_size_, params_.out_size_, params_.has_bias_ };
+}
+
 size_t FullyConnectedLayer::fan_in_size() const
 {
     return params_.in_size_;
@@ -42,6 +60,13 @@ size_t FullyConnectedLayer::fan_out_size() const
     return params_.out_size_;
 }
 
+size_t FullyConnectedLayer::weight_grad_slots(size_t sample_count) const
+{
+    MNN_UNREFERENCED_PARAMETER(sample_count);
+    // one GEMM accumulates the whole batch
+    return 1;
+}
+
 std::vector<Shape3d> FullyConnectedLayer::in_shape() const
 {
     if (params_.has_bias_) {
@@ -60,19 +85,24 @@ std::vector<Shape3d> FullyConnectedLayer::out_shape() const
 }
 
 void FullyConnectedLayer::forward_propagation(
-        const std::vector<Matrix*> &in_data, std::vector<Matrix*> &out_data)
+        const std::vector<Tensor<>*> &in_data, std::vector<Tensor<>*> &out_data)
 {
     fwd_ctx_.set_in_out(in_data, out_data);
     fwd_ctx_.setParallelize(Layer::parallelize());
     fwd_ctx_.setEngine(Layer::engine());
+    fwd_ctx_.setEpilogue(epilogue_ ? &epilogue_ : nullptr);
+    fwd_ctx_.setInputStep(quantizer_.step(*in_data[0]));
+    // training keeps to Float
+    fwd_ctx_.setWeightPrecision(phase_ == NetPhase::TRAINING ?
+            Precision::FLOAT : precision_);
 
     kernel_fwd_->compute(fwd_ctx_);
 }
 
 void FullyConnectedLayer::back_propagation(
-        const std::vector<Matrix*> &in_data,
-        const std::vector<Matrix*> &out_data,
-        std::vector<Matrix*> &out_grad, std::vector<Matrix*> &in_grad)
+        const std::vector<Tensor<>*> &in_data,
+        const std::vector<Tensor<>*> &out_data,
+        std::vector<Tensor<>*> &out_grad, std::vector<Tensor<>*> &in_grad)
 {
     bwd_ctx_.set_in_out(in_data, out_data, out_grad, in_grad);
     bwd_ctx_.setParallelize(Layer::parallelize());
@@ -86,6 +116,52 @@ std::string FullyConnectedLayer::layer_type() const
     return "fully-connected";
 }
 
+bool FullyConnectedLayer::set_epilogue(const Epilogue &epilogue)
+{
+    epilogue_ = epilogue;
+    return true;
+}
+
+void FullyConnectedLayer::post_update()
+{
+    kernel_fwd_->invalidate();
+}
+
+void FullyConnectedLayer::set_context(NetPhase phase)
+{
+    quantizer_.set_phase(phase);
+    phase_ = phase;
+}
+
+bool FullyConnectedLayer::set_quantization(Quantization mode)
+{
+    if (float_released() && mode != Quantization::INT8) {
+        throw MnnError("The float weights of " + layer_type() +
+                " were released");
+    }
+    quantizer_.set_mode(mode);
+    return true;
+}
+
+bool FullyConnectedLayer::release_float_weights()
+{
+    // without a recorded input range the layer runs in float
+    if (!quantizer_.calibrated()) {
+        return false;
+    }
+    const Layer &self = *this;
+    kernel_fwd_->prepare_int8(self.weights()[0], Layer::parallelize());
+    kernel_back_->invalidate();
+    release_weight(1);
+    return true;
+}
+
+bool FullyConnectedLayer::set_precision(Precision precision)
+{
+    precision_ = precision;
+    return true;
+}
+
 void FullyConnectedLayer::set_params(const size_t in_size,
         const size_t out_size, bool has_bias)
 {
@@ -49,13 +49,39 @@ edgeptr_t Layer::ith_out_node(size_t i) const
 Vector* Layer::get_weight_data(size_t i)
 {
     assert(is_trainable_weight(in_type_[i]));
-    return &(*(ith_in_node(i)->get_data()))[0];
+    Tensor<> *data = ith_in_node(i)->get_data();
+    if (data->is_borrowed()) {
+        throw MnnError("Mapped networks are read-only");
+    }
+    if (float_released_) {
+        throw MnnError("The float weights of " + layer_type() +
+                " were released");
+    }
+    return &data->storage();
 }
 
-const Vector* Layer::get_weight_data(size_t i) const
+bool Layer::float_released() const
+{
+    return float_released_;
+}
+
+void Layer::release_weight(size_t i)
 {
     assert(is_trainable_weight(in_type_[i]));
-    return &(*(const_cast<Layer*>(this)->ith_in_node(i)->get_data()))[0];
+    auto empty = [](const Tensor<> &tensor) {
+        auto shape = tensor.shape();
+        shape[0] = 0;
+        return Tensor<>(shape);
+    };
+    Tensor<> *data = ith_in_node(i)->get_data();
+    *data = empty(*data);
+    for (size_t j = 0; j < in_channels_; j++) {
+        if (is_trainable_weight(in_type_[j])) {
+            Tensor<> *grad = ith_in_node(j)->get_gradient();
+            *grad = empty(*grad);
+        }
+    }
+    float_released_ = true;
 }
 
 Layer::Layer(const std::vector<VectorType> &in_type,
@@ -125,12 +151,14 @@ std::vector<Shape3d> Layer::out_data_shape()
             });
 }
 
-std::vector<const Vector*> Layer::weights() const
+std::vector<Span<const Float>> Layer::weights() const
 {
-    std::vector<const Vector*> v;
+    std::vector<Span<const Float>> v;
     for (size_t i = 0; i < in_channels_; i++) {
         if (is_trainable_weight(in_type_[i])) {
-            v.push_back(get_weight_data(i));
+            const Tensor<> &data =
+                    *const_cast<Layer*>(this)->ith_in_node(i)->get_data();
+            v.emplace_back(data.data(), data.numel());
         }
     }
     return v;
@@ -147,9 +175,9 @@ std::vector<Vector*> Layer::weights()
     return v;
 }
 
-std::vector<Matrix*> Layer::weights_grads()
+std::vector<Tensor<>*> Layer::weights_grads()
 {
-    std::vector<Matrix*> v;
+    std::vector<Tensor<>*> v;
     for (size_t i = 0; i < in_channels_; i++) {
         if (is_trainable_weight(in_type_[i])) {
             v.push_back(ith_in_node(i)->get_gradient());
@@ -192,14 +220,17 @@ void Layer::set_out_grads(const std::vector<const Vector*> *grad, size_t cnt)
     for (size_t i = 0; i < out_channels_; i++) {
         if (out_type_[i] != VectorType::DATA)
             continue;
-        Matrix &dst_grad = *ith_out_node(i)->get_gradient();
+        Tensor<> &dst_grad = *ith_out_node(i)->get_gradient();
         assert(n < cnt);
         const auto &src_grad = grad[n++];
         size_t sz = src_grad.size();
-        dst_grad.resize(sz);
+        auto shape = dst_grad.shape();
+        shape[0] = sz;
+        dst_grad.resize(shape);
         for (size_t j = 0; j < sz; ++j) {
-            assert(dst_grad[j].size() == src_grad[j]->size());
-            dst_grad[j] = *src_grad[j];
+            assert(dst_grad.sample_size() == src_grad[j]->size());
+            std::copy(src_grad[j]->begin(), src_grad[j]->end(),
+                    dst_grad[j].begin());
         }
     }
 }
@@ -211,23 +242,26 @@ void Layer::set_in_data(const std::vector<const Vector*> *data, size_t cnt)
     for (size_t i = 0; i < in_channels_; i++) {
         if (in_type_[i] != VectorType::DATA)
             continue;
-        Matrix &dst_data = *ith_in_node(i)->get_data();
+        Tensor<> &dst_data = *ith_in_node(i)->get_data();
         size_t in_size = ith_in_node(i)->shape().size();
         assert(n < cnt);
         const auto &src_data = data[n++];
         size_t sz = src_data.size();
-        dst_data.resize(sz);
+        auto shape = dst_data.shape();
+        shape[0] = sz;
+        dst_data.resize(shape);
 
         MNN_UNREFERENCED_PARAMETER(in_size);
 
         for (size_t j = 0; j < sz; ++j) {
             assert(src_data[j]->size() == in_size); // checking if training data is consistent with layer shape
-            dst_data[j] = *src_data[j];
+            std::copy(src_data[j]->begin(), src_data[j]->end(),
+                    dst_data[j].begin());
         }
     }
 }
 
-void Layer::output(std::vector<const Matrix*> &out) const
+void Layer::output(std::vector<const Tensor<>*> &out) const
 {
     out.clear();
     for (size_t i = 0; i < out_channels_; i++) {
@@ -280,7 +314,7 @@ std::vector<Matrix> Layer::backward(const std::vector<Matrix> &out_grads)
     set_out_grads(&grads2[0], grads2.size());
     backward();
     return map_<Matrix>(inputs(),
-            [](edgeptr_t e) {return *e->get_gradient();});
+            [](edgeptr_t e) {return to_matrix(*e->get_gradient());});
 }
 
 void Layer::forward()
@@ -292,7 +326,7 @@ void Layer::forward()
         fwd_in_data_[i] = ith_in_node(i)->get_data();
     }
 
-    set_sample_count(fwd_in_data_[0]->size());
+    set_sample_count(fwd_in_data_[0]->shape(0));
 
     for (size_t i = 0; i < out_channels_; i++) {
         fwd_out_data_[i] = ith_out_node(i)->get_data();
@@ -364,6 +398,7 @@ void Layer::init_weight()
         }
     }
     initialized_ = true;
+    post_update();
 }
 
 void Layer::clear_grads()
@@ -379,20 +414,79 @@ void Layer::update_weight(Optimizer *o)
     for (size_t i = 0; i < in_type_.size(); i++) {
         if (trainable() && is_trainable_weight(in_type_[i])) {
             Vector &target = *get_weight_data(i);
-            ith_in_node(i)->merge_grads(&diff);
             Float rcp_batch_size = Float(1.0)
-                    / Float(ith_in_node(i)->get_data()->size());
-            for (size_t j = 0; j < diff.size(); ++j) {
-                diff[j] *= rcp_batch_size;
-            }
+                    / Float(ith_in_node(i)->get_data()->shape(0));
+            ith_in_node(i)->merge_grads(&diff);
             bool parallelize = (target.size() >= 512);
-            o->update(diff, target, parallelize);
+            o->update(diff, rcp_batch_size, target, parallelize);
         }
     }
     clear_grads();
     post_update();
 }
 
+// in the order update_weight() visits them
+void Layer::register_weights(Optimizer *o)
+{
+    for (size_t i = 0; i < in_type_.size(); i++) {
+        if (trainable() && is_trainable_weight(in_type_[i])) {
+            o->register_param(*get_weight_data(i));
+        }
+    }
+}
+
+std::shared_ptr<Layer> Layer::clone() const
+{
+    return nullptr;
+}
+
+std::vector<size_t> Layer::shape_params() const
+{
+    throw MnnError(layer_type() + " layers can't be saved");
+}
+
+void Layer::load_weights(const std::vector<const Float*> &data,
+        bool in_place)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < in_channels_; i++) {
+        if (!is_trainable_weight(in_type_[i])) {
+            continue;
+        }
+        if (n == data.size()) {
+            throw MnnError("Too few weights for " + layer_type());
+        }
+        edgeptr_t edge = ith_in_node(i);
+        if (in_place) {
+            edge->bind_data(const_cast<Float*>(data[n++]), 1);
+        } else {
+            edge->unbind_data();
+            Tensor<> &W = *edge->get_data();
+            std::copy(data[n], data[n] + W.numel(), W.data());
+            n++;
+        }
+    }
+    initialized_ = true;
+    post_update();
+}
+
+// drops the edges copied from src, except for views of its weights
+void Layer::share_weights(const Layer &src)
+{
+    for (size_t i = 0; i < in_channels_; i++) {
+        prev_[i].reset();
+        if (in_type_[i] != VectorType::DATA) {
+            alloc_input(i);
+            prev_[i]->share_data(
+                    *const_cast<Layer&>(src).ith_in_node(i));
+        }
+    }
+    for (auto &e : next_) {
+        e.reset();
+    }
+    set_epilogue(Epilogue());
+}
+
 bool Layer::has_same_weights(const Layer &rhs, Float eps) const
 {
     auto w1 = weights();
@@ -401,11 +495,11 @@ bool Layer::has_same_weights(const Layer &rhs, Float eps) const
         return false;
 
     for (size_t i = 0; i < w1.size(); i++) {
-        if (w1[i]->size() != w2[i]->size())
+        if (w1[i].size() != w2[i].size())
             return false;
 
-        for (size_t j = 0; j < w1[i]->size(); j++) {
-            if (std::abs(w1[i]->at(j) - w2[i]->at(j)) > eps)
+        for (size_t j = 0; j < w1[i].size(); j++) {
+            if (std::abs(w1[i][j] - w2[i][j]) > eps)
                 return false;
         }
     }
@@ -414,25 +508,52 @@ bool Layer::has_same_weights(const Layer &rhs, Float eps) const
 
 void Layer::set_sample_count(size_t sample_count)
 {
-    auto resize = [sample_count](Matrix *tensor) {
-        tensor->resize(sample_count, (*tensor)[0]);
+    auto resize = [sample_count](Tensor<> *tensor) {
+        if (tensor->shape(0) == sample_count) {
+            return;
+        }
+        auto shape = tensor->shape();
+        shape[0] = sample_count;
+        tensor->resize(shape);
+    };
+
+    const size_t slots = weight_grad_slots(sample_count);
+    auto resize_weight_grad = [slots](Tensor<> *tensor) {
+        if (tensor->shape(0) == slots) {
+            return;
+        }
+        auto shape = tensor->shape();
+        shape[0] = slots;
+        tensor->resize(shape);
     };
 
     for (size_t i = 0; i < in_channels_; i++) {
         if (!is_trainable_weight(in_type_[i])) {
             resize(ith_in_node(i)->get_data());
+            resize(ith_in_node(i)->get_gradient());
+        } else if (!float_released_) {
+            resize_weight_grad(ith_in_node(i)->get_gradient());
         }
-        resize(ith_in_node(i)->get_gradient());
     }
 
     for (size_t i = 0; i < out_channels_; i++) {
         if (!is_trainable_weight(out_type_[i])) {
             resize(ith_out_node(i)->get_data());
+            resize(ith_out_node(i)->get_gradient());
+        } else {
+            resize_weight_grad(ith_out_node(i)->get_gradient());
         }
-        resize(ith_out_node(i)->get_gradient());
     }
 }
 
+size_t Layer::weight_grad_slots(size_t sample_count) const
+{
+    if (!parallelize_) {
+        return 1;
+    }
+    return std::max(size_t(1), std::min(sample_count, parallel_workers()));
+}
+
 std::vector<VectorType> Layer::in_types() const { return in_type_; }
 std::vector<VectorType> Layer::out_types() const { return out_type_; }
 
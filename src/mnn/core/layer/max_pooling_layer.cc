@@ -0,0 +1,206 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+#include "mnn/core/layer/max_pooling_layer.h"
+#include "mnn/op/max_pooling_grad_op.h"
+#include "mnn/op/max_pooling_op.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mnn {
+
+MaxPoolingLayer::MaxPoolingLayer(size_t in_width, size_t in_height,
+        size_t in_channels, size_t pool_size, BackendType backend_type)
+    : MaxPoolingLayer(in_width, in_height, in_channels, pool_size, pool_size,
+            backend_type)
+{
+}
+
+MaxPoolingLayer::MaxPoolingLayer(const Shape3d &in_shape, size_t pool_size,
+        size_t stride, BackendType backend_type)
+    : MaxPoolingLayer(in_shape.width_, in_shape.height_, in_shape.depth_,
+            pool_size, stride, backend_type)
+{
+}
+
+MaxPoolingLayer::MaxPoolingLayer(size_t in_width, size_t in_height,
+        size_t in_channels, size_t pool_size, size_t stride,
+        BackendType backend_type)
+    : MaxPoolingLayer(in_width, in_height, in_channels, pool_size,
+            (in_height == 1 ? 1 : pool_size), stride, stride, false,
+            Padding::VALID, backend_type)
+{
+}
+
+MaxPoolingLayer::MaxPoolingLayer(size_t in_width, size_t in_height,
+        size_t in_channels, size_t pool_size_x, size_t pool_size_y,
+        size_t stride_x, size_t stride_y, bool ceil_mode, Padding pad_type,
+        BackendType backend_type)
+    : Layer({VectorType::DATA}, {VectorType::DATA})
+{
+    if (pad_type == Padding::VALID
+            && (in_width < pool_size_x || in_height < pool_size_y)) {
+        throw MnnError("Max pooling window larger than its input");
+    }
+
+    Shape3d out(
+            pool_out_length(in_width, pool_size_x, stride_x, ceil_mode,
+                    pad_type),
+            pool_out_length(in_height, pool_size_y, stride_y, ceil_mode,
+                    pad_type), in_channels);
+    if ((out.width_ - 1) * stride_x >= in_width
+            || (out.height_ - 1) * stride_y >= in_height) {
+        throw MnnError("Max pooling window outside of its input");
+    }
+
+    set_maxpool_params(Shape3d(in_width, in_height, in_channels), out,
+            pool_size_x, pool_size_y, stride_x, stride_y, ceil_mode, pad_type);
+    init_connection();
+    init_backend(backend_type);
+    Layer::set_backend_type(backend_type);
+}
+
+MaxPoolingLayer::MaxPoolingLayer(const MaxPoolingLayer &other) : Layer(
+        other), params_(other.params_)
+{
+    init_backend(other.engine());
+}
+
+MaxPoolingLayer::MaxPoolingLayer(MaxPoolingLayer &&other) : Layer(
+        std::move(other)), params_(std::move(other.params_)), kernel_fwd_(
+        std::move(other.kernel_fwd_)), kernel_back_(
+        std::move(other.kernel_back_))
+{
+    init_backend(std::move(other.engine()));
+}
+
+std::shared_ptr<Layer> MaxPoolingLayer::clone() const
+{
+    return replicate(*this);
+}
+
+std::vector<size_t> MaxPoolingLayer::shape_params() const
+{
+    return { params_.in.width_, params_.in.height_, params_.in.depth_,
+            params_.pool_size_x, params_.pool_size_y, params_.stride_x,
+            params_.stride_y, params_.ceil_mode,
+            static_cast<size_t>(params_.pad_type) };
+}
+
+std::vector<Index3d<size_t>> MaxPoolingLayer::in_shape() const
+{
+    return {params_.in};
+}
+
+std::vector<Index3d<size_t>> MaxPoolingLayer::out_shape() const
+{
+    return {params_.out};
+}
+
+std::string MaxPoolingLayer::layer_type() const
+{
+    return "max-pool";
+}
+
+void MaxPoolingLayer::set_sample_count(size_t sample_count)
+{
+    Layer::set_sample_count(sample_count);
+    if (params_.out2inmax.size() != sample_count) {
+        params_.out2inmax.resize(sample_count,
+                std::vector<size_t>(params_.out.size()));
+    }
+}
+
+void MaxPoolingLayer::forward_propagation(
+        const std::vector<Tensor<>*> &in_data, std::vector<Tensor<>*> &out_data)
+{
+    fwd_ctx_.set_in_out(in_data, out_data);
+    fwd_ctx_.setParallelize(Layer::parallelize());
+    fwd_ctx_.setEngine(Layer::engine());
+
+    kernel_fwd_->compute(fwd_ctx_);
+}
+
+void MaxPoolingLayer::back_propagation(
+        const std::vector<Tensor<>*> &in_data,
+        const std::vector<Tensor<>*> &out_data,
+        std::vector<Tensor<>*> &out_grad, std::vector<Tensor<>*> &in_grad)
+{
+    bwd_ctx_.set_in_out(in_data, out_data, out_grad, in_grad);
+    bwd_ctx_.setParallelize(Layer::parallelize());
+    bwd_ctx_.setEngine(Layer::engine());
+
+    kernel_back_->compute(bwd_ctx_);
+}
+
+std::pair<size_t, size_t> MaxPoolingLayer::pool_size() const
+{
+    return std::make_pair(params_.pool_size_x, params_.pool_size_y);
+}
+
+void MaxPoolingLayer::set_maxpool_params(const Shape3d &in,
+        const Shape3d &out, size_t pool_size_x, size_t pool_size_y,
+        size_t stride_x, size_t stride_y, bool ceil_mode, Padding pad_type)
+{
+    params_.in = in;
+    params_.out = out;
+    params_.pool_size_x = pool_size_x;
+    params_.pool_size_y = pool_size_y;
+    params_.stride_x = stride_x;
+    params_.stride_y = stride_y;
+    params_.ceil_mode = ceil_mode;
+    params_.pad_type = pad_type;
+}
+
+// windows start at (ox * stride_x, oy * stride_y) and are clipped at the
+// right and bottom edges
+void MaxPoolingLayer::init_connection()
+{
+    const Shape3d &in = params_.in;
+    const Shape3d &out = params_.out;
+
+    params_.in2out.resize(in.size());
+    params_.out2in.resize(out.size());
+
+    for (size_t c = 0; c < in.depth_; ++c) {
+        for (size_t oy = 0; oy < out.height_; ++oy) {
+            for (size_t ox = 0; ox < out.width_; ++ox) {
+                size_t x = ox * params_.stride_x;
+                size_t y = oy * params_.stride_y;
+                size_t dymax = std::min(params_.pool_size_y, in.height_ - y);
+                size_t dxmax = std::min(params_.pool_size_x, in.width_ - x);
+                size_t outidx = out.get_index(ox, oy, c);
+
+                for (size_t dy = 0; dy < dymax; ++dy) {
+                    for (size_t dx = 0; dx < dxmax; ++dx) {
+                        size_t inidx = in.get_index(x + dx, y + dy, c);
+                        params_.in2out[inidx] = outidx;
+                        params_.out2in[outidx].push_back(inidx);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void MaxPoolingLayer::init_backend(BackendType backend_type)
+{
+    OpKernelConstruction ctx = OpKernelConstruction(&params_);
+
+    if (backend_type == BackendType::CPU) {
+        kernel_fwd_.reset(new MaxPoolingOp(ctx));
+        kernel_back_.reset(new MaxPoolingGradOp(ctx));
+    } else {
+        throw MnnError("Not supported engine: " + to_string(backend_type));
+    }
+}
+
+}  // namespace mnn
@@ -59,17 +59,17 @@ void PartialConnectedLayer::connect_bias(size_t bias_index,
 }
 
 void PartialConnectedLayer::forward_propagation(
-        const std::vector<Matrix*> &in_data, std::vector<Matrix*> &out_data)
+        const std::vector<Tensor<>*> &in_data, std::vector<Tensor<>*> &out_data)
 {
-    const Matrix &in = *in_data[0];
-    const Vector &W = (*in_data[1])[0];
-    const Vector &b = (*in_data[2])[0];
-    Matrix &out = *out_data[0];
+    const Tensor<> &in = *in_data[0];
+    Span<const Float> W = (*in_data[1])[0];
+    Span<const Float> b = (*in_data[2])[0];
+    Tensor<> &out = *out_data[0];
 
     // @todo revise the parallelism strategy
-    for (size_t sample = 0, sample_count = in.size(); sample < sample_count;
+    for (size_t sample = 0, sample_count = in.shape(0); sample < sample_count;
             ++sample) {
-        Vector &out_sample = out[sample];
+        Span<Float> out_sample = out[sample];
 
         for_i(out2wi_.size(), [&](size_t i) {
             const wi_connections &connections = out2wi_[i];
@@ -88,20 +88,20 @@ void PartialConnectedLayer::forward_propagation(
 }
 
 void PartialConnectedLayer::back_propagation(
-        const std::vector<Matrix*> &in_data,
-        const std::vector<Matrix*> &out_data,
-        std::vector<Matrix*> &out_grad, std::vector<Matrix*> &in_grad)
+        const std::vector<Tensor<>*> &in_data,
+        const std::vector<Tensor<>*> &out_data,
+        std::vector<Tensor<>*> &out_grad, std::vector<Tensor<>*> &in_grad)
 {
     MNN_UNREFERENCED_PARAMETER(out_data);
-    const Matrix &prev_out = *in_data[0];
-    const Vector &W = (*in_data[1])[0];
-    Vector &dW = (*in_grad[1])[0];
-    Vector &db = (*in_grad[2])[0];
-    Matrix &prev_delta = *in_grad[0];
-    Matrix &curr_delta = *out_grad[0];
+    const Tensor<> &prev_out = *in_data[0];
+    Span<const Float> W = (*in_data[1])[0];
+    Span<Float> dW = (*in_grad[1])[0];
+    Span<Float> db = (*in_grad[2])[0];
+    Tensor<> &prev_delta = *in_grad[0];
+    Tensor<> &curr_delta = *out_grad[0];
 
     // @todo revise the parallelism strategy
-    for (size_t sample = 0, sample_count = prev_out.size();
+    for (size_t sample = 0, sample_count = prev_out.shape(0);
             sample < sample_count; ++sample) {
         for_i(in2wo_.size(),
                 [&](
@@ -0,0 +1,35 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+#include "mnn/core/loss/softmax_cross_entropy.h"
+
+namespace mnn {
+
+Float SoftmaxCrossEntropy::f(const Vector &y, const Vector &t)
+{
+    assert(y.size() == t.size());
+    Float d { 0 };
+
+    for (size_t i = 0; i < y.size(); ++i)
+        if (t[i] != Float(0))
+            d -= t[i] * std::log(y[i]);
+
+    return d;
+}
+
+Vector SoftmaxCrossEntropy::df(const Vector &y, const Vector &t)
+{
+    assert(y.size() == t.size());
+    Vector d(t.size());
+
+    for (size_t i = 0; i < y.size(); ++i)
+        d[i] = y[i] - t[i];
+
+    return d;
+}
+
+}  // namespace mnn
@@ -16,11 +16,28 @@ Adagrad::Adagrad() : alpha(Float(0.01)), eps(Float(1e-8))
 
 void Adagrad::update(const Vector &dW, Vector &W, bool parallelize)
 {
-    Vector &g = get<0>(W);
-    for_i(parallelize, W.size(), [&](size_t i) {
-        g[i] += dW[i] * dW[i];
-        W[i] -= alpha * dW[i] / (std::sqrt(g[i]) + eps);
+    update(dW, Float(1), W, parallelize);
+}
+
+void Adagrad::update(const Vector &dW, Float scale, Vector &W,
+        bool parallelize)
+{
+    size_t slot = slot_of(W);
+    for_(parallelize, 0, W.size(), [&](const BlockedRange &r) {
+        update_range(slot, &dW[r.begin()], scale, W, r.begin(), r.end());
     });
 }
 
+void Adagrad::update_range(size_t slot, const Float *dW, Float scale,
+        Vector &W, size_t begin, size_t end)
+{
+    vectorize::StepParams<Float> p {};
+    p.scale = scale;
+    p.alpha = alpha;
+    p.eps = eps;
+
+    vectorize::adagrad_step(dW, end - begin, &W[begin], &E_[0][slot + begin],
+            p);
+}
+
 }  // namespace mnn
@@ -17,18 +17,37 @@ Adam::Adam() : alpha(Float(0.001)), b1(Float(0.9)), b2(Float(0.999)), b1_t(
 
 void Adam::update(const Vector &dW, Vector &W, bool parallelize)
 {
-    Vector &mt = get<0>(W);
-    Vector &vt = get<1>(W);
+    update(dW, Float(1), W, parallelize);
+}
 
-    for_i(parallelize, W.size(), [&](size_t i) {
-        mt[i] = b1 * mt[i] + (Float(1) - b1) * dW[i];
-        vt[i] = b2 * vt[i] + (Float(1) - b2) * dW[i] * dW[i];
+void Adam::update(const Vector &dW, Float scale, Vector &W, bool parallelize)
+{
+    size_t slot = slot_of(W);
+    for_(parallelize, 0, W.size(), [&](const BlockedRange &r) {
+        update_range(slot, &dW[r.begin()], scale, W, r.begin(), r.end());
+    });
+    end_step();
+}
 
-        // L2 norm based update rule
-            W[i] -= alpha * (mt[i] / (Float(1) - b1_t)) /
-            std::sqrt((vt[i] / (Float(1) - b2_t)) + eps);
-        });
+void Adam::update_range(size_t slot, const Float *dW, Float scale, Vector &W,
+        size_t begin, size_t end)
+{
+    vectorize::StepParams<Float> p {};
+    p.scale = scale;
+    p.alpha = alpha;
+    p.eps = eps;
+    p.b1 = b1;
+    p.b2 = b2;
+    p.c1 = Float(1) / (Float(1) - b1_t);
+    p.c2 = Float(1) / (Float(1) - b2_t);
+
+    // L2 norm based update rule
+    size_t i = slot + begin;
+    vectorize::adam_step(dW, end - begin, &W[begin], &E_[0][i], &E_[1][i], p);
+}
 
+void Adam::end_step()
+{
     b1_t *= b1;
     b2_t *= b2;
 }
@@ -16,8 +16,26 @@ GradientDescent::GradientDescent() : alpha(Float(0.01)), lambda(Float(0))
 
 void GradientDescent::update(const Vector &dW, Vector &W, bool parallelize)
 {
-    for_i(parallelize, W.size(),
-            [&](size_t i) {W[i] = W[i] - alpha * (dW[i] + lambda * W[i]);});
+    update(dW, Float(1), W, parallelize);
+}
+
+void GradientDescent::update(const Vector &dW, Float scale, Vector &W,
+        bool parallelize)
+{
+    for_(parallelize, 0, W.size(), [&](const BlockedRange &r) {
+        update_range(0, &dW[r.begin()], scale, W, r.begin(), r.end());
+    });
+}
+
+void GradientDescent::update_range(size_t, const Float *dW, Float scale,
+        Vector &W, size_t begin, size_t end)
+{
+    vectorize::StepParams<Float> p {};
+    p.scale = scale;
+    p.alpha = alpha;
+    p.lambda = lambda;
+
+    vectorize::sgd_step(dW, end - begin, &W[begin], p);
 }
 
 }  // namespace mnn
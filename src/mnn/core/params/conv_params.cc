@@ -63,21 +63,22 @@ Conv2dPadding::Conv2dPadding(const ConvParams &params) : params_(params)
 {
 }
 
-void Conv2dPadding::copy_and_pad_input(const Matrix &in, Matrix &out)
+void Conv2dPadding::copy_and_pad_input(const Tensor<> &in, Tensor<> &out)
 {
     if (params_.pad_type == Padding::VALID) {
         return;
     }
 
-    Matrix buf(in.size());
-
-    for_i(true, buf.size(), [&](size_t sample) {
-        // alloc temporary buffer.
-        buf[sample].resize(params_.in_padded.size());
+    if (out.rank() == 0 || out.shape(0) != in.shape(0)) {
+        out.resize({in.shape(0), params_.in_padded.depth_,
+                params_.in_padded.height_, params_.in_padded.width_});
+    }
+    out.fill(Float(0));
 
+    for_i(true, in.shape(0), [&](size_t sample) {
         // make padded version in order to avoid corner-case in fprop/bprop
         for (size_t c = 0; c < params_.in.depth_; c++) {
-            Float *pimg = &buf[sample][params_.in_padded.get_index(
+            Float *pimg = &out[sample][params_.in_padded.get_index(
                     params_.weight.width_ / 2, params_.weight.height_ / 2, c)];
             const Float *pin = &in[sample][params_.in.get_index(0, 0, c)];
 
@@ -88,27 +89,20 @@ void Conv2dPadding::copy_and_pad_input(const Matrix &in, Matrix &out)
             }
         }
     });
-
-    out = buf;
 }
 
-void Conv2dPadding::copy_and_unpad_delta(const Matrix &delta,
-        Matrix &delta_unpadded)
+void Conv2dPadding::copy_and_unpad_delta(const Tensor<> &delta,
+        Tensor<> &delta_unpadded)
 {
     if (params_.pad_type == Padding::VALID) {
         return;
     }
 
-    Matrix buf(delta.size());
-
-    for_i(true, buf.size(), [&](size_t sample) {
-        // alloc temporary buffer.
-        buf[sample].resize(params_.in.size());
-
+    for_i(true, delta.shape(0), [&](size_t sample) {
         for (size_t c = 0; c < params_.in.depth_; c++) {
             const Float *pin = &delta[sample][params_.in_padded.get_index(
                     params_.weight.width_ / 2, params_.weight.height_ / 2, c)];
-            Float *pdst = &buf[sample][params_.in.get_index(0, 0, c)];
+            Float *pdst = &delta_unpadded[sample][params_.in.get_index(0, 0, c)];
 
             for (size_t y = 0; y < params_.in.height_; y++) {
                 std::copy(pin, pin + params_.in.width_, pdst);
@@ -117,8 +111,6 @@ void Conv2dPadding::copy_and_unpad_delta(const Matrix &delta,
             }
         }
     });
-
-    delta_unpadded = buf;
 }
 
 }  // namespace mnn
@@ -0,0 +1,211 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/infra/cpu_features.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define MNN_HAS_CPUID
+#endif
+
+namespace mnn {
+
+namespace {
+
+#ifdef MNN_HAS_CPUID
+// xgetbv is spelled as raw asm, so this file needs no -mxsave.
+unsigned long long read_xcr0()
+{
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+}
+
+bool bit(unsigned int reg, int n)
+{
+    return (reg >> n) & 1u;
+}
+#endif
+
+CpuFeatures probe()
+{
+    CpuFeatures f;
+#ifdef MNN_HAS_CPUID
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int max_leaf = __get_cpuid_max(0, nullptr);
+    if (max_leaf < 1 || !__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return f;
+    }
+    f.sse2  = bit(edx, 26);
+    f.sse3  = bit(ecx, 0);
+    f.ssse3 = bit(ecx, 9);
+    f.sse41 = bit(ecx, 19);
+    f.sse42 = bit(ecx, 20);
+
+    // the ymm/zmm state must also be enabled by the os, not only the cpu.
+    bool osxsave = bit(ecx, 27);
+    unsigned long long xcr0 = osxsave ? read_xcr0() : 0;
+    bool ymm = (xcr0 & 0x06) == 0x06;
+    bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+    f.avx  = ymm && bit(ecx, 28);
+    f.fma  = ymm && bit(ecx, 12);
+    f.f16c = ymm && bit(ecx, 29);
+
+    if (max_leaf >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        unsigned int max_subleaf = eax;
+        f.avx2       = ymm && bit(ebx, 5);
+        f.avx512f    = zmm && bit(ebx, 16);
+        f.avx512dq   = zmm && bit(ebx, 17);
+        f.avx512bw   = zmm && bit(ebx, 30);
+        f.avx512vl   = zmm && bit(ebx, 31);
+        f.avx512vnni = zmm && bit(ecx, 11);
+        if (max_subleaf >= 1) {
+            __cpuid_count(7, 1, eax, ebx, ecx, edx);
+            f.avxvnni = ymm && bit(eax, 4);
+        }
+    }
+#endif
+    return f;
+}
+
+#ifdef MNN_USE_RUNTIME_DISPATCH
+// tiers with a kernel table linked into this library.
+bool is_built(Isa isa)
+{
+    switch (isa) {
+    case Isa::SCALAR: return true;
+#ifdef MNN_DISPATCH_SSE2
+    case Isa::SSE2:   return true;
+#endif
+#ifdef MNN_DISPATCH_AVX
+    case Isa::AVX:    return true;
+#endif
+#ifdef MNN_DISPATCH_AVX2
+    case Isa::AVX2:   return true;
+#endif
+#ifdef MNN_DISPATCH_AVX512
+    case Isa::AVX512: return true;
+#endif
+#ifdef MNN_DISPATCH_AVX512VNNI
+    case Isa::AVX512VNNI: return true;
+#endif
+    default:          return false;
+    }
+}
+
+bool parse_isa(const char* name, Isa& isa)
+{
+    static const Isa all[] = {Isa::SCALAR, Isa::SSE2, Isa::AVX, Isa::AVX2, Isa::AVX512,
+                              Isa::AVX512VNNI};
+    for (auto candidate : all) {
+        if (std::strcmp(name, to_string(candidate)) == 0) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+#else
+// the single tier a build without runtime dispatch is compiled for.
+Isa static_isa()
+{
+#if defined(MNN_USE_AVX512VNNI)
+    return Isa::AVX512VNNI;
+#elif defined(MNN_USE_AVX512)
+    return Isa::AVX512;
+#elif defined(MNN_USE_AVX2)
+    return Isa::AVX2;
+#elif defined(MNN_USE_AVX)
+    return Isa::AVX;
+#elif defined(MNN_USE_SSE)
+    return Isa::SSE2;
+#else
+    return Isa::SCALAR;
+#endif
+}
+#endif
+
+Isa select_isa()
+{
+#ifdef MNN_USE_RUNTIME_DISPATCH
+    Isa isa = cpu_features().best_isa();
+
+    const char* env = std::getenv("MNN_ISA");
+    if (env != nullptr && *env != '\0') {
+        Isa requested;
+        if (!parse_isa(env, requested)) {
+            std::cerr << "mnn: unknown MNN_ISA=" << env << ", using "
+                      << to_string(isa) << std::endl;
+        } else if (requested > isa) {
+            std::cerr << "mnn: cpu does not support MNN_ISA=" << env
+                      << ", using " << to_string(isa) << std::endl;
+        } else {
+            isa = requested;
+        }
+    }
+
+    while (!is_built(isa)) {
+        isa = static_cast<Isa>(static_cast<int>(isa) - 1);
+    }
+    return isa;
+#else
+    const char* env = std::getenv("MNN_ISA");
+    if (env != nullptr && *env != '\0') {
+        std::cerr << "mnn: MNN_ISA is ignored, this build has no runtime dispatch"
+                  << std::endl;
+    }
+    return static_isa();
+#endif
+}
+
+}  // namespace
+
+Isa CpuFeatures::best_isa() const
+{
+    if (avx512f && avx512bw && avx512dq && avx512vl && fma) {
+        return avx512vnni ? Isa::AVX512VNNI : Isa::AVX512;
+    }
+    if (avx2 && fma && f16c) return Isa::AVX2;
+    if (avx) return Isa::AVX;
+    if (sse2) return Isa::SSE2;
+    return Isa::SCALAR;
+}
+
+const CpuFeatures& cpu_features()
+{
+    static const CpuFeatures features = probe();
+    return features;
+}
+
+Isa active_isa()
+{
+    static const Isa isa = select_isa();
+    return isa;
+}
+
+const char* to_string(Isa isa)
+{
+    switch (isa) {
+    case Isa::SCALAR: return "scalar";
+    case Isa::SSE2:   return "sse2";
+    case Isa::AVX:    return "avx";
+    case Isa::AVX2:   return "avx2";
+    case Isa::AVX512: return "avx512";
+    case Isa::AVX512VNNI: return "avx512vnni";
+    }
+    return "unknown";
+}
+
+}  // namespace mnn
@@ -0,0 +1,35 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/infra/exact_math.h"
+
+#include <atomic>
+
+namespace mnn {
+
+namespace {
+
+#ifdef MNN_USE_EXACT_MATH
+std::atomic<bool> exact(true);
+#else
+std::atomic<bool> exact(false);
+#endif
+
+}  // namespace
+
+bool exact_math()
+{
+    return exact.load(std::memory_order_relaxed);
+}
+
+void set_exact_math(bool enable)
+{
+    exact.store(enable, std::memory_order_relaxed);
+}
+
+}  // namespace mnn
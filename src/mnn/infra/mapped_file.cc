@@ -0,0 +1,79 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/infra/mapped_file.h"
+#include "mnn/infra/mnn_error.h"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mnn {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw MnnError("Can't open " + path);
+    }
+    buffer_.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(buffer_.data(), buffer_.size())) {
+        throw MnnError("Can't read " + path);
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile()
+{
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw MnnError("Can't open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw MnnError("Can't stat " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void *p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw MnnError("Can't map " + path);
+        }
+        data_ = static_cast<const char*>(p);
+    }
+    // the mapping outlives the descriptor
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#endif
+
+}  // namespace mnn
@@ -0,0 +1,180 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/infra/thread_pool.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace mnn {
+
+namespace {
+
+// set on pool workers, and on a caller while it runs its own region
+thread_local bool in_region = false;
+
+}  // namespace
+
+size_t requested_num_threads()
+{
+    const char* env = std::getenv("MNN_NUM_THREADS");
+    size_t n = env != nullptr ? std::strtoul(env, nullptr, 10) : 0;
+    if (n == 0) n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+bool requested_thread_pinning()
+{
+    const char* env = std::getenv("MNN_PIN_THREADS");
+    return env != nullptr && std::strcmp(env, "1") == 0;
+}
+
+void pin_thread_to_core(size_t index)
+{
+#ifdef __linux__
+    size_t cores = std::thread::hardware_concurrency();
+    if (cores == 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)index;
+#endif
+}
+
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool()
+{
+    start(requested_num_threads(), requested_thread_pinning());
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::set_num_threads(size_t n)
+{
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    stop();
+    start(n, pin_);
+}
+
+void ThreadPool::set_pinning(bool pin)
+{
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    size_t n = num_threads();
+    stop();
+    start(n, pin);
+}
+
+void ThreadPool::start(size_t n, bool pin)
+{
+    if (n == 0) n = requested_num_threads();
+
+    pin_      = pin;
+    stopping_ = false;
+    for (size_t i = 1; i < n; i++) {
+        workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker.join();
+    workers_.clear();
+}
+
+void ThreadPool::run(size_t num_tasks, TaskRef task)
+{
+    if (num_tasks == 0) return;
+
+    if (in_region || workers_.empty() || num_tasks == 1 || !run_mutex_.try_lock()) {
+        for (size_t i = 0; i < num_tasks; i++) task(i);
+        return;
+    }
+    std::lock_guard<std::mutex> run_lock(run_mutex_, std::adopt_lock);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_      = &task;
+        num_tasks_ = num_tasks;
+        error_     = nullptr;
+        job_open_  = true;
+        next_.store(0, std::memory_order_relaxed);
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    in_region = true;
+    drain();
+    in_region = false;
+
+    // every task is claimed now; wait for the workers still running one.
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        job_open_ = false;
+        done_.wait(lock, [this] { return active_ == 0; });
+        task_ = nullptr;
+        std::swap(error, error_);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::drain()
+{
+    for (;;) {
+        size_t i = next_.fetch_add(1, std::memory_order_relaxed);
+        if (i >= num_tasks_) break;
+        try {
+            (*task_)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::worker_loop(size_t index)
+{
+    if (pin_) pin_thread_to_core(index);
+    in_region = true;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t seen = generation_;
+    for (;;) {
+        wake_.wait(lock, [&] { return stopping_ || (job_open_ && generation_ != seen); });
+        if (stopping_) return;
+
+        seen = generation_;
+        ++active_;
+        lock.unlock();
+        drain();
+        lock.lock();
+        if (--active_ == 0) done_.notify_one();
+    }
+}
+
+}  // namespace mnn
@@ -0,0 +1,59 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/infra/product.h"
+
+namespace vectorize {
+namespace detail {
+
+namespace {
+
+#ifdef MNN_USE_RUNTIME_DISPATCH
+const KernelTable& select_kernel_table()
+{
+    static const KernelTable scalar =
+            make_kernel_table<GenericScalar<mnn::Float>>(mnn::Isa::SCALAR);
+
+    switch (mnn::active_isa()) {
+#ifdef MNN_DISPATCH_SSE2
+    case mnn::Isa::SSE2:   return sse2_kernel_table();
+#endif
+#ifdef MNN_DISPATCH_AVX
+    case mnn::Isa::AVX:    return avx_kernel_table();
+#endif
+#ifdef MNN_DISPATCH_AVX2
+    case mnn::Isa::AVX2:   return avx2_kernel_table();
+#endif
+#ifdef MNN_DISPATCH_AVX512
+    case mnn::Isa::AVX512: return avx512_kernel_table();
+#endif
+#ifdef MNN_DISPATCH_AVX512VNNI
+    case mnn::Isa::AVX512VNNI: return avx512_vnni_kernel_table();
+#endif
+    default:               return scalar;
+    }
+}
+#else
+const KernelTable& select_kernel_table()
+{
+    static const KernelTable table =
+            make_kernel_table<MNN_VECTORIZE_TYPE>(mnn::active_isa());
+    return table;
+}
+#endif
+
+}  // namespace
+
+const KernelTable& kernels()
+{
+    static const KernelTable& table = select_kernel_table();
+    return table;
+}
+
+}  // namespace detail
+}  // namespace vectorize
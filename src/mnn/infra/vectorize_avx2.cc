@@ -0,0 +1,21 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/infra/product.h"
+
+namespace vectorize {
+namespace detail {
+
+const KernelTable& avx2_kernel_table()
+{
+    static const KernelTable table = make_kernel_table<MNN_VECTORIZE_TYPE>(mnn::Isa::AVX2);
+    return table;
+}
+
+}  // namespace detail
+}  // namespace vectorize
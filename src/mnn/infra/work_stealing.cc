@@ -0,0 +1,209 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/infra/work_stealing.h"
+#include "mnn/infra/thread_pool.h"
+
+namespace mnn {
+
+namespace {
+
+const size_t no_slot = static_cast<size_t>(-1);
+
+// deque of the current thread, no_slot for threads without one
+thread_local size_t current_slot = no_slot;
+
+// attempts at finding work before a worker goes to sleep
+const int spin_count = 64;
+
+}  // namespace
+
+WorkStealingScheduler& WorkStealingScheduler::instance()
+{
+    static WorkStealingScheduler scheduler;
+    return scheduler;
+}
+
+WorkStealingScheduler::WorkStealingScheduler()
+{
+    start(requested_num_threads(), requested_thread_pinning());
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+    stop();
+}
+
+void WorkStealingScheduler::set_num_threads(size_t n)
+{
+    std::lock_guard<std::mutex> lock(external_mutex_);
+    stop();
+    start(n, pin_);
+}
+
+void WorkStealingScheduler::start(size_t n, bool pin)
+{
+    if (n == 0) n = requested_num_threads();
+
+    pin_      = pin;
+    stopping_ = false;
+    queues_.clear();
+    for (size_t i = 0; i < n; i++) {
+        queues_.emplace_back(new Queue);
+    }
+    for (size_t i = 1; i < n; i++) {
+        workers_.emplace_back(&WorkStealingScheduler::worker_loop, this, i);
+    }
+}
+
+void WorkStealingScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto& worker : workers_) worker.join();
+    workers_.clear();
+}
+
+void WorkStealingScheduler::parallel_for(size_t begin, size_t end, size_t grain,
+                                         RangeRef body)
+{
+    if (begin >= end) return;
+    if (workers_.empty()) {
+        body(begin, end);
+        return;
+    }
+
+    bool owner = false;
+    if (current_slot == no_slot && external_mutex_.try_lock()) {
+        current_slot = 0;
+        owner        = true;
+    }
+
+    Job job(body, grain > 0 ? grain : 1);
+    execute(Task{&job, begin, end});
+
+    // help with whatever is pending until every block of this range is done
+    size_t total = end - begin;
+    while (job.done.load(std::memory_order_acquire) < total) {
+        Task task;
+        if (find_task(task)) {
+            execute(task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    if (owner) {
+        current_slot = no_slot;
+        external_mutex_.unlock();
+    }
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+void WorkStealingScheduler::execute(Task task)
+{
+    Job* job = task.job;
+    while (task.end - task.begin > job->grain) {
+        size_t mid = task.begin + (task.end - task.begin) / 2;
+        push(Task{job, mid, task.end});
+        task.end = mid;
+    }
+
+    try {
+        job->body(task.begin, task.end);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(job->error_mutex);
+        if (!job->error) job->error = std::current_exception();
+    }
+    // the owner may return as soon as this lands, so touch job no more
+    job->done.fetch_add(task.end - task.begin, std::memory_order_release);
+}
+
+void WorkStealingScheduler::push(const Task& task)
+{
+    Queue& queue = current_slot != no_slot ? *queues_[current_slot] : injection_;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+
+    epoch_.fetch_add(1);
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        sleep_cv_.notify_one();
+    }
+}
+
+bool WorkStealingScheduler::find_task(Task& task)
+{
+    // own deque from the back, so the most recent, smallest split runs first
+    if (current_slot != no_slot) {
+        Queue& own = *queues_[current_slot];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // other deques from the front, where the largest splits sit
+    size_t n     = queues_.size();
+    size_t first = current_slot != no_slot ? current_slot + 1 : 0;
+    for (size_t k = 0; k < n; k++) {
+        size_t victim = (first + k) % n;
+        if (victim == current_slot) continue;
+        Queue& queue = *queues_[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(injection_.mutex);
+    if (!injection_.tasks.empty()) {
+        task = injection_.tasks.front();
+        injection_.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingScheduler::worker_loop(size_t slot)
+{
+    if (pin_) pin_thread_to_core(slot);
+    current_slot = slot;
+
+    for (;;) {
+        size_t epoch = epoch_.load();
+        Task task;
+        bool found = false;
+        for (int i = 0; i < spin_count && !found; i++) {
+            found = find_task(task);
+            if (!found) std::this_thread::yield();
+        }
+        if (found) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        if (stopping_) return;
+        sleepers_.fetch_add(1);
+        sleep_cv_.wait(lock, [&] { return stopping_ || epoch_.load() != epoch; });
+        sleepers_.fetch_sub(1);
+        if (stopping_) return;
+    }
+}
+
+}  // namespace mnn
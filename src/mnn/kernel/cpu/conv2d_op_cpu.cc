@@ -6,15 +6,250 @@
  *   in the LICENSE file.
  */
 #include "mnn/kernel/cpu/conv2d_op_cpu.h"
+#include "mnn/kernel/cpu/gemm.h"
+#include "mnn/infra/scratch_buffer.h"
 
 namespace mnn {
 namespace kernels {
 
-void conv2d_op_internal(const Matrix &in_data, const Vector &W,
-        const Vector &bias, Matrix &out_data, const ConvParams &params,
-        const bool parallelize)
+namespace {
+
+// below this many multiply-adds per sample the direct loop wins
+const size_t gemm_min_macs = 16 * 1024;
+
+size_t gemm_depth(const ConvParams &params)
+{
+    return params.in.depth_ * params.weight.height_ * params.weight.width_;
+}
+
+// 1x1 kernels with unit strides read the padded input as is
+bool is_pointwise(const ConvParams &params)
+{
+    return params.weight.width_ == 1 && params.weight.height_ == 1 &&
+           params.w_stride == 1 && params.h_stride == 1 &&
+           params.in_padded.area() == params.out.area();
+}
+
+template <typename T>
+void im2col(const T *in, const ConvParams &params, T *col)
+{
+    size_t iw = params.in_padded.width_;
+    size_t ih = params.in_padded.height_;
+    size_t ow = params.out.width_;
+    size_t oh = params.out.height_;
+    size_t kw = params.weight.width_;
+    size_t kh = params.weight.height_;
+
+    for (size_t inc = 0; inc < params.in.depth_; inc++) {
+        const T *plane = in + inc * ih * iw;
+        for (size_t wy = 0; wy < kh; wy++) {
+            for (size_t wx = 0; wx < kw; wx++) {
+                const T *src = plane + wy * params.h_dilation * iw +
+                                   wx * params.w_dilation;
+                for (size_t y = 0; y < oh; y++) {
+                    const T *line = src + y * params.h_stride * iw;
+                    if (params.w_stride == 1) {
+                        std::copy(line, line + ow, col);
+                    } else {
+                        for (size_t x = 0; x < ow; x++) {
+                            col[x] = line[x * params.w_stride];
+                        }
+                    }
+                    col += ow;
+                }
+            }
+        }
+    }
+}
+
+// the padded sample as a gemm_depth x out.area() matrix, in a scratch buffer
+const Float* lower(const Float *in, const ConvParams &params, ScratchBuffer &buf)
+{
+    if (is_pointwise(params)) return in;
+    Float *col = buf.reserve(gemm_depth(params) * params.out.area());
+    conv2d_im2col(in, params, col);
+    return col;
+}
+
+void conv2d_gemm_forward(const Float *in, Span<const Float> W,
+        Span<const Float> bias, Float *out, const ConvParams &params,
+        bool parallelize, const Epilogue *epilogue)
+{
+    size_t od = params.out.depth_;
+    size_t n = params.out.area();
+    size_t k = gemm_depth(params);
+
+    ScratchBuffer buf;
+    const Float *col = lower(in, params, buf);
+    gemm(false, false, od, n, k, Float(1), &W[0], k, col, n, Float(0), out, n,
+            parallelize);
+
+    for (size_t o = 0; o < od; o++) {
+        if (params.has_bias) {
+            vectorize::add(bias[o], n, out + o * n);
+        }
+        if (epilogue) {
+            (*epilogue)(Span<Float>(out + o * n, n));
+        }
+    }
+}
+
+}  // namespace
+
+void conv2d_quantize_weights(Span<const Float> W, const ConvParams &params,
+        QuantizedWeights &q, bool parallelize)
+{
+    size_t od = params.out.depth_;
+    size_t k = gemm_depth(params);
+    if (params.tbl.is_empty()) {
+        quantize_weights(true, k, od, &W[0], k, q, parallelize);
+        return;
+    }
+
+    size_t window = params.weight.width_ * params.weight.height_;
+    Vector masked(&W[0], &W[0] + od * k);
+    for (size_t o = 0; o < od; o++) {
+        for (size_t inc = 0; inc < params.in.depth_; inc++) {
+            if (!params.tbl.is_connected(o, inc)) {
+                Float *w = &masked[o * k + inc * window];
+                std::fill(w, w + window, Float(0));
+            }
+        }
+    }
+    quantize_weights(true, k, od, masked.data(), k, q, parallelize);
+}
+
+void conv2d_int8_forward(const Tensor<> &in_data, const QuantizedWeights &W,
+        Span<const Float> bias, Tensor<> &out_data, const ConvParams &params,
+        Float in_step, bool parallelize, const Epilogue *epilogue)
+{
+    size_t od = params.out.depth_;
+    size_t n = params.out.area();
+
+    // out^T = col^T * W^T, stored channel by channel, with the sample
+    // quantized before it is unfolded
+    for_i(parallelize, in_data.shape(0), [&](size_t sample) {
+        ScratchBuffer quantized_in, quantized_col;
+        const size_t in_size = params.in_padded.size();
+        int16_t *in = quantized_in.reserve_as<int16_t>(in_size);
+        quantize(&in_data[sample][0], in_size, in_step, in);
+
+        const int16_t *col = in;
+        if (!is_pointwise(params)) {
+            int16_t *buf = quantized_col.reserve_as<int16_t>(
+                    gemm_depth(params) * n);
+            im2col(in, params, buf);
+            col = buf;
+        }
+
+        Float *out = &out_data[sample][0];
+        qgemm(true, n, col, n, in_step, W,
+                params.has_bias ? &bias[0] : nullptr, out, 1, n,
+                parallelize);
+        if (epilogue) {
+            for (size_t o = 0; o < od; o++) {
+                (*epilogue)(Span<Float>(out + o * n, n));
+            }
+        }
+    }, 1);
+}
+
+bool conv2d_use_gemm(const ConvParams &params)
+{
+    size_t macs = params.out.depth_ * gemm_depth(params) * params.out.area();
+    return params.tbl.is_empty() && macs >= gemm_min_macs;
+}
+
+void conv2d_im2col(const Float *in, const ConvParams &params, Float *col)
+{
+    im2col(in, params, col);
+}
+
+void conv2d_col2im(const Float *col, const ConvParams &params, Float *in)
+{
+    size_t iw = params.in_padded.width_;
+    size_t ih = params.in_padded.height_;
+    size_t ow = params.out.width_;
+    size_t oh = params.out.height_;
+    size_t kw = params.weight.width_;
+    size_t kh = params.weight.height_;
+
+    for (size_t inc = 0; inc < params.in.depth_; inc++) {
+        Float *plane = in + inc * ih * iw;
+        for (size_t wy = 0; wy < kh; wy++) {
+            for (size_t wx = 0; wx < kw; wx++) {
+                Float *dst = plane + wy * params.h_dilation * iw +
+                             wx * params.w_dilation;
+                for (size_t y = 0; y < oh; y++) {
+                    Float *line = dst + y * params.h_stride * iw;
+                    if (params.w_stride == 1) {
+                        vectorize::add(col, ow, line);
+                    } else {
+                        for (size_t x = 0; x < ow; x++) {
+                            line[x * params.w_stride] += col[x];
+                        }
+                    }
+                    col += ow;
+                }
+            }
+        }
+    }
+}
+
+void conv2d_gemm_backward_data(Span<const Float> W, const Float *curr_delta,
+        Float *prev_delta, const ConvParams &params, bool parallelize)
+{
+    size_t od = params.out.depth_;
+    size_t n = params.out.area();
+    size_t k = gemm_depth(params);
+
+    // prev_delta += col2im(W^T * delta)
+    if (is_pointwise(params)) {
+        gemm(true, false, k, n, od, Float(1), &W[0], k, curr_delta, n,
+                Float(1), prev_delta, n, parallelize);
+    } else {
+        ScratchBuffer buf;
+        Float *dcol = buf.reserve(k * n);
+        gemm(true, false, k, n, od, Float(1), &W[0], k, curr_delta, n,
+                Float(0), dcol, n, parallelize);
+        conv2d_col2im(dcol, params, prev_delta);
+    }
+}
+
+void conv2d_gemm_backward_weights(const Float *prev_out, Float *dW,
+        const Float *curr_delta, const ConvParams &params, bool parallelize)
 {
-    for_(parallelize, 0u, in_data.size(), [&](const BlockedRange &r) {
+    size_t od = params.out.depth_;
+    size_t n = params.out.area();
+    size_t k = gemm_depth(params);
+
+    // dW += delta * col^T
+    ScratchBuffer buf;
+    const Float *col = lower(prev_out, params, buf);
+    gemm(false, true, od, k, n, Float(1), curr_delta, n, col, n, Float(1),
+            dW, k, parallelize);
+}
+
+void conv2d_op_internal(const Tensor<> &in_data, Span<const Float> W,
+        Span<const Float> bias, Tensor<> &out_data, const ConvParams &params,
+        const bool parallelize, const WinogradFilter *winograd,
+        const Epilogue *epilogue)
+{
+    if (winograd) {
+        conv2d_winograd_forward(in_data, *winograd, bias, out_data, params,
+                parallelize, epilogue);
+        return;
+    }
+
+    if (conv2d_use_gemm(params)) {
+        for_i(parallelize, in_data.shape(0), [&](size_t sample) {
+            conv2d_gemm_forward(&in_data[sample][0], W, bias,
+                    &out_data[sample][0], params, parallelize, epilogue);
+        }, 1);
+        return;
+    }
+
+    for_(parallelize, 0u, in_data.shape(0), [&](const BlockedRange &r) {
         size_t out_area = params.out.area();
         size_t iw = params.in_padded.width_;
         size_t id = params.in.depth_;
@@ -28,8 +263,8 @@ void conv2d_op_internal(const Matrix &in_data, const Vector &W,
         size_t elem_stride = params.w_stride;
         size_t line_stride = iw * params.h_stride;
         for (size_t sample = r.begin(); sample < r.end(); sample++) {
-            const Vector &in = in_data[sample];
-            Vector &a = out_data[sample];
+            Span<const Float> in = in_data[sample];
+            Span<Float> a = out_data[sample];
             for (size_t o = 0; o < od; o++) {
                 Float *pa = &a[params.out.get_index(0, 0, o)];
                 for (size_t inc = 0; inc < id; inc++) {
@@ -64,6 +299,9 @@ void conv2d_op_internal(const Matrix &in_data, const Vector &W,
                 if (params.has_bias) {
                     vectorize::add(bias[o], out_area, pa);
                 }
+                if (epilogue) {
+                    (*epilogue)(Span<Float>(pa, out_area));
+                }
             }
         }
     }, 0u);
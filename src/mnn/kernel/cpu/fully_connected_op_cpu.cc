@@ -6,59 +6,189 @@
  *   in the LICENSE file.
  */
 #include "mnn/kernel/cpu/fully_connected_op_cpu.h"
+#include "mnn/kernel/cpu/gemm.h"
 
 namespace mnn {
 namespace kernels {
 
-void fully_connected_op_internal(const Matrix &in_data, const Vector &W,
-        const Vector &bias, Matrix &out_data, const FullyParams &params,
-        const bool layer_parallelize)
+namespace {
+
+// packing W costs about one pass over it, so small batches stream W once
+// per sample instead
+const size_t gemm_min_batch = 4;
+
+}  // namespace
+
+void fully_connected_op_internal(const Tensor<> &in_data, Span<const Float> W,
+        Span<const Float> bias, Tensor<> &out_data, const FullyParams &params,
+        const bool layer_parallelize, const Epilogue *epilogue)
 {
-    for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
-        const Vector &in = in_data[sample];
-        Vector &out = out_data[sample];
-
-        for (size_t i = 0; i < params.out_size_; i++) {
-            out[i] = Float {0};
-            for (size_t c = 0; c < params.in_size_; c++) {
-                out[i] += W[c * params.out_size_ + i] * in[c];
-            }
-
-            if (params.has_bias_) {
-                out[i] += bias[i];
-            }
+    size_t batch = in_data.shape(0);
+    size_t in_size = params.in_size_;
+    size_t out_size = params.out_size_;
+
+    if (batch < gemm_min_batch) {
+        // out += in[c] * W[c, :], walking W row by row
+        for (size_t sample = 0; sample < batch; sample++) {
+            Span<const Float> in = in_data[sample];
+            Span<Float> out = out_data[sample];
+
+            for_(layer_parallelize, 0, out_size, [&](const BlockedRange &r) {
+                size_t n = r.end() - r.begin();
+                Float *pout = &out[r.begin()];
+                if (params.has_bias_) {
+                    std::copy(&bias[r.begin()], &bias[r.begin()] + n, pout);
+                } else {
+                    std::fill(pout, pout + n, Float {0});
+                }
+                for (size_t c = 0; c < in_size; c++) {
+                    vectorize::muladd(&W[c * out_size + r.begin()], in[c], n,
+                            pout);
+                }
+                if (epilogue) {
+                    (*epilogue)(Span<Float>(pout, n));
+                }
+            });
         }
-    });
+        return;
+    }
+
+    // out = in * W + bias over the whole batch, which is already one
+    // batch x in_size row-major matrix
+    Float *out = out_data.data();
+    gemm(false, false, batch, out_size, in_size, Float(1), in_data.data(),
+            in_size, W.data(), out_size, Float(0), out, out_size,
+            layer_parallelize);
+    for (size_t sample = 0; sample < batch; sample++) {
+        Float *row = out + sample * out_size;
+        if (params.has_bias_) {
+            vectorize::add(bias.data(), out_size, row);
+        }
+        if (epilogue) {
+            (*epilogue)(Span<Float>(row, out_size));
+        }
+    }
+}
+
+void fully_connected_int8_forward(const Tensor<> &in_data,
+        const QuantizedWeights &W, Span<const Float> bias, Tensor<> &out_data,
+        const FullyParams &params, Float in_step,
+        const bool layer_parallelize, const Epilogue *epilogue)
+{
+    size_t batch = in_data.shape(0);
+    size_t out_size = params.out_size_;
+    Float *out = out_data.data();
+
+    // int8 weights stream a quarter of the bytes, so even single samples
+    // go through the GEMM
+    qgemm(false, batch, in_data.data(), params.in_size_, in_step, W,
+            params.has_bias_ ? bias.data() : nullptr, out, out_size, 1,
+            layer_parallelize);
+    if (epilogue) {
+        for (size_t sample = 0; sample < batch; sample++) {
+            (*epilogue)(Span<Float>(out + sample * out_size, out_size));
+        }
+    }
+}
+
+void fully_connected_half_weights(Span<const Float> W, Precision precision,
+        HalfWeights &half)
+{
+    half.data.resize(W.size());
+    vectorize::narrow(precision, W.data(), W.size(), half.data.data());
+    half.precision = precision;
 }
 
-void fully_connected_op_internal(const Matrix &prev_out, const Vector &W,
-        Matrix &dW, Matrix &db, Matrix &curr_delta, Matrix &prev_delta,
-        const FullyParams &params, const bool layer_parallelize)
+void fully_connected_half_forward(const Tensor<> &in_data,
+        const HalfWeights &W, Span<const Float> bias, Tensor<> &out_data,
+        const FullyParams &params, const bool layer_parallelize,
+        const Epilogue *epilogue)
 {
-    for (size_t sample = 0; sample < prev_out.size(); sample++) {
-        for (size_t c = 0; c < params.in_size_; c++) {
-            // propagate delta to previous layer
-            // prev_delta[c] += current_delta[r] * W_[c * out_size_ + r]
-            prev_delta[sample][c] += vectorize::dot(&curr_delta[sample][0],
-                    &W[c * params.out_size_], params.out_size_);
+    size_t batch = in_data.shape(0);
+    size_t in_size = params.in_size_;
+    size_t out_size = params.out_size_;
+    const uint16_t *w = W.data.data();
+
+    if (batch < gemm_min_batch) {
+        // as in float, widening each row of W as it streams by
+        for (size_t sample = 0; sample < batch; sample++) {
+            Span<const Float> in = in_data[sample];
+            Span<Float> out = out_data[sample];
+
+            for_(layer_parallelize, 0, out_size, [&](const BlockedRange &r) {
+                size_t n = r.end() - r.begin();
+                Float *pout = &out[r.begin()];
+                if (params.has_bias_) {
+                    std::copy(&bias[r.begin()], &bias[r.begin()] + n, pout);
+                } else {
+                    std::fill(pout, pout + n, Float {0});
+                }
+                for (size_t c = 0; c < in_size; c++) {
+                    vectorize::muladd(W.precision,
+                            &w[c * out_size + r.begin()], in[c], n, pout);
+                }
+                if (epilogue) {
+                    (*epilogue)(Span<Float>(pout, n));
+                }
+            });
         }
+        return;
+    }
 
-        for_(layer_parallelize, 0, params.out_size_, [&](const BlockedRange &r) {
-            // accumulate weight-step using delta
-            // dW[c * out_size + i] += current_delta[i] * prev_out[c]
-            for (size_t c = 0; c < params.in_size_; c++) {
-                vectorize::muladd(&curr_delta[sample][r.begin()], prev_out[sample][c],
-                        r.end() - r.begin(),
-                        &dW[sample][c * params.out_size_ + r.begin()]);
-            }
-
-            if (params.has_bias_) {
-                // Vector& db = *in_grad[2];
-                for (size_t i = r.begin(); i < r.end(); i++) {
-                    db[sample][i] += curr_delta[sample][i];
+    Float *out = out_data.data();
+    gemm(false, false, batch, out_size, in_size, Float(1), in_data.data(),
+            in_size, w, W.precision, out_size, Float(0), out, out_size,
+            layer_parallelize);
+    for (size_t sample = 0; sample < batch; sample++) {
+        Float *row = out + sample * out_size;
+        if (params.has_bias_) {
+            vectorize::add(bias.data(), out_size, row);
+        }
+        if (epilogue) {
+            (*epilogue)(Span<Float>(row, out_size));
+        }
+    }
+}
+
+void fully_connected_op_internal(const Tensor<> &prev_out,
+        Span<const Float> W, Tensor<> &dW, Tensor<> &db, Tensor<> &curr_delta,
+        Tensor<> &prev_delta, const FullyParams &params,
+        const bool layer_parallelize)
+{
+    size_t batch = prev_out.shape(0);
+    size_t in_size = params.in_size_;
+    size_t out_size = params.out_size_;
+    const Float *delta = curr_delta.data();
+
+    // propagate delta to previous layer
+    // prev_delta[c] += current_delta[r] * W_[c * out_size_ + r]
+    if (batch < gemm_min_batch) {
+        for (size_t sample = 0; sample < batch; sample++) {
+            for_(layer_parallelize, 0, in_size, [&](const BlockedRange &r) {
+                for (size_t c = r.begin(); c < r.end(); c++) {
+                    prev_delta[sample][c] += vectorize::dot(
+                            delta + sample * out_size, &W[c * out_size],
+                            out_size);
                 }
-            }
-        });
+            });
+        }
+    } else {
+        gemm(false, true, batch, in_size, out_size, Float(1), delta, out_size,
+                W.data(), out_size, Float(1), prev_delta.data(), in_size,
+                layer_parallelize);
+    }
+
+    // accumulate weight-step of the whole batch into the first sample's
+    // slot; the slots are summed before the update anyway
+    // dW[c * out_size + i] += current_delta[i] * prev_out[c]
+    gemm(true, false, in_size, out_size, batch, Float(1), prev_out.data(),
+            in_size, delta, out_size, Float(1), dW.data(), out_size,
+            layer_parallelize);
+
+    if (params.has_bias_) {
+        for (size_t sample = 0; sample < batch; sample++) {
+            vectorize::add(delta + sample * out_size, out_size, db.data());
+        }
     }
 }
 
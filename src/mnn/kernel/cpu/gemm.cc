@@ -0,0 +1,193 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/kernel/cpu/gemm.h"
+
+#include <algorithm>
+
+#include "mnn/infra/parallel_for.h"
+#include "mnn/infra/product.h"
+#include "mnn/infra/scratch_buffer.h"
+
+namespace mnn {
+namespace kernels {
+
+namespace {
+
+// depth of a packed panel pair, and width of the op(B) block kept packed
+const size_t KC = 256;
+const size_t NC = 4096;
+
+void scale(size_t m, size_t n, Float beta, Float *c, size_t ldc)
+{
+    if (beta == Float(1)) return;
+    for (size_t i = 0; i < m; i++) {
+        Float *row = c + i * ldc;
+        if (beta == Float(0)) {
+            std::fill(row, row + n, Float(0));
+        } else {
+            for (size_t j = 0; j < n; j++) row[j] *= beta;
+        }
+    }
+}
+
+// op(B)[pc:pc+kc, jc:jc+nc] into kc x nr panels, zero padded on the right
+void pack_b(bool trans, const Float *b, Precision, size_t ldb, size_t pc,
+        size_t jc, size_t kc, size_t nc, size_t nr, Float *dst,
+        bool parallelize)
+{
+    size_t panels = (nc + nr - 1) / nr;
+    for_i(parallelize, panels, [&](size_t jp) {
+        Float *pdst = dst + jp * kc * nr;
+        size_t j0 = jc + jp * nr;
+        size_t cols = std::min(nr, jc + nc - j0);
+        for (size_t p = 0; p < kc; p++) {
+            if (trans) {
+                for (size_t j = 0; j < cols; j++) {
+                    pdst[j] = b[(j0 + j) * ldb + pc + p];
+                }
+            } else {
+                const Float *src = b + (pc + p) * ldb + j0;
+                std::copy(src, src + cols, pdst);
+            }
+            std::fill(pdst + cols, pdst + nr, Float(0));
+            pdst += nr;
+        }
+    });
+}
+
+// the same from half precision B, widened a row of the block at a time so
+// the conversion runs over long spans
+void pack_b(bool trans, const uint16_t *b, Precision precision, size_t ldb,
+        size_t pc, size_t jc, size_t kc, size_t nc, size_t nr, Float *dst,
+        bool parallelize)
+{
+    size_t panels = (nc + nr - 1) / nr;
+    for_i(parallelize, kc, [&](size_t p) {
+        uint16_t column[NC];
+        const uint16_t *src = column;
+        if (trans) {
+            for (size_t j = 0; j < nc; j++) {
+                column[j] = b[(jc + j) * ldb + pc + p];
+            }
+        } else {
+            src = b + (pc + p) * ldb + jc;
+        }
+        alignas(64) Float row[NC];
+        vectorize::widen(precision, src, nc, row);
+        for (size_t jp = 0; jp < panels; jp++) {
+            Float *pdst = dst + (jp * kc + p) * nr;
+            size_t cols = std::min(nr, nc - jp * nr);
+            std::copy(row + jp * nr, row + jp * nr + cols, pdst);
+            std::fill(pdst + cols, pdst + nr, Float(0));
+        }
+    });
+}
+
+// alpha * op(A)[0:m, pc:pc+kc] into mr x kc panels, zero padded below
+void pack_a(bool trans, const Float *a, size_t lda, size_t pc, size_t m,
+        size_t kc, size_t mr, Float alpha, Float *dst, bool parallelize)
+{
+    size_t panels = (m + mr - 1) / mr;
+    for_i(parallelize, panels, [&](size_t ip) {
+        Float *pdst = dst + ip * kc * mr;
+        size_t i0 = ip * mr;
+        size_t rows = std::min(mr, m - i0);
+        for (size_t p = 0; p < kc; p++) {
+            for (size_t i = 0; i < rows; i++) {
+                pdst[i] = alpha * (trans ? a[(pc + p) * lda + i0 + i]
+                                         : a[(i0 + i) * lda + pc + p]);
+            }
+            std::fill(pdst + rows, pdst + mr, Float(0));
+            pdst += mr;
+        }
+    });
+}
+
+template <typename T>
+void gemm_blocked(bool trans_a, bool trans_b, size_t m, size_t n, size_t k,
+        Float alpha, const Float *a, size_t lda, const T *b,
+        Precision precision, size_t ldb, Float beta, Float *c, size_t ldc,
+        bool parallelize)
+{
+    scale(m, n, beta, c, ldc);
+    if (m == 0 || n == 0 || k == 0 || alpha == Float(0)) return;
+
+    const auto &kt = vectorize::detail::kernels();
+    const size_t mr = kt.gemm_mr;
+    const size_t nr = kt.gemm_nr;
+    const size_t nc_max = std::min(NC, (n + nr - 1) / nr * nr);
+    const size_t m_panels = (m + mr - 1) / mr;
+
+    ScratchBuffer packed_a, packed_b;
+    Float *pa = packed_a.reserve(m_panels * mr * std::min(KC, k));
+    Float *pb = packed_b.reserve(nc_max * std::min(KC, k));
+
+    for (size_t jc = 0; jc < n; jc += NC) {
+        size_t nc = std::min(NC, n - jc);
+        size_t n_panels = (nc + nr - 1) / nr;
+
+        for (size_t pc = 0; pc < k; pc += KC) {
+            size_t kc = std::min(KC, k - pc);
+            pack_b(trans_b, b, precision, ldb, pc, jc, kc, nc, nr, pb,
+                    parallelize);
+            pack_a(trans_a, a, lda, pc, m, kc, mr, alpha, pa, parallelize);
+
+            // walk the tiles panel by panel of A, so each A panel stays in
+            // L1 while the packed block of B streams from L2
+            for_i(parallelize, m_panels * n_panels, [&](size_t t) {
+                size_t ip = t / n_panels;
+                size_t jp = t % n_panels;
+                size_t i0 = ip * mr;
+                size_t j0 = jp * nr;
+                const Float *ap = pa + ip * kc * mr;
+                const Float *bp = pb + jp * kc * nr;
+                Float *ct = c + i0 * ldc + jc + j0;
+
+                size_t rows = std::min(mr, m - i0);
+                size_t cols = std::min(nr, nc - j0);
+                if (rows == mr && cols == nr) {
+                    kt.gemm_kernel(kc, ap, bp, ct, ldc);
+                    return;
+                }
+
+                // edge tile: go through a full one, with room for any tier
+                alignas(64) Float tile[16 * 64];
+                std::fill(tile, tile + mr * nr, Float(0));
+                kt.gemm_kernel(kc, ap, bp, tile, nr);
+                for (size_t i = 0; i < rows; i++) {
+                    for (size_t j = 0; j < cols; j++) {
+                        ct[i * ldc + j] += tile[i * nr + j];
+                    }
+                }
+            }, 1);
+        }
+    }
+}
+
+}  // namespace
+
+void gemm(bool trans_a, bool trans_b, size_t m, size_t n, size_t k,
+        Float alpha, const Float *a, size_t lda, const Float *b, size_t ldb,
+        Float beta, Float *c, size_t ldc, bool parallelize)
+{
+    gemm_blocked(trans_a, trans_b, m, n, k, alpha, a, lda, b,
+            Precision::FLOAT, ldb, beta, c, ldc, parallelize);
+}
+
+void gemm(bool trans_a, bool trans_b, size_t m, size_t n, size_t k,
+        Float alpha, const Float *a, size_t lda, const uint16_t *b,
+        Precision b_precision, size_t ldb, Float beta, Float *c, size_t ldc,
+        bool parallelize)
+{
+    gemm_blocked(trans_a, trans_b, m, n, k, alpha, a, lda, b, b_precision,
+            ldb, beta, c, ldc, parallelize);
+}
+
+}  // namespace kernels
+}  // namespace mnn
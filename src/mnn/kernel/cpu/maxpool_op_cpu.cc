@@ -0,0 +1,145 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+#include "mnn/kernel/cpu/maxpool_op_cpu.h"
+#include "mnn/infra/scratch_buffer.h"
+
+#include <algorithm>
+
+namespace mnn {
+namespace kernels {
+
+namespace {
+
+// number of outputs along one axis whose window lies inside the input
+size_t full_windows(size_t in_size, size_t out_size, size_t pool_size,
+        size_t stride)
+{
+    if (in_size < pool_size) {
+        return 0;
+    }
+    return std::min(out_size, (in_size - pool_size) / stride + 1);
+}
+
+// Rows of outputs with full windows: the running max over the window is
+// taken for all ox at once, one candidate row per window position. The
+// input row is split into stride_x phases first, so that the candidates of
+// consecutive outputs are contiguous whatever the stride.
+void maxpool_full_rows(Span<const Float> in, Span<Float> out,
+        std::vector<size_t> &argmax, const MaxpoolParams &params,
+        size_t full_w, size_t full_h)
+{
+    const Shape3d &in_dim = params.in;
+    const Shape3d &out_dim = params.out;
+    const size_t px = params.pool_size_x;
+    const size_t py = params.pool_size_y;
+    const size_t sx = params.stride_x;
+    const size_t sy = params.stride_y;
+    const size_t phase_size = (in_dim.width_ + sx - 1) / sx;
+
+    ScratchBuffer buf;
+    Float *phases = buf.reserve(phase_size * sx + full_w);
+    Float *arg = phases + phase_size * sx;
+
+    for (size_t c = 0; c < in_dim.depth_; c++) {
+        for (size_t oy = 0; oy < full_h; oy++) {
+            Float *max = &out[out_dim.get_index(0, oy, c)];
+
+            for (size_t ky = 0; ky < py; ky++) {
+                const Float *row = &in[in_dim.get_index(0, oy * sy + ky, c)];
+                if (sx > 1) {
+                    for (size_t p = 0; p < sx; p++) {
+                        Float *phase = phases + p * phase_size;
+                        for (size_t x = p, i = 0; x < in_dim.width_; x += sx) {
+                            phase[i++] = row[x];
+                        }
+                    }
+                }
+
+                for (size_t kx = 0; kx < px; kx++) {
+                    // column ox * sx + kx is entry ox + kx / sx of phase kx % sx
+                    const Float *cand = (sx == 1) ? row + kx :
+                            phases + (kx % sx) * phase_size + kx / sx;
+                    Float pos = static_cast<Float>(ky * px + kx);
+                    if (ky == 0 && kx == 0) {
+                        std::copy(cand, cand + full_w, max);
+                        std::fill(arg, arg + full_w, Float {0});
+                    } else {
+                        vectorize::max_update(cand, full_w, pos, max, arg);
+                    }
+                }
+            }
+
+            size_t *idx = &argmax[out_dim.get_index(0, oy, c)];
+            for (size_t ox = 0; ox < full_w; ox++) {
+                size_t k = static_cast<size_t>(arg[ox]);
+                idx[ox] = in_dim.get_index(ox * sx + k % px, oy * sy + k / px,
+                        c);
+            }
+        }
+    }
+}
+
+}  // namespace
+
+void maxpool_op_internal(const Tensor<> &in_data, Tensor<> &out_data,
+        MaxpoolParams &params, const bool layer_parallelize)
+{
+    const Shape3d &out_dim = params.out;
+    const size_t full_w = full_windows(params.in.width_, out_dim.width_,
+            params.pool_size_x, params.stride_x);
+    const size_t full_h = full_windows(params.in.height_, out_dim.height_,
+            params.pool_size_y, params.stride_y);
+
+    for_i(layer_parallelize, in_data.shape(0), [&](size_t sample) {
+        Span<const Float> in = in_data[sample];
+        Span<Float> out = out_data[sample];
+        std::vector<size_t> &argmax = params.out2inmax[sample];
+
+        if (full_w > 0 && full_h > 0) {
+            maxpool_full_rows(in, out, argmax, params, full_w, full_h);
+        }
+
+        // windows clipped by ceil_mode or SAME padding
+        for (size_t c = 0; c < out_dim.depth_; c++) {
+            for (size_t oy = 0; oy < out_dim.height_; oy++) {
+                size_t ox = (oy < full_h) ? full_w : 0;
+                for (; ox < out_dim.width_; ox++) {
+                    size_t o = out_dim.get_index(ox, oy, c);
+                    const std::vector<size_t> &window = params.out2in[o];
+                    size_t max_idx = window[0];
+                    for (size_t i : window) {
+                        if (in[i] > in[max_idx]) {
+                            max_idx = i;
+                        }
+                    }
+                    out[o] = in[max_idx];
+                    argmax[o] = max_idx;
+                }
+            }
+        }
+    });
+}
+
+void maxpool_grad_op_internal(const Tensor<> &curr_delta,
+        Tensor<> &prev_delta, const MaxpoolParams &params,
+        const bool layer_parallelize)
+{
+    for_i(layer_parallelize, curr_delta.shape(0), [&](size_t sample) {
+        Span<const Float> delta = curr_delta[sample];
+        Span<Float> prev = prev_delta[sample];
+        const std::vector<size_t> &argmax = params.out2inmax[sample];
+
+        // overlapping windows may share a max, hence +=
+        for (size_t o = 0; o < delta.size(); o++) {
+            prev[argmax[o]] += delta[o];
+        }
+    });
+}
+
+}  // namespace kernels
+}  // namespace mnn
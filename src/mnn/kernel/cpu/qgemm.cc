@@ -0,0 +1,265 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+#include "mnn/kernel/cpu/qgemm.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mnn/infra/parallel_for.h"
+#include "mnn/infra/product.h"
+#include "mnn/infra/scratch_buffer.h"
+
+namespace mnn {
+namespace kernels {
+
+namespace {
+
+// pairs of k in a packed panel of A
+const size_t KP = 256;
+
+const Float qmax = 127;
+
+// the int32 sums of k products of 127 * 127 must not overflow
+const size_t max_depth = 2147483647 / (127 * 127);
+
+int32_t quantize_value(Float x, Float inv_step)
+{
+    Float q = std::nearbyint(x * inv_step);
+    return static_cast<int32_t>(std::max(-qmax, std::min(qmax, q)));
+}
+
+// the word of a packed A step: two consecutive k of one row
+int32_t pair(int16_t lo, int16_t hi)
+{
+    return static_cast<int32_t>(static_cast<uint16_t>(lo)
+            | static_cast<uint32_t>(static_cast<uint16_t>(hi)) << 16);
+}
+
+// op(A)[0:m, 2 pc:2 (pc + kp)] of a quantized A into mr x kp panels of
+// pairs, zero padded below and past k
+void pack_a(bool trans, const int16_t *a, size_t lda, size_t m, size_t k,
+        size_t pc, size_t kp, size_t mr, int32_t *dst, bool parallelize)
+{
+    size_t panels = (m + mr - 1) / mr;
+    for_i(parallelize, panels, [&](size_t ip) {
+        int32_t *pdst = dst + ip * kp * mr;
+        size_t i0 = ip * mr;
+        size_t rows = std::min(mr, m - i0);
+        for (size_t p = 2 * pc; p < 2 * (pc + kp); p += 2) {
+            if (p + 1 >= k) {
+                // the last pair of an odd k, or past k
+                for (size_t i = 0; i < rows; i++) {
+                    int16_t lo = 0;
+                    if (p < k) {
+                        lo = trans ? a[p * lda + i0 + i]
+                                   : a[(i0 + i) * lda + p];
+                    }
+                    pdst[i] = pair(lo, 0);
+                }
+            } else if (trans) {
+                const int16_t *lo = a + p * lda + i0;
+                for (size_t i = 0; i < rows; i++) {
+                    pdst[i] = pair(lo[i], lo[lda + i]);
+                }
+            } else {
+                const int16_t *row = a + i0 * lda + p;
+                for (size_t i = 0; i < rows; i++) {
+                    pdst[i] = pair(row[i * lda], row[i * lda + 1]);
+                }
+            }
+            std::fill(pdst + rows, pdst + mr, 0);
+            pdst += mr;
+        }
+    });
+}
+
+// c = A * w + bias, with pack(pc, kp, dst) packing the quantized
+// op(A)[0:m, 2 pc:2 (pc + kp)] like pack_a
+template <typename Pack>
+void qgemm_packed(size_t m, Float a_step, const QuantizedWeights &w,
+        const Float *bias, Float *c, size_t ldc_row, size_t ldc_col,
+        bool parallelize, Pack pack)
+{
+    const auto &kt = vectorize::detail::kernels();
+    const size_t mr = kt.qgemm_mr;
+    const size_t nr = kt.qgemm_nr;
+    if (w.nr != nr) {
+        throw MnnError("Int8 weights packed for another SIMD tier");
+    }
+    const size_t n = w.n;
+    const size_t kp = (w.k + 1) / 2;
+    const size_t m_panels = (m + mr - 1) / mr;
+    const size_t n_panels = (n + nr - 1) / nr;
+    if (m == 0 || n == 0) return;
+
+    // c = sum * mul + add, padded to whole tiles
+    Vector mul(n_panels * nr, Float(0)), add(n_panels * nr, Float(0));
+    for (size_t j = 0; j < n; j++) {
+        mul[j] = a_step * w.scale[j];
+        add[j] = bias ? bias[j] : Float(0);
+    }
+
+    // the sums of each whole tile, kept together so no tile needs an edge
+    // case and each one is dequantized while still in cache
+    const size_t tiles = m_panels * n_panels;
+    ScratchBuffer sums_buf, packed_a;
+    int32_t *sums = sums_buf.reserve_as<int32_t>(tiles * mr * nr);
+    int32_t *pa = packed_a.reserve_as<int32_t>(
+            m_panels * mr * std::min(KP, kp));
+
+    for (size_t pc = 0; pc < kp; pc += KP) {
+        size_t kc = std::min(KP, kp - pc);
+        pack(pc, kc, pa);
+
+        for_i(parallelize, tiles, [&](size_t t) {
+            size_t ip = t / n_panels;
+            size_t jp = t % n_panels;
+            int32_t *tile = sums + t * mr * nr;
+            if (pc == 0) {
+                std::fill(tile, tile + mr * nr, 0);
+            }
+            kt.qgemm_kernel(kc, pa + ip * kc * mr,
+                    &w.packed[(jp * kp + pc) * nr * 2], tile, nr);
+            if (pc + kc < kp) {
+                return;
+            }
+
+            size_t i0 = ip * mr;
+            size_t j0 = jp * nr;
+            size_t rows = std::min(mr, m - i0);
+            size_t cols = std::min(nr, n - j0);
+            const Float *scale = &mul[j0];
+            const Float *b = &add[j0];
+            if (ldc_col == 1) {
+                for (size_t i = 0; i < rows; i++) {
+                    const int32_t *s = tile + i * nr;
+                    Float *ci = c + (i0 + i) * ldc_row + j0;
+                    for (size_t j = 0; j < cols; j++) {
+                        ci[j] = s[j] * scale[j] + b[j];
+                    }
+                }
+                return;
+            }
+            // through a float tile, so the conversion runs row by row
+            alignas(64) Float dq[16 * 64];
+            for (size_t i = 0; i < rows; i++) {
+                const int32_t *s = tile + i * nr;
+                for (size_t j = 0; j < nr; j++) {
+                    dq[i * nr + j] = s[j] * scale[j] + b[j];
+                }
+            }
+            for (size_t j = 0; j < cols; j++) {
+                Float *cj = c + i0 * ldc_row + (j0 + j) * ldc_col;
+                for (size_t i = 0; i < rows; i++) {
+                    cj[i * ldc_row] = dq[i * nr + j];
+                }
+            }
+        }, 1);
+    }
+}
+
+}  // namespace
+
+void quantize_weights(bool trans, size_t k, size_t n, const Float *w,
+        size_t ldw, QuantizedWeights &q, bool parallelize)
+{
+    if (k > max_depth) {
+        throw MnnError("Too deep a matrix for int8 products");
+    }
+    auto at = [&](size_t p, size_t j) {
+        return trans ? w[j * ldw + p] : w[p * ldw + j];
+    };
+
+    const size_t nr = vectorize::detail::kernels().qgemm_nr;
+    const size_t kp = (k + 1) / 2;
+    const size_t panels = (n + nr - 1) / nr;
+    q.k = k;
+    q.n = n;
+    q.nr = nr;
+    q.scale.assign(n, Float(0));
+    q.packed.resize(panels * kp * nr * 2);
+
+    // one panel of columns at a time, so the panels are independent
+    for_i(parallelize, panels, [&](size_t jp) {
+        size_t j0 = jp * nr;
+        size_t cols = std::min(nr, n - j0);
+        Float inv[64];
+        for (size_t j = 0; j < cols; j++) {
+            Float absmax = 0;
+            for (size_t p = 0; p < k; p++) {
+                absmax = std::max(absmax, std::abs(at(p, j0 + j)));
+            }
+            q.scale[j0 + j] = absmax / qmax;
+            inv[j] = absmax > 0 ? qmax / absmax : Float(0);
+        }
+        int8_t *dst = &q.packed[jp * kp * nr * 2];
+        for (size_t p = 0; p < 2 * kp; p += 2) {
+            for (size_t j = 0; j < nr; j++) {
+                for (size_t r = 0; r < 2; r++) {
+                    *dst++ = j < cols && p + r < k
+                            ? static_cast<int8_t>(quantize_value(
+                                    at(p + r, j0 + j), inv[j]))
+                            : int8_t(0);
+                }
+            }
+        }
+    });
+}
+
+void quantize(const Float *x, size_t size, Float step, int16_t *q)
+{
+    vectorize::detail::kernels().quantize(x, size,
+            step > 0 ? Float(1) / step : Float(0), q);
+}
+
+void qgemm(bool trans_a, size_t m, const int16_t *a, size_t lda,
+        Float a_step, const QuantizedWeights &w, const Float *bias, Float *c,
+        size_t ldc_row, size_t ldc_col, bool parallelize)
+{
+    const size_t mr = vectorize::detail::kernels().qgemm_mr;
+    qgemm_packed(m, a_step, w, bias, c, ldc_row, ldc_col, parallelize,
+            [&](size_t pc, size_t kp, int32_t *dst) {
+        pack_a(trans_a, a, lda, m, w.k, pc, kp, mr, dst, parallelize);
+    });
+}
+
+void qgemm(bool trans_a, size_t m, const Float *a, size_t lda, Float a_step,
+        const QuantizedWeights &w, const Float *bias, Float *c,
+        size_t ldc_row, size_t ldc_col, bool parallelize)
+{
+    const auto &kt = vectorize::detail::kernels();
+    const size_t mr = kt.qgemm_mr;
+    const size_t kp_max = std::min(KP, (w.k + 1) / 2);
+    const Float inv_step = a_step > 0 ? Float(1) / a_step : Float(0);
+
+    // each block of A is quantized first, as 2 kp rows of m values with
+    // trans and as m rows of 2 kp otherwise
+    ScratchBuffer quantized_a;
+    int16_t *q = quantized_a.reserve_as<int16_t>(m * 2 * kp_max);
+    qgemm_packed(m, a_step, w, bias, c, ldc_row, ldc_col, parallelize,
+            [&](size_t pc, size_t kp, int32_t *dst) {
+        const size_t k0 = 2 * pc;
+        const size_t width = std::min(w.k, k0 + 2 * kp) - k0;
+        if (trans_a) {
+            for_i(parallelize, width, [&](size_t r) {
+                kt.quantize(a + (k0 + r) * lda, m, inv_step, q + r * m);
+            });
+        } else {
+            for_i(parallelize, m, [&](size_t i) {
+                kt.quantize(a + i * lda + k0, width, inv_step,
+                        q + i * 2 * kp);
+            });
+        }
+        pack_a(trans_a, q, trans_a ? m : 2 * kp, m, width, 0, kp, mr, dst,
+                parallelize);
+    });
+}
+
+}  // namespace kernels
+}  // namespace mnn
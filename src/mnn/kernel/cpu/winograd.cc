@@ -0,0 +1,370 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+#include "mnn/kernel/cpu/winograd.h"
+#include "mnn/kernel/cpu/gemm.h"
+#include "mnn/infra/scratch_buffer.h"
+
+namespace mnn {
+namespace kernels {
+
+namespace {
+
+// the transforms cost per channel what the GEMMs cost per pair of channels,
+// so they do not pay off for narrow layers
+const size_t winograd_min_channels = 32;
+
+// transformed tiles per GEMM, bounded so that the transformed input and
+// output of a block stay around this many elements
+const size_t winograd_block_elems = 1024 * 1024;
+
+// channels transformed together, one per SIMD lane
+const size_t lanes = 8;
+
+// Transforms of Lavin & Gray, "Fast Algorithms for Convolutional Neural
+// Networks": Y = A^T [(G g G^T) .* (B^T d B)] A. The filter transform runs
+// once per weight update and multiplies by G as is; the input and output
+// transforms run per tile, so B^T and A^T are spelled out without their
+// zeros, each applied to `lanes` channels at once along a stride.
+template<size_t M>
+struct Transform;
+
+template<>
+struct Transform<2> {
+    static const size_t alpha = 4;
+    static const Float G[4][3];
+
+    // y = B^T x
+    static void input(const Float *x, size_t xs, Float *y, size_t ys)
+    {
+        for (size_t l = 0; l < lanes; l++) {
+            Float x0 = x[l], x1 = x[xs + l], x2 = x[2 * xs + l], x3 = x[3 * xs + l];
+            y[l]          = x0 - x2;
+            y[ys + l]     = x1 + x2;
+            y[2 * ys + l] = x2 - x1;
+            y[3 * ys + l] = x1 - x3;
+        }
+    }
+
+    // y = A^T x
+    static void output(const Float *x, size_t xs, Float *y, size_t ys)
+    {
+        for (size_t l = 0; l < lanes; l++) {
+            Float x0 = x[l], x1 = x[xs + l], x2 = x[2 * xs + l], x3 = x[3 * xs + l];
+            y[l]      = x0 + x1 + x2;
+            y[ys + l] = x1 - x2 - x3;
+        }
+    }
+};
+
+const Float Transform<2>::G[4][3] = {
+    {Float(1),   Float(0),    Float(0)},
+    {Float(0.5), Float(0.5),  Float(0.5)},
+    {Float(0.5), Float(-0.5), Float(0.5)},
+    {Float(0),   Float(0),    Float(1)}
+};
+
+template<>
+struct Transform<4> {
+    static const size_t alpha = 6;
+    static const Float G[6][3];
+
+    // y = B^T x
+    static void input(const Float *x, size_t xs, Float *y, size_t ys)
+    {
+        for (size_t l = 0; l < lanes; l++) {
+            Float x0 = x[l], x1 = x[xs + l], x2 = x[2 * xs + l];
+            Float x3 = x[3 * xs + l], x4 = x[4 * xs + l], x5 = x[5 * xs + l];
+            y[l]          = 4 * x0 - 5 * x2 + x4;
+            y[ys + l]     = x3 + x4 - 4 * (x1 + x2);
+            y[2 * ys + l] = x4 - x3 + 4 * (x1 - x2);
+            y[3 * ys + l] = x4 - x2 + 2 * (x3 - x1);
+            y[4 * ys + l] = x4 - x2 + 2 * (x1 - x3);
+            y[5 * ys + l] = 4 * x1 - 5 * x3 + x5;
+        }
+    }
+
+    // y = A^T x
+    static void output(const Float *x, size_t xs, Float *y, size_t ys)
+    {
+        for (size_t l = 0; l < lanes; l++) {
+            Float x0 = x[l], x1 = x[xs + l], x2 = x[2 * xs + l];
+            Float x3 = x[3 * xs + l], x4 = x[4 * xs + l], x5 = x[5 * xs + l];
+            Float p12 = x1 + x2, m12 = x1 - x2;
+            Float p34 = x3 + x4, m34 = x3 - x4;
+            y[l]          = x0 + p12 + p34;
+            y[ys + l]     = m12 + 2 * m34;
+            y[2 * ys + l] = p12 + 4 * p34;
+            y[3 * ys + l] = m12 + 8 * m34 + x5;
+        }
+    }
+};
+
+const Float Transform<4>::G[6][3] = {
+    {Float(1) / 4,   Float(0),       Float(0)},
+    {Float(-1) / 6,  Float(-1) / 6,  Float(-1) / 6},
+    {Float(-1) / 6,  Float(1) / 6,   Float(-1) / 6},
+    {Float(1) / 24,  Float(1) / 12,  Float(1) / 6},
+    {Float(1) / 24,  Float(-1) / 12, Float(1) / 6},
+    {Float(0),       Float(0),       Float(1)}
+};
+
+// elements of one tile pass over the whole transformed input and output
+size_t tile_cost(size_t m, size_t ow, size_t oh)
+{
+    return ((ow + m - 1) / m) * ((oh + m - 1) / m) * (m + 2) * (m + 2);
+}
+
+template<size_t M>
+void transform_filter(Span<const Float> W, const ConvParams &params,
+        bool backward_data, WinogradFilter &filter)
+{
+    typedef Transform<M> T;
+    const size_t alpha = T::alpha;
+    size_t id = params.in.depth_;
+    size_t od = params.out.depth_;
+    size_t rows = backward_data ? id : od;
+    size_t cols = backward_data ? od : id;
+
+    filter.m = M;
+    filter.out_channels = rows;
+    filter.in_channels = cols;
+    filter.U.assign(alpha * alpha * rows * cols, Float(0));
+
+    for (size_t o = 0; o < od; o++) {
+        for (size_t inc = 0; inc < id; inc++) {
+            if (!params.tbl.is_connected(o, inc)) continue;
+
+            const Float *w = &W[params.weight.get_index(0, 0, id * o + inc)];
+            Float g[3][3];
+            for (size_t y = 0; y < 3; y++) {
+                for (size_t x = 0; x < 3; x++) {
+                    g[y][x] = backward_data ? w[(2 - y) * 3 + (2 - x)] : w[y * 3 + x];
+                }
+            }
+
+            // u = G g G^T
+            Float t[alpha][3], u[alpha][alpha];
+            for (size_t i = 0; i < alpha; i++) {
+                for (size_t j = 0; j < 3; j++) {
+                    t[i][j] = T::G[i][0] * g[0][j] + T::G[i][1] * g[1][j] +
+                              T::G[i][2] * g[2][j];
+                }
+            }
+            for (size_t i = 0; i < alpha; i++) {
+                for (size_t j = 0; j < alpha; j++) {
+                    u[i][j] = t[i][0] * T::G[j][0] + t[i][1] * T::G[j][1] +
+                              t[i][2] * T::G[j][2];
+                }
+            }
+
+            size_t r = backward_data ? inc : o;
+            size_t c = backward_data ? o : inc;
+            for (size_t xi = 0; xi < alpha * alpha; xi++) {
+                filter.U[(xi * cols + c) * rows + r] = u[xi / alpha][xi % alpha];
+            }
+        }
+    }
+}
+
+// out[s] (+)= conv(in[s], filter) + bias on every sample s, where out[y][x]
+// reads in[y - pad][x - pad] onwards and everything outside in is zero.
+// Without accumulate, a given epilogue runs on each output tile.
+// Tiles of all samples share the GEMMs, so the filters are packed once per
+// block rather than once per sample.
+template<size_t M>
+void winograd_conv(const WinogradFilter &filter, const Tensor<> &in, size_t iw,
+        size_t ih, size_t pad, const Float *bias, bool accumulate, Tensor<> &out,
+        size_t ow, size_t oh, bool parallelize, const Epilogue *epilogue)
+{
+    typedef Transform<M> T;
+    const size_t alpha = T::alpha;
+    const size_t a2 = alpha * alpha;
+    size_t ic = filter.in_channels;
+    size_t oc = filter.out_channels;
+    size_t tiles_w = (ow + M - 1) / M;
+    size_t sample_tiles = tiles_w * ((oh + M - 1) / M);
+    size_t tiles = sample_tiles * in.shape(0);
+    size_t block = std::max<size_t>(64, winograd_block_elems / (a2 * (ic + oc)));
+
+    ScratchBuffer buf;
+    Float *V = buf.reserve(a2 * (ic + oc) * std::min(block, tiles));
+
+    for (size_t t0 = 0; t0 < tiles; t0 += block) {
+        size_t nt = std::min(block, tiles - t0);
+        Float *Mt = V + a2 * ic * nt;
+
+        // V[xi][t][c] = B^T d B
+        for_i(parallelize, nt, [&](size_t t) {
+            size_t tile = (t0 + t) % sample_tiles;
+            long y0 = long((tile / tiles_w) * M) - long(pad);
+            long x0 = long((tile % tiles_w) * M) - long(pad);
+            bool inside = y0 >= 0 && x0 >= 0 && y0 + long(alpha) <= long(ih) &&
+                          x0 + long(alpha) <= long(iw);
+            const Float *sample = &in[(t0 + t) / sample_tiles][0];
+
+            for (size_t c0 = 0; c0 < ic; c0 += lanes) {
+                size_t nc = std::min(lanes, ic - c0);
+
+                alignas(64) Float d[alpha][alpha][lanes];
+                alignas(64) Float s[alpha][alpha][lanes];
+                for (size_t l = 0; l < lanes; l++) {
+                    if (l >= nc) {
+                        for (size_t xi = 0; xi < a2; xi++) d[xi / alpha][xi % alpha][l] = 0;
+                        continue;
+                    }
+                    const Float *plane = sample + (c0 + l) * ih * iw;
+                    for (size_t y = 0; y < alpha; y++) {
+                        long sy = y0 + long(y);
+                        for (size_t x = 0; x < alpha; x++) {
+                            long sx = x0 + long(x);
+                            bool valid = inside ||
+                                (sy >= 0 && sy < long(ih) && sx >= 0 && sx < long(iw));
+                            d[y][x][l] = valid ? plane[sy * long(iw) + sx] : Float(0);
+                        }
+                    }
+                }
+
+                for (size_t x = 0; x < alpha; x++) {
+                    T::input(d[0][x], alpha * lanes, s[0][x], alpha * lanes);
+                }
+                for (size_t y = 0; y < alpha; y++) {
+                    T::input(s[y][0], lanes, d[y][0], lanes);
+                }
+
+                for (size_t xi = 0; xi < a2; xi++) {
+                    const Float *v = d[xi / alpha][xi % alpha];
+                    std::copy(v, v + nc, V + (xi * nt + t) * ic + c0);
+                }
+            }
+        }, 1);
+
+        // M[xi] = V[xi] * U[xi], tiles x out channels so that the wide
+        // dimension of the GEMM is the channels rather than a few tiles
+        for_i(parallelize, a2, [&](size_t xi) {
+            gemm(false, false, nt, oc, ic, Float(1), V + xi * nt * ic, ic,
+                    &filter.U[xi * ic * oc], oc, Float(0), Mt + xi * nt * oc, oc);
+        }, 1);
+
+        // Y = A^T M A
+        for_i(parallelize, nt, [&](size_t t) {
+            size_t tile = (t0 + t) % sample_tiles;
+            size_t y0 = (tile / tiles_w) * M;
+            size_t x0 = (tile % tiles_w) * M;
+            size_t h = std::min(M, oh - y0);
+            size_t w = std::min(M, ow - x0);
+            Float *sample = &out[(t0 + t) / sample_tiles][0];
+
+            for (size_t o0 = 0; o0 < oc; o0 += lanes) {
+                size_t no = std::min(lanes, oc - o0);
+
+                alignas(64) Float m[alpha][alpha][lanes];
+                alignas(64) Float s[M][alpha][lanes];
+                alignas(64) Float y[M][M][lanes];
+                for (size_t xi = 0; xi < a2; xi++) {
+                    const Float *src = Mt + (xi * nt + t) * oc + o0;
+                    Float *dst = m[xi / alpha][xi % alpha];
+                    std::copy(src, src + no, dst);
+                    std::fill(dst + no, dst + lanes, Float(0));
+                }
+
+                for (size_t x = 0; x < alpha; x++) {
+                    T::output(m[0][x], alpha * lanes, s[0][x], alpha * lanes);
+                }
+                for (size_t i = 0; i < M; i++) {
+                    T::output(s[i][0], lanes, y[i][0], lanes);
+                }
+
+                if (epilogue) {
+                    // element-wise, so the whole tile goes at once
+                    for (size_t i = 0; i < M * M; i++) {
+                        for (size_t l = 0; l < no; l++) {
+                            y[i / M][i % M][l] += bias ? bias[o0 + l] : Float(0);
+                        }
+                    }
+                    (*epilogue)(Span<Float>(y[0][0], M * M * lanes));
+                }
+
+                for (size_t l = 0; l < no; l++) {
+                    Float *plane = sample + (o0 + l) * oh * ow;
+                    Float b = (bias && !epilogue) ? bias[o0 + l] : Float(0);
+                    for (size_t i = 0; i < h; i++) {
+                        Float *line = plane + (y0 + i) * ow + x0;
+                        for (size_t j = 0; j < w; j++) {
+                            line[j] = (accumulate ? line[j] : Float(0)) + y[i][j][l] + b;
+                        }
+                    }
+                }
+            }
+        }, 1);
+    }
+}
+
+void winograd_conv(const WinogradFilter &filter, const Tensor<> &in, size_t iw,
+        size_t ih, size_t pad, const Float *bias, bool accumulate, Tensor<> &out,
+        size_t ow, size_t oh, bool parallelize,
+        const Epilogue *epilogue = nullptr)
+{
+    if (filter.m == 4) {
+        winograd_conv<4>(filter, in, iw, ih, pad, bias, accumulate, out, ow,
+                oh, parallelize, epilogue);
+    } else {
+        winograd_conv<2>(filter, in, iw, ih, pad, bias, accumulate, out, ow,
+                oh, parallelize, epilogue);
+    }
+}
+
+}  // namespace
+
+bool conv2d_use_winograd(const ConvParams &params)
+{
+    return params.weight.width_ == 3 && params.weight.height_ == 3 &&
+           params.w_stride == 1 && params.h_stride == 1 &&
+           params.w_dilation == 1 && params.h_dilation == 1 &&
+           params.in.depth_ >= winograd_min_channels &&
+           params.out.depth_ >= winograd_min_channels;
+}
+
+size_t winograd_tile_size(const ConvParams &params)
+{
+    size_t ow = params.out.width_;
+    size_t oh = params.out.height_;
+    return tile_cost(4, ow, oh) < tile_cost(2, ow, oh) ? 4 : 2;
+}
+
+void winograd_transform_filter(Span<const Float> W, const ConvParams &params,
+        bool backward_data, WinogradFilter &filter)
+{
+    if (winograd_tile_size(params) == 4) {
+        transform_filter<4>(W, params, backward_data, filter);
+    } else {
+        transform_filter<2>(W, params, backward_data, filter);
+    }
+}
+
+void conv2d_winograd_forward(const Tensor<> &in_data,
+        const WinogradFilter &filter, Span<const Float> bias,
+        Tensor<> &out_data, const ConvParams &params, bool parallelize,
+        const Epilogue *epilogue)
+{
+    winograd_conv(filter, in_data, params.in_padded.width_,
+            params.in_padded.height_, 0, params.has_bias ? &bias[0] : nullptr,
+            false, out_data, params.out.width_, params.out.height_,
+            parallelize, epilogue);
+}
+
+void conv2d_winograd_backward_data(const Tensor<> &curr_delta,
+        const WinogradFilter &filter, Tensor<> &prev_delta,
+        const ConvParams &params, bool parallelize)
+{
+    winograd_conv(filter, curr_delta, params.out.width_, params.out.height_,
+            2, nullptr, true, prev_delta, params.in_padded.width_,
+            params.in_padded.height_, parallelize);
+}
+
+}  // namespace kernels
+}  // namespace mnn
@@ -18,26 +18,35 @@ Conv2dGradOp::Conv2dGradOp(const OpKernelConstruction &context) : OpKernel(
 
 void Conv2dGradOp::compute(OpKernelContext &context)
 {
-    auto params = OpKernel::params_->conv();
+    const auto &params = OpKernel::params_->conv();
 
     // incoming/outcoming data
-    const Matrix &prev_out = context.input(0);
-    const Matrix &W = context.input(1);
-    Matrix &dW = context.input_grad(1);
-    Matrix &db = context.input_grad(2);
-    Matrix &prev_delta = context.input_grad(0);
-    Matrix &curr_delta = context.output_grad(0);
-
-    fill_tensor(prev_delta, Float { 0 });
+    const Tensor<> &prev_out = context.input(0);
+    const Tensor<> &W = context.input(1);
+    Tensor<> &dW = context.input_grad(1);
+    Tensor<> &db = context.input_grad(2);
+    Tensor<> &prev_delta = context.input_grad(0);
+    Tensor<> &curr_delta = context.output_grad(0);
+
+    prev_delta.fill(Float { 0 });
     const BackendType engine = context.engine();
 
     if (engine == BackendType::CPU) {
+        if (winograd_.empty() && kernels::conv2d_use_winograd(params)) {
+            kernels::winograd_transform_filter(W[0], params, true, winograd_);
+        }
         kernels::conv2d_op_internal(prev_out, W[0], dW, db, curr_delta,
-                prev_delta, params, context.parallelize());
+                prev_delta, params, context.parallelize(),
+                winograd_.empty() ? nullptr : &winograd_);
     } else {
         throw MnnError("Not supported engine: " + to_string(engine));
     }
 }
 
+void Conv2dGradOp::invalidate()
+{
+    winograd_.clear();
+}
+
 }
 // namespace mnn
@@ -16,25 +16,52 @@ Conv2dOp::Conv2dOp(const OpKernelConstruction &context) : OpKernel(context)
 
 void Conv2dOp::compute(OpKernelContext &context)
 {
-    auto params = OpKernel::params_->conv();
+    const auto &params = OpKernel::params_->conv();
 
     // incomimg/outcoming data
-    const Matrix &in_data = context.input(0);
-    const Matrix &W = context.input(1);
-    const Matrix &bias = context.input(2);
-    Matrix &out_data = context.output(0);
+    const Tensor<> &in_data = context.input(0);
+    const Tensor<> &W = context.input(1);
+    const Tensor<> &bias = context.input(2);
+    Tensor<> &out_data = context.output(0);
 
     // initialize outputs
-    fill_tensor(out_data, Float { 0 });
+    out_data.fill(Float { 0 });
     const BackendType engine = context.engine();
 
-    if (engine == BackendType::CPU) {
+    if (engine == BackendType::CPU && context.input_step() > 0) {
+        if (quantized_.empty()) {
+            kernels::conv2d_quantize_weights(W[0], params, quantized_,
+                    context.parallelize());
+        }
+        kernels::conv2d_int8_forward(in_data, quantized_, bias[0], out_data,
+                params, context.input_step(), context.parallelize(),
+                context.epilogue());
+    } else if (engine == BackendType::CPU) {
+        if (winograd_.empty() && kernels::conv2d_use_winograd(params)) {
+            kernels::winograd_transform_filter(W[0], params, false, winograd_);
+        }
         kernels::conv2d_op_internal(in_data, W[0], bias[0], out_data, params,
-                context.parallelize());
+                context.parallelize(), winograd_.empty() ? nullptr : &winograd_,
+                context.epilogue());
     } else {
         throw MnnError("Not supported engine: " + to_string(engine));
     }
 }
 
+void Conv2dOp::invalidate()
+{
+    winograd_.clear();
+    quantized_.clear();
+}
+
+void Conv2dOp::prepare_int8(Span<const Float> W, bool parallelize)
+{
+    if (quantized_.empty()) {
+        kernels::conv2d_quantize_weights(W, OpKernel::params_->conv(),
+                quantized_, parallelize);
+    }
+    winograd_.clear();
+}
+
 }
 // namespace mnn
@@ -20,15 +20,15 @@ void FullyConnectedGradOp::compute(OpKernelContext &context)
     auto params = OpKernel::params_->fully();
 
     // incoming/outcoming data
-    const Matrix &prev_out = context.input(0);
-    const Matrix &W = context.input(1);
-    Matrix &dW = context.input_grad(1);
-    Matrix *db = params.has_bias_ ? &context.input_grad(2) : nullptr;
-    Matrix &prev_delta = context.input_grad(0);
-    Matrix &curr_delta = context.output_grad(0);
-    Matrix dummy;  // need lvalue for non-const reference
+    const Tensor<> &prev_out = context.input(0);
+    const Tensor<> &W = context.input(1);
+    Tensor<> &dW = context.input_grad(1);
+    Tensor<> *db = params.has_bias_ ? &context.input_grad(2) : nullptr;
+    Tensor<> &prev_delta = context.input_grad(0);
+    Tensor<> &curr_delta = context.output_grad(0);
+    Tensor<> dummy;  // need lvalue for non-const reference
 
-    fill_tensor(prev_delta, Float { 0 });
+    prev_delta.fill(Float { 0 });
     const BackendType engine = context.engine();
 
     if (engine == BackendType::CPU) {
@@ -20,21 +20,56 @@ void FullyConnectedOp::compute(OpKernelContext &context)
     auto params = OpKernel::params_->fully();
 
     // incomimg/outcoming data
-    const Matrix &in_data = context.input(0);
-    const Matrix &W = context.input(1);
-    const Matrix *bias = params.has_bias_ ? &context.input(2) : nullptr;
-    Matrix &out_data = context.output(0);
+    const Tensor<> &in_data = context.input(0);
+    const Tensor<> &W = context.input(1);
+    const Tensor<> *bias = params.has_bias_ ? &context.input(2) : nullptr;
+    Tensor<> &out_data = context.output(0);
 
-    fill_tensor(out_data, Float { 0 });
+    out_data.fill(Float { 0 });
     const BackendType engine = context.engine();
 
-    if (engine == BackendType::CPU) {
+    if (engine == BackendType::CPU && context.input_step() > 0) {
+        if (quantized_.empty()) {
+            kernels::quantize_weights(false, params.in_size_,
+                    params.out_size_, W.data(), params.out_size_, quantized_,
+                    context.parallelize());
+        }
+        kernels::fully_connected_int8_forward(in_data, quantized_,
+                params.has_bias_ ? (*bias)[0] : Span<const Float>(), out_data,
+                params, context.input_step(), context.parallelize(),
+                context.epilogue());
+    } else if (engine == BackendType::CPU &&
+            context.weight_precision() != Precision::FLOAT) {
+        if (half_.precision != context.weight_precision()) {
+            kernels::fully_connected_half_weights(W[0],
+                    context.weight_precision(), half_);
+        }
+        kernels::fully_connected_half_forward(in_data, half_,
+                params.has_bias_ ? (*bias)[0] : Span<const Float>(), out_data,
+                params, context.parallelize(), context.epilogue());
+    } else if (engine == BackendType::CPU) {
         kernels::fully_connected_op_internal(in_data, W[0],
-                params.has_bias_ ? (*bias)[0] : Vector(), out_data, params,
-                context.parallelize());
+                params.has_bias_ ? (*bias)[0] : Span<const Float>(), out_data,
+                params, context.parallelize(), context.epilogue());
     } else {
         throw MnnError("Not supported engine: " + to_string(engine));
     }
 }
 
+void FullyConnectedOp::invalidate()
+{
+    quantized_.clear();
+    half_.clear();
+}
+
+void FullyConnectedOp::prepare_int8(Span<const Float> W, bool parallelize)
+{
+    auto params = OpKernel::params_->fully();
+    if (quantized_.empty()) {
+        kernels::quantize_weights(false, params.in_size_, params.out_size_,
+                W.data(), params.out_size_, quantized_, parallelize);
+    }
+    half_.clear();
+}
+
 }  // namespace mnn
@@ -0,0 +1,37 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+#include "mnn/op/max_pooling_grad_op.h"
+#include "mnn/kernel/cpu/maxpool_op_cpu.h"
+
+namespace mnn {
+
+MaxPoolingGradOp::MaxPoolingGradOp(const OpKernelConstruction &context) : OpKernel(
+        context)
+{
+}
+
+void MaxPoolingGradOp::compute(OpKernelContext &context)
+{
+    const auto &params = OpKernel::params_->maxpool();
+
+    // incoming/outcoming data
+    Tensor<> &prev_delta = context.input_grad(0);
+    const Tensor<> &curr_delta = context.output_grad(0);
+
+    prev_delta.fill(Float { 0 });
+    const BackendType engine = context.engine();
+
+    if (engine == BackendType::CPU) {
+        kernels::maxpool_grad_op_internal(curr_delta, prev_delta, params,
+                context.parallelize());
+    } else {
+        throw MnnError("Not supported engine: " + to_string(engine));
+    }
+}
+
+}  // namespace mnn
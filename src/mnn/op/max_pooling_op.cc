@@ -0,0 +1,36 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+#include "mnn/op/max_pooling_op.h"
+#include "mnn/kernel/cpu/maxpool_op_cpu.h"
+
+namespace mnn {
+
+MaxPoolingOp::MaxPoolingOp(const OpKernelConstruction &context) : OpKernel(
+        context)
+{
+}
+
+void MaxPoolingOp::compute(OpKernelContext &context)
+{
+    auto &params = OpKernel::params_->maxpool();
+
+    // incomimg/outcoming data
+    const Tensor<> &in_data = context.input(0);
+    Tensor<> &out_data = context.output(0);
+
+    const BackendType engine = context.engine();
+
+    if (engine == BackendType::CPU) {
+        kernels::maxpool_op_internal(in_data, out_data, params,
+                context.parallelize());
+    } else {
+        throw MnnError("Not supported engine: " + to_string(engine));
+    }
+}
+
+}  // namespace mnn
@@ -0,0 +1,243 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Sends samples through a BatchPredictor: when batches go, what their
+// futures hold, and what the destructor does with queued samples.
+
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// long enough that a batch waiting for it means the test failed
+const std::chrono::microseconds forever = std::chrono::seconds(30);
+
+// a forward pass doubling its input that records the batch sizes, and
+// throws on batches with a negative first element
+class Doubler {
+public:
+    std::vector<Matrix> operator()(const std::vector<Matrix> &in) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sizes_.push_back(in.size());
+        }
+        std::vector<Matrix> out(in);
+        for (auto &m : out) {
+            if (m[0][0] < 0) throw MnnError("negative input");
+            for (auto &x : m[0]) x *= 2;
+        }
+        return out;
+    }
+
+    std::vector<size_t> sizes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sizes_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<size_t> sizes_;
+};
+
+Vector sample(Float first)
+{
+    return Vector{first, 1, 2};
+}
+
+// what f holds, or nothing if it holds an exception
+Vector value(std::future<Vector> &f)
+{
+    try {
+        return f.get();
+    } catch (const std::exception &) {
+        return Vector();
+    }
+}
+
+// whether f holds the MnnError of a forward pass
+bool holds_error(std::future<Vector> &f)
+{
+    try {
+        f.get();
+    } catch (const MnnError &) {
+        return true;
+    } catch (const std::exception &) {
+    }
+    return false;
+}
+
+bool ready(std::future<Vector> &f, std::chrono::milliseconds wait)
+{
+    return f.wait_for(wait) == std::future_status::ready;
+}
+
+BatchPredictor::Forward forward_of(const std::shared_ptr<Doubler> &d)
+{
+    return [d](const std::vector<Matrix> &in) { return (*d)(in); };
+}
+
+// a full batch runs without waiting for max_delay
+int full_batch_goes_early()
+{
+    auto doubler = std::make_shared<Doubler>();
+    BatchPredictor predictor(forward_of(doubler), 3, 4, forever);
+    std::vector<std::future<Vector>> out;
+    for (int i = 0; i < 4; i++) out.push_back(predictor.predict(sample(i)));
+
+    int failures = 0;
+    for (int i = 0; i < 4; i++) {
+        if (!ready(out[i], std::chrono::milliseconds(5000))) {
+            return check(false, "a full batch waited for max_delay");
+        }
+        failures += check(value(out[i]) == Vector{Float(2 * i), 2, 4},
+                          "wrong output from a full batch");
+    }
+    failures += check(doubler->sizes() == std::vector<size_t>{4},
+                      "the 4 samples didn't run as one batch");
+    return failures;
+}
+
+// a partial batch waits for max_delay, then runs as it is
+int partial_batch_flushed_at_max_delay()
+{
+    const auto delay = std::chrono::milliseconds(100);
+    auto doubler = std::make_shared<Doubler>();
+    BatchPredictor predictor(forward_of(doubler), 3, 8, delay);
+    const Clock::time_point start = Clock::now();
+    std::vector<std::future<Vector>> out;
+    for (int i = 0; i < 3; i++) out.push_back(predictor.predict(sample(i)));
+
+    if (!ready(out[0], std::chrono::milliseconds(5000))) {
+        return check(false, "a partial batch wasn't flushed");
+    }
+    const auto waited = Clock::now() - start;
+    int failures = check(waited >= delay,
+                         "a partial batch went before max_delay");
+    for (int i = 0; i < 3; i++) {
+        failures += check(value(out[i]) == Vector{Float(2 * i), 2, 4},
+                          "wrong output from a partial batch");
+    }
+    failures += check(doubler->sizes() == std::vector<size_t>{3},
+                      "the 3 samples didn't run as one batch");
+    return failures;
+}
+
+// a throwing forward pass fails every future of its batch, and only those
+int exception_reaches_its_batch()
+{
+    auto doubler = std::make_shared<Doubler>();
+    BatchPredictor predictor(forward_of(doubler), 3, 3, forever);
+    std::vector<std::future<Vector>> bad, good;
+    bad.push_back(predictor.predict(sample(1)));
+    bad.push_back(predictor.predict(sample(-1)));
+    bad.push_back(predictor.predict(sample(2)));
+    for (int i = 0; i < 3; i++) good.push_back(predictor.predict(sample(i)));
+
+    int failures = 0;
+    for (auto &f : bad) {
+        failures += check(holds_error(f),
+                          "a future of the failed batch holds no exception");
+    }
+    for (int i = 0; i < 3; i++) {
+        failures += check(value(good[i]) == Vector{Float(2 * i), 2, 4},
+                          "the batch after the failed one failed");
+    }
+    return failures;
+}
+
+// samples of the wrong size throw in predict() and leave the rest alone
+int size_mismatch_throws()
+{
+    auto doubler = std::make_shared<Doubler>();
+    BatchPredictor predictor(forward_of(doubler), 3, 1, forever);
+    int failures = check(throws([&] { predictor.predict(Vector(4)); }),
+                         "a sample of size 4 didn't throw");
+    failures += check(throws([&] { predictor.predict(Vector()); }),
+                      "an empty sample didn't throw");
+    std::future<Vector> future = predictor.predict(sample(3));
+    failures += check(value(future) == Vector{6, 2, 4},
+                      "the predictor failed after a size mismatch");
+    return failures;
+}
+
+// the destructor runs the queued samples at once instead of dropping them
+int destructor_drains()
+{
+    auto doubler = std::make_shared<Doubler>();
+    std::vector<std::future<Vector>> out;
+    const Clock::time_point start = Clock::now();
+    {
+        BatchPredictor predictor(forward_of(doubler), 3, 100, forever);
+        for (int i = 0; i < 5; i++) out.push_back(predictor.predict(sample(i)));
+    }
+    int failures = check(Clock::now() - start < std::chrono::seconds(5),
+                         "the destructor waited for max_delay");
+    for (int i = 0; i < 5; i++) {
+        if (!ready(out[i], std::chrono::milliseconds(0))) {
+            return check(false, "a queued sample was dropped");
+        }
+        failures += check(value(out[i]) == Vector{Float(2 * i), 2, 4},
+                          "wrong output from a drained sample");
+    }
+    return failures;
+}
+
+// batched predictions of a network are its predictions of each sample
+int network_outputs()
+{
+    Network<Sequential> net;
+    make_fc_net(net);
+    std::vector<Vector> in;
+    std::vector<Label> labels;
+    make_fc_data(20, 7, in, labels);
+    std::vector<Vector> expected;
+    for (auto &v : in) expected.push_back(net.predict(v));
+
+    std::vector<std::future<Vector>> out;
+    {
+        BatchPredictor predictor(net, 8, std::chrono::milliseconds(1));
+        for (auto &v : in) out.push_back(predictor.predict(v));
+    }
+    int failures = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+        const Vector got = value(out[i]);
+        bool same = got.size() == expected[i].size();
+        for (size_t j = 0; same && j < got.size(); j++) {
+            same = std::abs(got[j] - expected[i][j]) <= 1e-5f;
+        }
+        failures += check(same, "batched prediction " + std::to_string(i) +
+                          " differs from predict()");
+    }
+    return failures;
+}
+
+}  // namespace
+
+int main()
+{
+    int failures = full_batch_goes_early();
+    failures += partial_batch_flushed_at_max_delay();
+    failures += exception_reaches_its_batch();
+    failures += size_mismatch_throws();
+    failures += destructor_drains();
+    failures += network_outputs();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Checkpoints training midway through an epoch, restores the checkpoint
+// into another network, checks that training on after a checkpoint
+// leaves it alone and that resuming from it ends where training without
+// stopping does, and resumes from checkpoints that don't fit the
+// training set or are truncated or corrupted.
+
+#include <cstdio>
+#include <string>
+
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+const char *const checkpoint_path = "checkpoint_test.ckpt";
+const char *const corrupt_path = "checkpoint_test_corrupt.ckpt";
+
+const size_t batch_size = 8;
+
+std::vector<Layer *> layers_of(Network<Sequential> &net)
+{
+    return std::vector<Layer *>(net.begin(), net.end());
+}
+
+// a network and an optimizer ready for Checkpointer::restore()
+void prepare(Network<Sequential> &net, Adagrad &opt)
+{
+    make_fc_net(net);
+    opt.reset();
+    for (auto l : net) l->register_weights(&opt);
+}
+
+// Trains 4 minibatches of the first epoch, checkpointing every 2, and
+// checks that the last checkpoint restores those weights and that state.
+int restore(Network<Sequential> &trained, Adagrad &trained_opt)
+{
+    std::vector<Vector> in;
+    std::vector<Label> labels;
+    make_fc_data(64, 3, in, labels);
+
+    trained.set_checkpoint(checkpoint_path, 2);
+    size_t batches = 0;
+    trained.train<Mse>(trained_opt, in, labels, batch_size, 1, [&] {
+        if (++batches == 4) trained.stop_ongoing_training();
+    }, nop);
+    trained.set_checkpoint("");
+
+    Network<Sequential> net;
+    Adagrad opt;
+    prepare(net, opt);
+    CheckpointPosition pos =
+        Checkpointer::restore(checkpoint_path, layers_of(net), opt);
+
+    int failures = 0;
+    failures += check(pos.epoch == 0 && pos.sample == 4 * batch_size,
+                      "restored the wrong position");
+    auto l = trained.begin();
+    for (Layer *r : net) {
+        failures += check(r->has_same_weights(**l, 0),
+                          "restored other weights");
+        ++l;
+    }
+    auto expected = trained_opt.state_arrays();
+    auto state = opt.state_arrays();
+    failures += check(expected.size() == state.size(),
+                      "restored another optimizer state");
+    for (size_t i = 0; i < state.size() && i < expected.size(); i++) {
+        failures += check(*state[i] == *expected[i],
+                          "restored another optimizer state");
+    }
+    return failures;
+}
+
+// resuming the checkpoint on samples samples in minibatches of batch
+// must throw MnnError
+int rejects_position(size_t samples, size_t batch, const std::string &what)
+{
+    std::vector<Vector> in;
+    std::vector<Label> labels;
+    make_fc_data(samples, 3, in, labels);
+
+    Network<Sequential> net;
+    make_fc_net(net);
+    net.resume_from(checkpoint_path);
+    Adagrad opt;
+    return check(throws([&] {
+                     net.train<Mse>(opt, in, labels, batch, 1);
+                 }), "resumed a checkpoint " + what);
+}
+
+// an optimizer without range updates, whose steps preserve the weights a
+// layer at a time
+struct PlainSgd: public Optimizer {
+    void update(const Vector &dW, Vector &W, bool parallelize) override
+    {
+        MNN_UNREFERENCED_PARAMETER(parallelize);
+        for (size_t i = 0; i < W.size(); i++) {
+            W[i] -= Float(0.01) * dW[i];
+        }
+    }
+};
+
+// Checkpoints every 2 minibatches and goes on for one more after the
+// last checkpoint, whose update comes right after it on a network this
+// small: the file must hold the weights from before that update.
+template <typename Optimizer>
+int keeps_checkpointed_weights(const char *name)
+{
+    std::vector<Vector> in;
+    std::vector<Label> labels;
+    make_fc_data(64, 4, in, labels);
+
+    Network<Sequential> net, checkpointed;
+    make_fc_net(net);
+    make_fc_net(checkpointed);
+    Optimizer opt;
+    net.set_checkpoint(checkpoint_path, 2);
+    size_t batches = 0;
+    net.train<Mse>(opt, in, labels, batch_size, 1, [&] {
+        // the checkpoint after this minibatch
+        if (++batches == 4) copy_weights(net, checkpointed);
+        if (batches == 5) net.stop_ongoing_training();
+    }, nop);
+    net.set_checkpoint("");
+
+    Network<Sequential> restored;
+    make_fc_net(restored);
+    Optimizer restored_opt;
+    restored_opt.reset();
+    for (auto l : restored) l->register_weights(&restored_opt);
+    Checkpointer::restore(checkpoint_path, layers_of(restored), restored_opt);
+
+    int failures = 0;
+    failures += check(same_weights(restored, checkpointed, 0),
+                      std::string(name) + " checkpoint has updated weights");
+    failures += check(!same_weights(net, checkpointed, 0),
+                      std::string(name) + " didn't train after the checkpoint");
+    return failures;
+}
+
+// Trains 2 epochs without stopping, and again stopping after 5
+// minibatches and resuming from the checkpoint after the 4th, on one
+// worker so the sums are in the same order: the weights must be equal.
+int resumes_exactly()
+{
+    std::vector<Vector> in;
+    std::vector<Label> labels;
+    make_fc_data(64, 5, in, labels);
+
+    Network<Sequential> straight, stopped, resumed;
+    make_fc_net(straight);
+    make_fc_net(stopped);
+    make_fc_net(resumed);
+    copy_weights(straight, stopped);
+
+    Adagrad straight_opt, stopped_opt, resumed_opt;
+    straight.train<Mse>(straight_opt, in, labels, batch_size, 2, nop, nop,
+                        false, 1);
+
+    stopped.set_checkpoint(checkpoint_path, 2);
+    size_t batches = 0;
+    stopped.train<Mse>(stopped_opt, in, labels, batch_size, 2, [&] {
+        if (++batches == 5) stopped.stop_ongoing_training();
+    }, nop, false, 1);
+    stopped.set_checkpoint("");
+
+    resumed.resume_from(checkpoint_path);
+    resumed.train<Mse>(resumed_opt, in, labels, batch_size, 2, nop, nop,
+                       false, 1);
+
+    int failures = 0;
+    failures += check(same_weights(resumed, straight, 0),
+                      "resumed training ends with other weights");
+    auto expected = straight_opt.state_arrays();
+    auto state = resumed_opt.state_arrays();
+    for (size_t i = 0; i < state.size() && i < expected.size(); i++) {
+        failures += check(*state[i] == *expected[i],
+                          "resumed training ends with another state");
+    }
+    return failures;
+}
+
+// restoring bytes must throw MnnError
+int rejects(const std::string &bytes, const std::string &what)
+{
+    write_file(corrupt_path, bytes);
+    Network<Sequential> net;
+    Adagrad opt;
+    prepare(net, opt);
+    return check(throws([&] {
+                     Checkpointer::restore(corrupt_path, layers_of(net), opt);
+                 }), "restored a checkpoint with " + what);
+}
+
+int corrupt_files()
+{
+    const std::string good = read_file(checkpoint_path);
+    int failures = 0;
+
+    failures += rejects(good.substr(0, 32), "a truncated header");
+    failures += rejects(good.substr(0, good.size() / 2), "truncated arrays");
+
+    std::string bad = good;
+    bad[0] = 'X';
+    failures += rejects(bad, "a bad magic");
+
+    std::remove(corrupt_path);
+    return failures;
+}
+
+}  // namespace
+
+int main()
+{
+    Network<Sequential> net;
+    Adagrad opt;
+    make_fc_net(net);
+
+    int failures = restore(net, opt);
+    failures += keeps_checkpointed_weights<Adagrad>("Adagrad");
+    failures += keeps_checkpointed_weights<Adam>("Adam");
+    failures += keeps_checkpointed_weights<PlainSgd>("PlainSgd");
+    failures += resumes_exactly();
+    failures += rejects_position(16, batch_size, "past the training set");
+    failures += rejects_position(64, 12, "with another batch size");
+    failures += corrupt_files();
+
+    std::remove(checkpoint_path);
+    return failures == 0 ? 0 : 1;
+}
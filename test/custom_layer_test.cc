@@ -0,0 +1,89 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Trains a network with a user-defined layer that doesn't override
+// Layer::clone() on several workers, which can't be replicated and so
+// must be trained unsharded, to the weights of training on one worker.
+
+#include <cmath>
+#include <cstdio>
+
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+class SoftsignLayer: public ActivationLayer {
+public:
+    using ActivationLayer::ActivationLayer;
+
+private:
+    std::string layer_type() const override
+    {
+        return "softsign-activation";
+    }
+
+    void forward_activation(Span<const Float> x, Span<Float> y) override
+    {
+        for (size_t j = 0; j < x.size(); j++) {
+            y[j] = x[j] / (Float(1) + std::abs(x[j]));
+        }
+    }
+
+    void backward_activation(Span<const Float> x, Span<const Float> y,
+            Span<Float> dx, Span<const Float> dy) override
+    {
+        for (size_t j = 0; j < x.size(); j++) {
+            // 1 / (1 + |x|)^2, in terms of y = x / (1 + |x|)
+            Float d = Float(1) - std::abs(y[j]);
+            dx[j] = dy[j] * d * d;
+        }
+    }
+
+    std::pair<Float, Float> scale() const override
+    {
+        return std::make_pair(Float(-0.8), Float(0.8));
+    }
+};
+
+}  // namespace
+
+int main()
+{
+    Network<Sequential> net, single;
+    make_fc_net<SoftsignLayer>(net);
+    make_fc_net<SoftsignLayer>(single);
+    copy_weights(net, single);
+
+    std::vector<Vector> in;
+    std::vector<Label> labels;
+    make_fc_data(64, 1, in, labels);
+
+    Adagrad opt, single_opt;
+    try {
+        if (!net.train<Mse>(opt, in, labels, 16, 2, nop, nop, false, 4) ||
+            !single.train<Mse>(single_opt, in, labels, 16, 2, nop, nop, false,
+                               1)) {
+            std::printf("training failed\n");
+            return 1;
+        }
+    } catch (const MnnError &e) {
+        std::printf("training threw: %s\n", e.what());
+        return 1;
+    }
+    for (auto &x : net.predict(in[0])) {
+        if (!std::isfinite(x)) {
+            std::printf("non-finite prediction\n");
+            return 1;
+        }
+    }
+    return check(same_weights(net, single, 0),
+                 "training on several workers changed the weights");
+}
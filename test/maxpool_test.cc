@@ -0,0 +1,126 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Compares the max-pooling forward pass and its gradient with a brute
+// force search of every window, on the SIMD tier MNN_ISA picks.
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+struct Case {
+    const char *name;
+    size_t in_w, in_h, channels;
+    size_t pool_x, pool_y, stride_x, stride_y;
+    bool ceil_mode;
+    Padding pad;
+};
+
+// the input index of the max of the window of output (ox, oy, c); windows
+// start at multiples of the stride and are clipped by the input's edges
+size_t brute_force_argmax(const Vector &in, const Case &c, size_t ox,
+                          size_t oy, size_t ch)
+{
+    const Shape3d in_dim(c.in_w, c.in_h, c.channels);
+    size_t best = in_dim.get_index(ox * c.stride_x, oy * c.stride_y, ch);
+    for (size_t y = oy * c.stride_y;
+         y < std::min(oy * c.stride_y + c.pool_y, c.in_h); y++) {
+        for (size_t x = ox * c.stride_x;
+             x < std::min(ox * c.stride_x + c.pool_x, c.in_w); x++) {
+            const size_t i = in_dim.get_index(x, y, ch);
+            if (in[i] > in[best]) best = i;
+        }
+    }
+    return best;
+}
+
+int run(const Case &c, std::mt19937 &rng)
+{
+    const std::string name = c.name;
+    MaxPoolingLayer pool(c.in_w, c.in_h, c.channels, c.pool_x, c.pool_y,
+                         c.stride_x, c.stride_y, c.ceil_mode, c.pad);
+    const Shape3d out_dim = pool.out_shape()[0];
+    const size_t samples = 3;
+
+    std::uniform_real_distribution<Float> u(-1, 1);
+    std::vector<Vector> in(samples, Vector(c.in_w * c.in_h * c.channels));
+    Matrix out_grad(samples, Vector(out_dim.size()));
+    for (auto &v : in) {
+        for (auto &x : v) x = u(rng);
+    }
+    for (auto &v : out_grad) {
+        for (auto &x : v) x = u(rng);
+    }
+
+    pool.setup(false);
+    std::vector<const Vector*> data;
+    for (auto &v : in) data.push_back(&v);
+    pool.set_in_data(&data, 1);
+    pool.forward();
+    std::vector<const Tensor<>*> out;
+    pool.output(out);
+    const Matrix in_grad = pool.backward({out_grad})[0];
+
+    int failures = 0;
+    for (size_t s = 0; s < samples; s++) {
+        Vector expected_grad(in[s].size(), Float(0));
+        for (size_t ch = 0; ch < out_dim.depth_; ch++) {
+            for (size_t oy = 0; oy < out_dim.height_; oy++) {
+                for (size_t ox = 0; ox < out_dim.width_; ox++) {
+                    const size_t o = out_dim.get_index(ox, oy, ch);
+                    const size_t i = brute_force_argmax(in[s], c, ox, oy, ch);
+                    expected_grad[i] += out_grad[s][o];
+                    if ((*out[0])[s][o] != in[s][i]) {
+                        failures += check(false, name + ": output (" +
+                                std::to_string(ox) + ", " +
+                                std::to_string(oy) + ", " +
+                                std::to_string(ch) + ") isn't the max");
+                    }
+                }
+            }
+        }
+        // overlapping windows add up in the same order either way
+        failures += check(in_grad[s] == expected_grad,
+                          name + ": the gradient isn't scattered to the "
+                          "maxima of sample " + std::to_string(s));
+    }
+    return failures;
+}
+
+}  // namespace
+
+int main()
+{
+    if (!requested_isa_active()) {
+        return skipped;
+    }
+    const Case cases[] = {
+        {"2x2 stride 2", 8, 6, 3, 2, 2, 2, 2, false, Padding::VALID},
+        {"3x3 stride 1", 7, 5, 2, 3, 3, 1, 1, false, Padding::VALID},
+        {"3x3 stride 2 overlapping", 9, 9, 3, 3, 3, 2, 2, false,
+         Padding::VALID},
+        {"3x3 stride 2 ceil_mode", 8, 8, 2, 3, 3, 2, 2, true,
+         Padding::VALID},
+        {"3x3 stride 2 same", 7, 6, 2, 3, 3, 2, 2, false, Padding::SAME},
+        {"2x3 stride 3x1", 10, 5, 2, 2, 3, 3, 1, false, Padding::VALID},
+        {"3x2 stride 2x1 ceil_mode", 10, 5, 2, 3, 2, 2, 1, true,
+         Padding::VALID},
+    };
+    std::mt19937 rng(6);
+    int failures = 0;
+    for (const Case &c : cases) failures += run(c, rng);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Runs a network with and without memory planning, in the TESTING and
+// the TRAINING phase, and compares the outputs, the weight gradients and
+// the trained weights. It includes a user-defined activation whose
+// derivative reads its input, which mustn't be run in place.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+const size_t batch = 6;
+
+class SoftsignLayer: public ActivationLayer {
+public:
+    using ActivationLayer::ActivationLayer;
+
+private:
+    std::string layer_type() const override
+    {
+        return "softsign-activation";
+    }
+
+    void forward_activation(Span<const Float> x, Span<Float> y) override
+    {
+        for (size_t j = 0; j < x.size(); j++) {
+            y[j] = x[j] / (Float(1) + std::abs(x[j]));
+        }
+    }
+
+    void backward_activation(Span<const Float> x, Span<const Float> y,
+            Span<Float> dx, Span<const Float> dy) override
+    {
+        for (size_t j = 0; j < y.size(); j++) {
+            Float d = Float(1) + std::abs(x[j]);
+            dx[j] = dy[j] / (d * d);
+        }
+    }
+
+    std::pair<Float, Float> scale() const override
+    {
+        return std::make_pair(Float(-0.8), Float(0.8));
+    }
+};
+
+void make_net(Network<Sequential> &net)
+{
+    net.add(ConvolutionalLayer(6, 6, 3, 1, 2));
+    net.add(ReluLayer());
+    net.add(FullyConnectedLayer(4 * 4 * 2, 8));
+    net.add(SoftsignLayer());
+    net.add(FullyConnectedLayer(8, 8));
+    net.add(TanhLayer());
+    net.add(FullyConnectedLayer(8, 4));
+    net.add(SigmoidLayer());
+    net.init_weight();
+}
+
+void make_data(std::vector<Matrix> &in, std::vector<Matrix> &t)
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<Float> u(-1, 1);
+    in.assign(batch, Matrix(1, Vector(6 * 6)));
+    t.assign(batch, Matrix(1, Vector(4)));
+    for (size_t i = 0; i < batch; i++) {
+        for (auto &x : in[i][0]) x = u(rng);
+        for (auto &x : t[i][0]) x = (u(rng) + 1) / 2;
+    }
+}
+
+bool same_outputs(const std::vector<Matrix> &a, const std::vector<Matrix> &b)
+{
+    return a == b;
+}
+
+bool same_grads(Network<Sequential> &a, Network<Sequential> &b)
+{
+    auto l = a.begin();
+    for (Layer *r : b) {
+        auto ga = (*l)->weights_grads();
+        auto gb = r->weights_grads();
+        if (ga.size() != gb.size()) return false;
+        for (size_t i = 0; i < ga.size(); i++) {
+            if (ga[i]->numel() != gb[i]->numel() ||
+                !std::equal(ga[i]->begin(), ga[i]->end(), gb[i]->begin())) {
+                return false;
+            }
+        }
+        ++l;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main()
+{
+    Network<Sequential> plain, planned;
+    make_net(plain);
+    make_net(planned);
+    copy_weights(plain, planned);
+    planned.set_memory_planning(true);
+
+    std::vector<Matrix> in, t;
+    make_data(in, t);
+    int failures = 0;
+
+    plain.set_netphase(NetPhase::TESTING);
+    planned.set_netphase(NetPhase::TESTING);
+    failures += check(same_outputs(plain.predict(in), planned.predict(in)),
+                      "planned TESTING outputs differ");
+
+    plain.set_netphase(NetPhase::TRAINING);
+    planned.set_netphase(NetPhase::TRAINING);
+    auto out = plain.fprop(in);
+    auto planned_out = planned.fprop(in);
+    failures += check(same_outputs(out, planned_out),
+                      "planned TRAINING outputs differ");
+    plain.bprop<Mse>(out, t, std::vector<Matrix>());
+    planned.bprop<Mse>(planned_out, t, std::vector<Matrix>());
+    failures += check(same_grads(plain, planned),
+                      "planned TRAINING gradients differ");
+
+    std::vector<Vector> in_samples, t_samples;
+    for (size_t i = 0; i < batch; i++) {
+        in_samples.push_back(in[i][0]);
+        t_samples.push_back(t[i][0]);
+    }
+    Adagrad plain_opt, planned_opt;
+    plain.fit<Mse>(plain_opt, in_samples, t_samples, 3, 2, nop, nop, false,
+                   1);
+    planned.fit<Mse>(planned_opt, in_samples, t_samples, 3, 2, nop, nop,
+                     false, 1);
+    failures += check(same_weights(plain, planned, 0),
+                      "planned training ends with other weights");
+
+    return failures == 0 ? 0 : 1;
+}
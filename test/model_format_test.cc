@@ -0,0 +1,221 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Saves a small network to a model file, loads and maps it back, and
+// reads truncated and corrupted copies of the file, and of one with
+// pooling layers.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+const char *const model_path = "model_format_test.mnn";
+const char *const pool_model_path = "model_format_test_pool.mnn";
+const char *const corrupt_path = "model_format_test_corrupt.mnn";
+
+// where the conv layer's record starts: the header, then its "conv" type
+const size_t conv_params = 64 + 8 + 8;
+
+void make_net(Network<Sequential> &net)
+{
+    net.add(ConvolutionalLayer(8, 8, 3, 1, 4));
+    net.add(TanhLayer());
+    net.add(FullyConnectedLayer(6 * 6 * 4, 10));
+    net.init_weight();
+}
+
+void put_word(std::string &bytes, size_t pos, uint64_t v)
+{
+    std::memcpy(&bytes[pos], &v, sizeof(v));
+}
+
+uint64_t get_word(const std::string &bytes, size_t pos)
+{
+    uint64_t v;
+    std::memcpy(&v, &bytes[pos], sizeof(v));
+    return v;
+}
+
+// where the param-th shape parameter of the layer-th record is
+size_t param_pos(const std::string &bytes, size_t layer, size_t param)
+{
+    size_t pos = 64;
+    for (size_t l = 0;; l++) {
+        pos += 8 + (get_word(bytes, pos) + 7) / 8 * 8;
+        if (l == layer) return pos + 8 * (1 + param);
+        pos += 8 * (1 + get_word(bytes, pos));
+        pos += 8 * (1 + 2 * get_word(bytes, pos));
+    }
+}
+
+int round_trip(Network<Sequential> &net)
+{
+    Network<Sequential> loaded, mapped;
+    loaded.load(model_path);
+    mapped.map(model_path);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<Float> u(-1, 1);
+    Vector in(8 * 8);
+    int failures = 0;
+    for (int n = 0; n < 4; n++) {
+        for (auto &x : in) x = u(rng);
+        Vector expected = net.predict(in);
+        failures += check(loaded.predict(in) == expected,
+                          "loaded network predicts differently");
+        failures += check(mapped.predict(in) == expected,
+                          "mapped network predicts differently");
+    }
+    return failures;
+}
+
+int mapped_weights(Network<Sequential> &net)
+{
+    Network<Sequential> mapped;
+    mapped.map(model_path);
+
+    int failures = 0;
+    auto l = net.begin();
+    for (Layer *m : mapped) {
+        const Layer &read_only = *m;
+        failures += check(read_only.weights().size() == (*l)->weights().size(),
+                          "mapped layer has other weights");
+        failures += check(read_only.has_same_weights(**l, 0),
+                          "mapped weights differ");
+        failures += check(read_only.weights().empty()
+                              || throws([&] { m->weights(); }),
+                          "mapped weights are writable");
+        ++l;
+    }
+    failures += check(throws([&] { mapped.init_weight(); }),
+                      "mapped weights were initialized");
+    return failures;
+}
+
+// loading and mapping bytes must throw MnnError
+int rejects(const std::string &bytes, const std::string &what)
+{
+    write_file(corrupt_path, bytes);
+    int failures = 0;
+    failures += check(throws([] {
+                          Network<Sequential> net;
+                          net.load(corrupt_path);
+                      }), "loaded a model file with " + what);
+    failures += check(throws([] {
+                          Network<Sequential> net;
+                          net.map(corrupt_path);
+                      }), "mapped a model file with " + what);
+    return failures;
+}
+
+int corrupt_files()
+{
+    const std::string good = read_file(model_path);
+    const uint64_t param_count = get_word(good, conv_params);
+    const size_t weight_count = conv_params + 8 * (1 + param_count);
+    int failures = 0;
+
+    failures += rejects(good.substr(0, 32), "a truncated header");
+    failures += rejects(good.substr(0, good.size() / 2), "truncated weights");
+
+    std::string bad = good;
+    bad[0] = 'X';
+    failures += rejects(bad, "a bad magic");
+
+    bad = good;
+    put_word(bad, conv_params, uint64_t(1) << 60);
+    failures += rejects(bad, "a huge parameter count");
+
+    bad = good;
+    put_word(bad, weight_count, uint64_t(1) << 60);
+    failures += rejects(bad, "a huge weight count");
+
+    // a connection table whose rows * cols wraps around to 0
+    bad = good;
+    put_word(bad, conv_params + 8 * (1 + 12), uint64_t(1) << 32);
+    put_word(bad, conv_params + 8 * (1 + 13), uint64_t(1) << 32);
+    failures += rejects(bad, "a huge connection table");
+
+    bad = good;
+    put_word(bad, weight_count + 8, 1);
+    failures += rejects(bad, "a misaligned weight");
+
+    std::remove(corrupt_path);
+    return failures;
+}
+
+// shape parameters the layers would divide by zero, wrap around or
+// allocate too much with
+int bad_shapes()
+{
+    Network<Sequential> pools;
+    pools.add(AveragePoolingLayer(8, 8, 1, 2));
+    pools.add(MaxPoolingLayer(4, 4, 1, 2));
+    pools.add(FullyConnectedLayer(2 * 2, 2));
+    pools.init_weight();
+    pools.save(pool_model_path);
+
+    struct Case {
+        const char *path;
+        size_t layer;
+        size_t param;
+        uint64_t value;
+        const char *what;
+    };
+    const Case cases[] = {
+        { model_path, 0, 0, 0, "a conv layer of zero width" },
+        { model_path, 0, 3, 9, "a conv window wider than its input" },
+        { model_path, 0, 6, 7, "a conv layer with an unknown padding" },
+        { model_path, 0, 8, 0, "a conv layer of zero stride" },
+        { model_path, 0, 10, 0, "a conv layer of zero dilation" },
+        { model_path, 0, 0, uint64_t(1) << 40, "a huge conv layer" },
+        { model_path, 1, 2, 0, "an activation of zero channels" },
+        { model_path, 2, 0, 0, "a fully-connected layer of no inputs" },
+        { pool_model_path, 0, 3, 0, "an average pool of zero size" },
+        { pool_model_path, 0, 5, 0, "an average pool of zero stride" },
+        { pool_model_path, 1, 4, 0, "a max pool of zero size" },
+        { pool_model_path, 1, 6, 0, "a max pool of zero stride" },
+        { pool_model_path, 1, 3, 5, "a max pool wider than its input" },
+    };
+    int failures = 0;
+    for (auto &c : cases) {
+        std::string bad = read_file(c.path);
+        put_word(bad, param_pos(bad, c.layer, c.param), c.value);
+        failures += rejects(bad, c.what);
+    }
+
+    std::remove(pool_model_path);
+    std::remove(corrupt_path);
+    return failures;
+}
+
+}  // namespace
+
+int main()
+{
+    Network<Sequential> net;
+    make_net(net);
+    net.save(model_path);
+
+    int failures = round_trip(net);
+    failures += mapped_weights(net);
+    failures += corrupt_files();
+    failures += bad_shapes();
+
+    std::remove(model_path);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Compares qgemm and the int8 conv and fully-connected layers with float
+// within the error quantization allows, on the SIMD tier MNN_ISA picks;
+// quantizes a small conv network for int8 inference, and releases its
+// float weights.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mnn/kernel/cpu/qgemm.h"
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+void make_net(Network<Sequential> &net)
+{
+    net.add(ConvolutionalLayer(8, 8, 3, 2, 4));
+    net.add(ReluLayer());
+    net.add(FullyConnectedLayer(6 * 6 * 4, 10));
+    net.init_weight();
+}
+
+std::vector<Vector> make_inputs(size_t samples, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<Float> u(-1, 1);
+    std::vector<Vector> in(samples, Vector(8 * 8 * 2));
+    for (auto &v : in) {
+        for (auto &x : v) x = u(rng);
+    }
+    return in;
+}
+
+Vector random_vector(size_t size, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<Float> u(-1, 1);
+    Vector v(size);
+    for (auto &x : v) x = u(rng);
+    return v;
+}
+
+Float absmax(const Float *x, size_t size)
+{
+    Float m = 0;
+    for (size_t i = 0; i < size; i++) m = std::max(m, std::abs(x[i]));
+    return m;
+}
+
+// Runs qgemm on an m x k A and a k x n W, with k odd, n not a multiple of
+// the panel width and column zero_col of W all zero. Rounding a and w to
+// the nearest step each moves a product by at most |a| * w_step / 2 +
+// a_step / 2 * |w_q|, which bounds the difference from the float result.
+int qgemm_within_bound(bool trans_a, bool trans_w, bool quantized_a,
+                       bool column_major_c, std::mt19937 &rng)
+{
+    const size_t m = 7, k = 37, n = 13, zero_col = 5;
+    const Vector a = random_vector(m * k, rng);
+    Vector w = random_vector(k * n, rng);
+    const Vector bias = random_vector(n, rng);
+    // w[p][j] lives at w[p * n + j], or at w[j * k + p] with trans_w
+    auto w_at = [&](size_t p, size_t j) -> Float & {
+        return trans_w ? w[j * k + p] : w[p * n + j];
+    };
+    auto a_at = [&](size_t i, size_t p) {
+        return trans_a ? a[p * m + i] : a[i * k + p];
+    };
+    for (size_t p = 0; p < k; p++) w_at(p, zero_col) = 0;
+
+    kernels::QuantizedWeights q;
+    kernels::quantize_weights(trans_w, k, n, w.data(), trans_w ? k : n, q);
+    const Float a_step = absmax(a.data(), a.size()) / 127;
+    const size_t lda = trans_a ? m : k;
+    const size_t ldc_row = column_major_c ? 1 : n;
+    const size_t ldc_col = column_major_c ? m : 1;
+    Vector c(m * n);
+    if (quantized_a) {
+        std::vector<int16_t> qa(a.size());
+        kernels::quantize(a.data(), a.size(), a_step, qa.data());
+        kernels::qgemm(trans_a, m, qa.data(), lda, a_step, q, bias.data(),
+                       c.data(), ldc_row, ldc_col);
+    } else {
+        kernels::qgemm(trans_a, m, a.data(), lda, a_step, q, bias.data(),
+                       c.data(), ldc_row, ldc_col);
+    }
+
+    const std::string what = std::string("qgemm") +
+            (trans_a ? " trans_a" : "") + (trans_w ? " trans_w" : "") +
+            (quantized_a ? " int16 a" : "") +
+            (column_major_c ? " column-major c" : "");
+    int failures = check(q.nr > 1 && n % q.nr != 0,
+                         what + ": n is a multiple of nr " +
+                         std::to_string(q.nr));
+    for (size_t j = 0; j < n; j++) {
+        Float w_max = 0;
+        for (size_t p = 0; p < k; p++) {
+            w_max = std::max(w_max, std::abs(w_at(p, j)));
+        }
+        const Float w_step = w_max / 127;
+        for (size_t i = 0; i < m; i++) {
+            Float expected = bias[j], bound = 0, magnitude = 0;
+            for (size_t p = 0; p < k; p++) {
+                const Float x = a_at(i, p), y = w_at(p, j);
+                expected += x * y;
+                bound += std::abs(x) * w_step / 2 +
+                         a_step / 2 * (std::abs(y) + w_step / 2);
+                magnitude += std::abs(x * y);
+            }
+            bound += 1e-5f * (magnitude + std::abs(bias[j]));
+            const Float got = c[i * ldc_row + j * ldc_col];
+            if (j == zero_col) {
+                failures += check(got == bias[j],
+                                  what + ": the zero column isn't the bias");
+            } else if (std::abs(got - expected) > bound) {
+                failures += check(false, what + ": c[" + std::to_string(i) +
+                        "][" + std::to_string(j) + "] = " +
+                        std::to_string(got) + ", float " +
+                        std::to_string(expected));
+            }
+        }
+    }
+    return failures;
+}
+
+int qgemm_tests()
+{
+    std::mt19937 rng(3);
+    int failures = 0;
+    for (int flags = 0; flags < 16; flags++) {
+        failures += qgemm_within_bound(flags & 1, flags & 2, flags & 4,
+                                       flags & 8, rng);
+    }
+    return failures;
+}
+
+// Predicts with the single layer of net, with outs output channels, in
+// float and in int8, with output channel zero_out all zero. Each of the
+// taps products moves by at most the input step times the channel's
+// largest weight, see above.
+int layer_within_bound(Network<Sequential> &net, size_t outs, size_t taps,
+                       size_t zero_out, const std::string &what)
+{
+    Layer &layer = **net.begin();
+    const size_t out_size = layer.out_data_size();
+    const size_t area = out_size / outs;
+    Vector &w = *layer.weights()[0];
+    const size_t k = w.size() / outs;
+    // conv weights are out channel major, fully-connected ones in major
+    const bool conv = layer.layer_type() == "conv";
+    auto w_at = [&](size_t o, size_t p) -> Float & {
+        return conv ? w[o * k + p] : w[p * outs + o];
+    };
+    for (size_t p = 0; p < k; p++) w_at(zero_out, p) = 0;
+    layer.post_update();
+
+    std::mt19937 rng(4);
+    std::vector<Vector> in;
+    for (int i = 0; i < 20; i++) {
+        in.push_back(random_vector(layer.in_data_size(), rng));
+    }
+    Float x_max = 0;
+    for (auto &v : in) x_max = std::max(x_max, absmax(v.data(), v.size()));
+    std::vector<Vector> expected;
+    for (auto &v : in) expected.push_back(net.predict(v));
+    net.quantize(in);
+
+    int failures = 0;
+    for (size_t s = 0; s < in.size(); s++) {
+        const Vector got = net.predict(in[s]);
+        for (size_t i = 0; i < out_size; i++) {
+            const size_t o = i / area;
+            Float w_max = 0;
+            for (size_t p = 0; p < k; p++) {
+                w_max = std::max(w_max, std::abs(w_at(o, p)));
+            }
+            const Float bound = taps * x_max / 127 * w_max +
+                                1e-5f * (std::abs(expected[s][i]) + 1);
+            const Float diff = std::abs(got[i] - expected[s][i]);
+            if (o == zero_out ? diff != 0 : diff > bound) {
+                failures += check(false, what + ": output " +
+                        std::to_string(i) + " = " + std::to_string(got[i]) +
+                        ", float " + std::to_string(expected[s][i]));
+            }
+        }
+    }
+    return failures;
+}
+
+int layer_tests()
+{
+    int failures = 0;
+    {
+        Network<Sequential> net;
+        net.add(FullyConnectedLayer(37, 13));
+        net.init_weight();
+        failures += layer_within_bound(net, 13, 37, 5, "fully-connected");
+    }
+    {
+        // 9x7 inputs in 3 channels, SAME padded, stride 2 across
+        Network<Sequential> net;
+        net.add(ConvolutionalLayer(9, 7, 3, 3, 13, Padding::SAME, true, 2, 1));
+        net.init_weight();
+        failures += layer_within_bound(net, 13, 3 * 3 * 3, 5, "conv");
+    }
+    return failures;
+}
+
+// released float weights leave the int8 predictions as they were
+int released(const std::vector<Vector> &in)
+{
+    Network<Sequential> net;
+    make_net(net);
+    net.quantize(in);
+    std::vector<Vector> expected;
+    for (auto &s : in) expected.push_back(net.predict(s));
+
+    net.release_float_weights();
+    int failures = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+        failures += check(net.predict(in[i]) == expected[i],
+                          "int8 prediction changed after the release");
+    }
+    for (const Layer *l : net) {
+        const std::string type = l->layer_type();
+        if (type == "conv" || type == "fully-connected") {
+            failures += check(l->float_released() && l->weights()[0].empty(),
+                              type + " kept its float weights");
+        }
+    }
+
+    std::vector<Label> labels(in.size(), 0);
+    Adagrad opt;
+    failures += check(throws([&] { net.train<Mse>(opt, in, labels, 4, 1); }),
+                      "training a released network didn't throw");
+    failures += check(throws([&] { net.save("quantize_test.mnn"); }),
+                      "saving a released network didn't throw");
+    failures += check(throws([&] { net.dequantize(); }),
+                      "dequantizing a released network didn't throw");
+    failures += check(throws([&] { net.quantize(in); }),
+                      "requantizing a released network didn't throw");
+    return failures;
+}
+
+// layers that never saw an input keep their float weights
+int uncalibrated(const std::vector<Vector> &in)
+{
+    Network<Sequential> net;
+    make_net(net);
+    const Vector expected = net.predict(in[0]);
+    net.quantize({});
+    net.release_float_weights();
+    int failures = 0;
+    for (const Layer *l : net) {
+        failures += check(!l->float_released(),
+                          l->layer_type() + " released without a range");
+    }
+    failures += check(net.predict(in[0]) == expected,
+                      "uncalibrated prediction isn't float");
+    return failures;
+}
+
+}  // namespace
+
+int main()
+{
+    if (!requested_isa_active()) {
+        return skipped;
+    }
+    const std::vector<Vector> in = make_inputs(100, 1);
+    int failures = qgemm_tests();
+    failures += layer_tests();
+    failures += released(in);
+    failures += uncalibrated(in);
+    return failures == 0 ? 0 : 1;
+}
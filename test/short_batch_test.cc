@@ -0,0 +1,59 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Trains on datasets whose size is not a multiple of the batch size, so
+// the last minibatch is too short to shard over the workers, and checks
+// that sharded training ends with the weights of training on one worker.
+
+#include <cstdio>
+
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+bool train(size_t samples, size_t batch_size)
+{
+    Network<Sequential> sharded, single;
+    make_fc_net(sharded);
+    make_fc_net(single);
+    copy_weights(sharded, single);
+
+    std::vector<Vector> in;
+    std::vector<Label> labels;
+    make_fc_data(samples, samples, in, labels);
+
+    Adagrad sharded_opt, single_opt;
+    if (!sharded.train<Mse>(sharded_opt, in, labels, batch_size, 2) ||
+        !single.train<Mse>(single_opt, in, labels, batch_size, 2, nop, nop,
+                           false, 1)) {
+        return false;
+    }
+    for (auto &x : sharded.predict(in[0])) {
+        if (!std::isfinite(x)) return false;
+    }
+    // the shards' gradients are summed in another order
+    return same_weights(sharded, single, Float(1e-4));
+}
+
+}  // namespace
+
+int main()
+{
+    const size_t sizes[] = { 96, 100, 101, 103 };
+    int failures = 0;
+    for (size_t samples : sizes) {
+        if (!train(samples, 8)) {
+            std::printf("training on %zu samples failed\n", samples);
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Helpers shared by the regression tests: reporting, files, and a small
+// fully-connected network with random data to train it on.
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mnn/mnn.h"
+
+namespace mnn {
+namespace test {
+
+// 0 if ok, else 1 after printing what failed
+inline int check(bool ok, const std::string &what)
+{
+    if (!ok) std::printf("%s\n", what.c_str());
+    return ok ? 0 : 1;
+}
+
+// the exit code ctest counts as skipped, see SKIP_RETURN_CODE
+const int skipped = 77;
+
+// whether the SIMD tier MNN_ISA asks for runs, which it doesn't when the
+// cpu or the build lacks it; tests registered once per tier skip then
+inline bool requested_isa_active()
+{
+    const char *isa = std::getenv("MNN_ISA");
+    return isa == nullptr || *isa == '\0' ||
+           std::string(isa) == to_string(active_isa());
+}
+
+// whether f() throws MnnError
+template <typename F>
+bool throws(F f)
+{
+    try {
+        f();
+    } catch (const MnnError &) {
+        return true;
+    }
+    return false;
+}
+
+inline std::string read_file(const char *path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+}
+
+inline void write_file(const char *path, const std::string &bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+// FC(16, 8) -> Activation -> FC(8, 4), initialized
+template <typename Activation = TanhLayer>
+void make_fc_net(Network<Sequential> &net)
+{
+    net.add(FullyConnectedLayer(16, 8));
+    net.add(Activation());
+    net.add(FullyConnectedLayer(8, 4));
+    net.init_weight();
+}
+
+// samples random inputs for make_fc_net() with labels cycling over 0..3
+inline void make_fc_data(size_t samples, unsigned seed,
+                         std::vector<Vector> &in, std::vector<Label> &labels)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<Float> u(-1, 1);
+    in.assign(samples, Vector(16));
+    labels.resize(samples);
+    for (size_t i = 0; i < samples; i++) {
+        for (auto &x : in[i]) x = u(rng);
+        labels[i] = i % 4;
+    }
+}
+
+// copies the weights of from into to, which has the same layers
+inline void copy_weights(Network<Sequential> &from, Network<Sequential> &to)
+{
+    auto l = from.begin();
+    for (Layer *dst : to) {
+        const Layer &src = **l;
+        std::vector<const Float*> data;
+        for (auto w : src.weights()) data.push_back(w.data());
+        dst->load_weights(data, false);
+        ++l;
+    }
+}
+
+// whether a and b have the same weights within eps
+inline bool same_weights(Network<Sequential> &a, Network<Sequential> &b,
+                         Float eps)
+{
+    auto l = a.begin();
+    for (Layer *r : b) {
+        if (!r->has_same_weights(**l, eps)) return false;
+        ++l;
+    }
+    return true;
+}
+
+}  // namespace test
+}  // namespace mnn
@@ -0,0 +1,239 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Sweeps vectorize::exp, tanh and sigmoid against libm on the SIMD tier
+// MNN_ISA picks, and the double versions on the registers of this build,
+// checking the ulp bounds documented at detail::Transcendental.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+
+namespace {
+
+// T's bits as an integer ordered like the values, so that the distance of
+// two values is their distance in ulps
+template <typename T, typename I>
+I ordered(T x)
+{
+    I i;
+    std::memcpy(&i, &x, sizeof(x));
+    return i < 0 ? std::numeric_limits<I>::min() - i : i;
+}
+
+template <typename T, typename I>
+T from_ordered(I i)
+{
+    if (i < 0) i = std::numeric_limits<I>::min() - i;
+    T x;
+    std::memcpy(&x, &i, sizeof(x));
+    return x;
+}
+
+template <typename T>
+struct Bits;
+template <>
+struct Bits<float> {
+    typedef std::int32_t type;
+    typedef double wide;
+};
+template <>
+struct Bits<double> {
+    typedef std::int64_t type;
+    typedef long double wide;
+};
+
+template <typename T>
+double ulps(T a, T b)
+{
+    typedef typename Bits<T>::type I;
+    if (a == b) return 0;
+    if (std::isnan(a) || std::isnan(b) || std::isinf(a) || std::isinf(b)) {
+        return std::numeric_limits<double>::infinity();
+    }
+    // subtract as unsigned, a 64-bit distance doesn't fit a double
+    typedef typename std::make_unsigned<I>::type U;
+    const I i = ordered<T, I>(a), j = ordered<T, I>(b);
+    return static_cast<double>(i > j ? U(i) - U(j) : U(j) - U(i));
+}
+
+// about samples inputs spread evenly over the values in [lo, hi], which
+// over a wide range means evenly over the exponents
+template <typename T>
+std::vector<T> sweep(T lo, T hi, size_t samples)
+{
+    typedef typename Bits<T>::type I;
+    const I a = ordered<T, I>(lo), b = ordered<T, I>(hi);
+    // b - a can overflow I
+    const I n = static_cast<I>(samples);
+    const I step = std::max<I>(1, b / n - a / n);
+    std::vector<T> x;
+    for (I i = a; i <= b - step; i += step) x.push_back(from_ordered<T, I>(i));
+    x.push_back(hi);
+    return x;
+}
+
+typedef void (*Kernel)(const Float *, std::size_t, Float *);
+
+template <typename T>
+struct Function {
+    const char *name;
+    // the result in more than T's precision
+    typename Bits<T>::wide (*reference)(typename Bits<T>::wide);
+    T lo, hi;        // where results are normal
+    double bound;    // in ulps
+};
+
+// the largest error of f over x, computed by kernel
+template <typename T, typename K>
+int check_bound(const Function<T> &f, const std::vector<T> &x, K kernel,
+                const std::string &where)
+{
+    std::vector<T> y(x.size());
+    kernel(x.data(), x.size(), y.data());
+    double worst = 0;
+    size_t worst_i = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+        const T expected = static_cast<T>(f.reference(x[i]));
+        const double e = ulps(y[i], expected);
+        if (e > worst) {
+            worst = e;
+            worst_i = i;
+        }
+    }
+    return check(worst <= f.bound, where + " " + f.name + ": " +
+                 std::to_string(worst) + " ulps at " +
+                 std::to_string(x[worst_i]) + ", bound " +
+                 std::to_string(f.bound));
+}
+
+template <typename W>
+W exp_ref(W x) { return std::exp(x); }
+template <typename W>
+W tanh_ref(W x) { return std::tanh(x); }
+template <typename W>
+W sigmoid_ref(W x) { return W(1) / (W(1) + std::exp(-x)); }
+
+// the bounds of detail::Transcendental, over the inputs with normal
+// results, from tiny to the largest magnitudes
+template <typename T>
+std::vector<Function<T>> functions();
+
+template <>
+std::vector<Function<float>> functions()
+{
+    const float max = std::numeric_limits<float>::max();
+    return {{"exp", exp_ref<double>, -87.33f, 88.37f, 1},
+            {"tanh", tanh_ref<double>, -max, max, 2},
+            {"sigmoid", sigmoid_ref<double>, -87.0f, max, 3}};
+}
+
+template <>
+std::vector<Function<double>> functions()
+{
+    const double max = std::numeric_limits<double>::max();
+    return {{"exp", exp_ref<long double>, -708.39, 709.43, 1},
+            {"tanh", tanh_ref<long double>, -max, max, 2},
+            {"sigmoid", sigmoid_ref<long double>, -708.0, max, 2}};
+}
+
+// the documented edges: exp saturates to inf and flushes to 0 outside
+// the normal range, and NaN propagates
+template <typename T, typename K>
+int check_edges(K exp, K tanh, K sigmoid, const std::string &where)
+{
+    const T inf = std::numeric_limits<T>::infinity();
+    const T nan = std::numeric_limits<T>::quiet_NaN();
+    const T big = std::numeric_limits<T>::max();
+    const std::vector<T> x {inf, -inf, big, -big, T(1e30), T(-1e30), nan};
+    std::vector<T> e(x.size()), t(x.size()), s(x.size());
+    exp(x.data(), x.size(), e.data());
+    tanh(x.data(), x.size(), t.data());
+    sigmoid(x.data(), x.size(), s.data());
+    int failures = 0;
+    for (size_t i = 0; i + 1 < x.size(); i++) {
+        const bool positive = x[i] > 0;
+        failures += check(e[i] == (positive ? inf : T(0)),
+                          where + " exp(" + std::to_string(x[i]) + ")");
+        failures += check(t[i] == (positive ? T(1) : T(-1)),
+                          where + " tanh(" + std::to_string(x[i]) + ")");
+        failures += check(s[i] == (positive ? T(1) : T(0)),
+                          where + " sigmoid(" + std::to_string(x[i]) + ")");
+    }
+    const size_t n = x.size() - 1;
+    failures += check(std::isnan(e[n]) && std::isnan(t[n]) &&
+                      std::isnan(s[n]), where + ": NaN doesn't propagate");
+    return failures;
+}
+
+template <typename T, typename K>
+int check_all(K exp, K tanh, K sigmoid, size_t samples,
+              const std::string &where)
+{
+    const K kernels[] = {exp, tanh, sigmoid};
+    const std::vector<Function<T>> fs = functions<T>();
+    int failures = 0;
+    for (size_t i = 0; i < fs.size(); i++) {
+        failures += check_bound(fs[i], sweep(fs[i].lo, fs[i].hi, samples),
+                                kernels[i], where);
+        // densely where the polynomials and the tanh switch at 0.625 are
+        const T lo = std::max(fs[i].lo, T(-20)), hi = std::min(fs[i].hi, T(20));
+        failures += check_bound(fs[i], sweep(lo, hi, samples), kernels[i],
+                                where);
+    }
+    return failures + check_edges<T>(exp, tanh, sigmoid, where);
+}
+
+// the double versions on the register types of this build, which don't
+// depend on the tier; with runtime dispatch that is only the scalar one
+template <typename V>
+int check_double(const std::string &where)
+{
+    return check_all<double>(&vectorize::detail::exp<V>,
+                             &vectorize::detail::tanh<V>,
+                             &vectorize::detail::sigmoid<V>, 1 << 18, where);
+}
+
+}  // namespace
+
+int main()
+{
+    if (!requested_isa_active()) {
+        return skipped;
+    }
+    const std::string isa = to_string(active_isa());
+    int failures = check_all<Float>(
+            static_cast<Kernel>(&vectorize::exp<Float>),
+            static_cast<Kernel>(&vectorize::tanh<Float>),
+            static_cast<Kernel>(&vectorize::sigmoid<Float>), 1 << 20, isa);
+
+    failures += check_double<vectorize::detail::GenericScalar<double>>(
+            "scalar double");
+#ifdef MNN_USE_SSE
+    failures += check_double<vectorize::detail::SseDouble>("sse2 double");
+#endif
+#if defined(MNN_USE_AVX) || defined(MNN_USE_AVX2)
+    failures += check_double<vectorize::detail::AvxDouble>("avx double");
+#endif
+#ifdef MNN_USE_AVX2
+    failures += check_double<vectorize::detail::Avx2Double>("avx2 double");
+#endif
+#ifdef MNN_USE_AVX512
+    failures += check_double<vectorize::detail::Avx512Double>("avx512 double");
+#endif
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+/*
+ *   Copyright (c) 2021, Horance Liu and the respective contributors
+ *   All rights reserved.
+ *
+ *   Use of this source code is governed by a Apache 2.0 license that can be found
+ *   in the LICENSE file.
+ */
+
+// Compares the Winograd convolution, forward and for the data gradient,
+// with the direct and im2col paths, on the SIMD tier MNN_ISA picks.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mnn/kernel/cpu/conv2d_op_cpu.h"
+#include "test_util.h"
+
+using namespace mnn;
+using namespace mnn::test;
+using namespace mnn::kernels;
+
+namespace {
+
+// 3x3 kernels with unit strides, like ConvolutionalLayer sets them up;
+// a SAME padded input is 2 wider and higher
+ConvParams make_params(size_t in_w, size_t in_h, size_t in_d, size_t out_d,
+                       Padding pad, const ConnectionTable &tbl)
+{
+    const size_t padded = pad == Padding::SAME ? 2 : 0;
+    ConvParams p;
+    p.in = Shape3d(in_w, in_h, in_d);
+    p.in_padded = Shape3d(in_w + padded, in_h + padded, in_d);
+    p.out = Shape3d(in_w + padded - 2, in_h + padded - 2, out_d);
+    p.weight = Shape3d(3, 3, in_d * out_d);
+    p.has_bias = true;
+    p.pad_type = pad;
+    p.w_stride = p.h_stride = 1;
+    p.w_dilation = p.h_dilation = 1;
+    p.tbl = tbl;
+    return p;
+}
+
+// every in channel connected to about half the out channels
+ConnectionTable sparse_table(size_t in_d, size_t out_d, std::mt19937 &rng)
+{
+    std::unique_ptr<bool[]> table(new bool[in_d * out_d]);
+    for (size_t i = 0; i < in_d * out_d; i++) table[i] = rng() % 2;
+    return ConnectionTable(table.get(), in_d, out_d);
+}
+
+// connected everywhere, but not empty, which keeps conv2d_op_internal on
+// the direct loops
+ConnectionTable full_table(size_t in_d, size_t out_d)
+{
+    std::unique_ptr<bool[]> table(new bool[in_d * out_d]);
+    std::fill(table.get(), table.get() + in_d * out_d, true);
+    return ConnectionTable(table.get(), in_d, out_d);
+}
+
+Tensor<> random_tensor(const std::vector<size_t> &shape, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<Float> u(-1, 1);
+    Tensor<> t(shape);
+    for (auto &x : t) x = u(rng);
+    return t;
+}
+
+// 0 if got matches expected within a tolerance relative to its largest
+// magnitude
+int compare(const Tensor<> &got, const Tensor<> &expected,
+            const std::string &what)
+{
+    Float scale = 1;
+    for (Float x : expected) scale = std::max(scale, std::abs(x));
+    for (size_t i = 0; i < expected.numel(); i++) {
+        const Float diff = std::abs(got.data()[i] - expected.data()[i]);
+        if (!(diff <= 2e-4f * scale)) {
+            return check(false, what + ": element " + std::to_string(i) +
+                    " = " + std::to_string(got.data()[i]) + ", expected " +
+                    std::to_string(expected.data()[i]));
+        }
+    }
+    return 0;
+}
+
+struct Case {
+    const char *name;
+    size_t in_w, in_h, in_d, out_d;
+    Padding pad;
+    size_t tile;      // the F(m x m) the output size picks
+    bool sparse;      // a sparse connection table
+    bool epilogue;    // a fused ReLU epilogue
+};
+
+int run(const Case &c, std::mt19937 &rng)
+{
+    const std::string name = c.name;
+    const ConnectionTable tbl = c.sparse ?
+            sparse_table(c.in_d, c.out_d, rng) : ConnectionTable();
+    const ConvParams params = make_params(c.in_w, c.in_h, c.in_d, c.out_d,
+                                          c.pad, tbl);
+    // the direct loops, which for a dense table need a non-empty one
+    const ConvParams direct = c.sparse ? params :
+            make_params(c.in_w, c.in_h, c.in_d, c.out_d, c.pad,
+                        full_table(c.in_d, c.out_d));
+    int failures = check(conv2d_use_winograd(params),
+                         name + ": not a Winograd layer");
+    const std::string tile = std::to_string(winograd_tile_size(params));
+    failures += check(tile == std::to_string(c.tile),
+                      name + ": F(" + tile + "x" + tile + ") instead");
+    failures += check(c.sparse || conv2d_use_gemm(params),
+                      name + ": the dense layer doesn't use im2col");
+    if (failures) return failures;
+
+    const size_t samples = 3;
+    const Tensor<> in = random_tensor({samples, c.in_d,
+            params.in_padded.height_, params.in_padded.width_}, rng);
+    const Tensor<> W = random_tensor({1, params.weight.depth_, 3, 3}, rng);
+    const Tensor<> bias = random_tensor({1, c.out_d, 1, 1}, rng);
+    const std::vector<size_t> out_shape {samples, c.out_d,
+            params.out.height_, params.out.width_};
+    const Epilogue relu = [](Span<Float> y) {
+        for (auto &v : y) v = std::max(v, Float(0));
+    };
+    const Epilogue *epilogue = c.epilogue ? &relu : nullptr;
+
+    WinogradFilter forward;
+    winograd_transform_filter(W[0], params, false, forward);
+    Tensor<> wino(out_shape), expected(out_shape);
+    conv2d_op_internal(in, W[0], bias[0], wino, params, true, &forward,
+                       epilogue);
+    conv2d_op_internal(in, W[0], bias[0], expected, direct, false, nullptr,
+                       epilogue);
+    failures += compare(wino, expected, name + " forward vs direct");
+    if (!c.sparse) {
+        Tensor<> gemm(out_shape);
+        conv2d_op_internal(in, W[0], bias[0], gemm, params, false, nullptr,
+                           epilogue);
+        failures += compare(wino, gemm, name + " forward vs im2col");
+    }
+
+    // the data gradient accumulates into what prev_delta holds
+    const Tensor<> curr_delta = random_tensor(out_shape, rng);
+    const Tensor<> prev = random_tensor(in.shape(), rng);
+    WinogradFilter backward;
+    winograd_transform_filter(W[0], params, true, backward);
+    Tensor<> wino_delta(prev), direct_delta(prev), gemm_delta(prev);
+    conv2d_winograd_backward_data(curr_delta, backward, wino_delta, params,
+                                  true);
+    for (size_t s = 0; s < samples; s++) {
+        conv2d_direct_backward_data(W[0], curr_delta[s], direct_delta[s],
+                                    direct);
+        if (!c.sparse) {
+            conv2d_gemm_backward_data(W[0], &curr_delta[s][0],
+                                      &gemm_delta[s][0], params, false);
+        }
+    }
+    failures += compare(wino_delta, direct_delta,
+                        name + " backward data vs direct");
+    if (!c.sparse) {
+        failures += compare(wino_delta, gemm_delta,
+                            name + " backward data vs im2col");
+    }
+    return failures;
+}
+
+}  // namespace
+
+int main()
+{
+    if (!requested_isa_active()) {
+        return skipped;
+    }
+    // channel counts off the 8 SIMD lanes, outputs off the tile size
+    const Case cases[] = {
+        {"F(2x2) valid 5x5", 7, 7, 35, 33, Padding::VALID, 2, false, false},
+        {"F(2x2) same 5x5 sparse", 5, 5, 34, 37, Padding::SAME, 2, true,
+         false},
+        {"F(4x4) valid 11x9", 13, 11, 33, 35, Padding::VALID, 4, false,
+         false},
+        {"F(4x4) same 7x9 relu", 7, 9, 35, 33, Padding::SAME, 4, false, true},
+        {"F(4x4) same 7x9 sparse relu", 7, 9, 33, 34, Padding::SAME, 4, true,
+         true},
+    };
+    std::mt19937 rng(5);
+    int failures = 0;
+    for (const Case &c : cases) failures += run(c, rng);
+    return failures == 0 ? 0 : 1;
+}